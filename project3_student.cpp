@@ -19,8 +19,31 @@
 #include <algorithm>
 #include <cctype>
 #include <ctime>
+#include <thread>
+#include <memory>
+#include <csignal>
+#include <cstring>
 #include "stemmer.h"
 #include <climits>
+#include <deque>
+#include <atomic>
+#include <iterator>
+#include <memory_resource>
+#include <string_view>
+#include <new>
+#include <filesystem>
+#include <cmath>
+#include <random>
+#include <array>
+#include <map>
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 #ifdef _WIN32
 #include <conio.h>
@@ -28,6 +51,12 @@
 #else
 #include <termios.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #endif
 
 using namespace std;
@@ -114,29 +143,126 @@ namespace Color {
 }
 
 // ============================================================================
-// ARROW-KEY MENU SYSTEM
+// TERMINAL I/O
 // ============================================================================
 
-class ArrowMenu {
-private:
-    vector<string> options;
-    string title;
-    int selectedIndex;
+namespace Terminal {
+    const string CLEAR_SCREEN = "\033[H\033[2J";
+    const string CLEAR_TO_END_OF_LINE = "\033[K";
+    const string CLEAR_TO_END_OF_SCREEN = "\033[J";
+    const string HIDE_CURSOR = "\033[?25l";
+    const string SHOW_CURSOR = "\033[?25h";
+    
+    // Moves the cursor to a 0-based row, column 0
+    string moveToRow(size_t row) {
+        return "\033[" + to_string(row + 1) + ";1H";
+    }
+    
+    // Hands data to the terminal in one write, after anything still
+    // buffered in cout
+    void write(const string& data) {
+        cout.flush();
+        #ifdef _WIN32
+        fwrite(data.data(), 1, data.size(), stdout);
+        fflush(stdout);
+        #else
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = ::write(STDOUT_FILENO, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            done += n;
+        }
+        #endif
+    }
+    
+    // ANSI clear instead of running clear/cls in a shell
+    void clearScreen() {
+        write(CLEAR_SCREEN);
+    }
+    
+    void waitForKey(const string& prompt) {
+        write(prompt);
+        #ifdef _WIN32
+        _getch();
+        #else
+        cin.get();
+        #endif
+    }
+    
+    // Keys that arrive as escape sequences get codes above the byte range
+    enum Key {
+        KEY_BACKSPACE = 8,
+        KEY_ENTER = 10,
+        KEY_ESCAPE = 27,
+        KEY_UP = 256,
+        KEY_DOWN,
+        KEY_PAGE_UP,
+        KEY_PAGE_DOWN,
+        KEY_HOME,
+        KEY_END
+    };
+    
+    #ifndef _WIN32
+    // Decodes what follows an ESC byte. A lone ESC is told apart from an
+    // arrow or paging key by waiting a tenth of a second for more input.
+    int readEscapeSequence(struct termios raw) {
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 1;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        
+        int next = getchar();
+        if (next != '[' && next != 'O') {
+            if (next == EOF) {
+                clearerr(stdin);
+            } else {
+                ungetc(next, stdin);
+            }
+            return KEY_ESCAPE;
+        }
+        
+        int ch = getchar();
+        switch (ch) {
+            case 'A': return KEY_UP;
+            case 'B': return KEY_DOWN;
+            case 'H': return KEY_HOME;
+            case 'F': return KEY_END;
+        }
+        
+        // Paging keys look like ESC [ 5 ~
+        int number = 0;
+        while (ch >= '0' && ch <= '9') {
+            number = number * 10 + (ch - '0');
+            ch = getchar();
+        }
+        if (ch != '~') return 0;
+        switch (number) {
+            case 1: case 7: return KEY_HOME;
+            case 4: case 8: return KEY_END;
+            case 5: return KEY_PAGE_UP;
+            case 6: return KEY_PAGE_DOWN;
+        }
+        return 0;
+    }
+    #endif
     
-    // Get a single keypress (cross-platform)
-    int getKey() {
+    // Reads one keypress without echo. Returns a Key code for navigation
+    // keys, 0 for keys that mean nothing here, and the byte otherwise.
+    // End of input reads as ESC so menus fed from a pipe still exit.
+    int readKey() {
         #ifdef _WIN32
         int ch = _getch();
-        if (ch == 0 || ch == 224) { // Arrow keys return two codes on Windows
-            ch = _getch();
-            switch (ch) {
-                case 72: return 'A'; // Up arrow
-                case 80: return 'B'; // Down arrow
-                case 75: return 'D'; // Left arrow
-                case 77: return 'C'; // Right arrow
+        if (ch == 0 || ch == 224) { // Navigation keys return two codes on Windows
+            switch (_getch()) {
+                case 72: return KEY_UP;
+                case 80: return KEY_DOWN;
+                case 73: return KEY_PAGE_UP;
+                case 81: return KEY_PAGE_DOWN;
+                case 71: return KEY_HOME;
+                case 79: return KEY_END;
             }
+            return 0;
         }
-        return ch;
         #else
         struct termios oldt, newt;
         tcgetattr(STDIN_FILENO, &oldt);
@@ -145,41 +271,101 @@ private:
         tcsetattr(STDIN_FILENO, TCSANOW, &newt);
         
         int ch = getchar();
-        if (ch == 27) { // ESC sequence
-            getchar(); // Skip '['
-            ch = getchar();
-        }
+        if (ch == 27) ch = readEscapeSequence(newt);
         
         tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-        return ch;
         #endif
+        
+        if (ch == EOF) return KEY_ESCAPE;
+        if (ch == 13) return KEY_ENTER;
+        if (ch == 127) return KEY_BACKSPACE;
+        return ch;
     }
     
-    void clearScreen() {
+    // Visible rows and columns, or 24x80 when not attached to a terminal
+    pair<size_t, size_t> screenSize() {
         #ifdef _WIN32
-        system("cls");
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+            return {info.srWindow.Bottom - info.srWindow.Top + 1,
+                    info.srWindow.Right - info.srWindow.Left + 1};
+        }
         #else
-        system("clear");
+        struct winsize size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+            return {size.ws_row, size.ws_col};
+        }
         #endif
+        return {24, 80};
+    }
+}
+
+// Draws full-screen frames composed in memory. The first frame clears the
+// screen; later ones rewrite only the rows that changed and erase rows the
+// previous frame had beyond the new one's end. Every frame is one write.
+class FrameRenderer {
+private:
+    vector<string> shownRows;
+    bool repaint = true;
+
+public:
+    void render(const vector<string>& rows) {
+        string frame;
+        if (repaint) {
+            frame += Terminal::CLEAR_SCREEN;
+            shownRows.clear();
+            repaint = false;
+        }
+        for (size_t row = 0; row < rows.size(); row++) {
+            if (row < shownRows.size() && shownRows[row] == rows[row]) continue;
+            frame += Terminal::moveToRow(row) + rows[row] + Terminal::CLEAR_TO_END_OF_LINE;
+        }
+        if (rows.size() < shownRows.size()) {
+            frame += Terminal::moveToRow(rows.size()) + Terminal::CLEAR_TO_END_OF_SCREEN;
+        }
+        frame += Terminal::moveToRow(rows.size());
+        shownRows = rows;
+        Terminal::write(frame);
     }
+};
+
+// ============================================================================
+// ARROW-KEY MENU SYSTEM
+// ============================================================================
+
+class ArrowMenu {
+private:
+    vector<string> options;
+    string title;
+    int selectedIndex;
+    FrameRenderer renderer;
     
     void displayMenu() {
-        clearScreen();
+        vector<string> rows;
         
-        // Display title
-        cout << "\n  " << title << "\n";
-        cout << "  " << string(title.length(), '=') << "\n\n";
+        // Title
+        rows.push_back("");
+        rows.push_back("  " + title);
+        rows.push_back("  " + string(title.length(), '='));
+        rows.push_back("");
         
-        // Display options
+        // Options
         for (size_t i = 0; i < options.size(); i++) {
             if (i == selectedIndex) {
-                cout << Color::MENU_SELECTED << "  " << options[i] << "  " << Color::RESET << "\n";
+                rows.push_back(Color::MENU_SELECTED + "  " + options[i] + "  " + Color::RESET);
             } else {
-                cout << "  " << options[i] << "\n";
+                rows.push_back("  " + options[i]);
             }
         }
         
-        cout << "\n  Use Up/Down arrows to navigate, Enter to select, Q to quit\n";
+        rows.push_back("");
+        rows.push_back("  Use Up/Down arrows to navigate, Enter to select, Q to quit");
+        renderer.render(rows);
+    }
+    
+    int finish(int result) {
+        Terminal::write(Terminal::SHOW_CURSOR);
+        return result;
     }
     
 public:
@@ -188,32 +374,32 @@ public:
     
     // Returns the selected option index, or -1 if quit
     int show() {
+        Terminal::write(Terminal::HIDE_CURSOR);
         while (true) {
             displayMenu();
             
-            int key = getKey();
+            int key = Terminal::readKey();
             
             switch (key) {
-                case 'A': // Up arrow
+                case Terminal::KEY_UP:
                 case 'w':
                 case 'W':
                     if (selectedIndex > 0) selectedIndex--;
                     break;
                     
-                case 'B': // Down arrow
+                case Terminal::KEY_DOWN:
                 case 's':
                 case 'S':
                     if (selectedIndex < options.size() - 1) selectedIndex++;
                     break;
                     
-                case 13: // Enter
-                case 10: // Enter (Unix)
-                    return selectedIndex;
+                case Terminal::KEY_ENTER:
+                    return finish(selectedIndex);
                     
                 case 'q':
                 case 'Q':
-                case 27: // ESC
-                    return -1;
+                case Terminal::KEY_ESCAPE:
+                    return finish(-1);
             }
         }
     }
@@ -225,16 +411,403 @@ public:
     }
 };
 
+// ============================================================================
+// TYPE-AHEAD ENTITY PICKER
+// ============================================================================
+
+// Every word start of every name, lowercased and sorted, so the names
+// matching a typed prefix form one contiguous range found by binary search.
+// "har" finds "Kamala Harris" through the entry for "harris".
+class PrefixIndex {
+public:
+    struct Range {
+        size_t first;
+        size_t last;
+    };
+
+private:
+    struct Entry {
+        uint32_t name;
+        uint32_t offset;
+    };
+    
+    vector<string> lowered;
+    vector<Entry> entries;
+    
+    string_view key(const Entry& e) const {
+        return string_view(lowered[e.name]).substr(e.offset);
+    }
+    
+public:
+    explicit PrefixIndex(const vector<string>& names) {
+        lowered.reserve(names.size());
+        for (uint32_t id = 0; id < names.size(); id++) {
+            string lower = names[id];
+            for (char& c : lower) c = tolower(static_cast<unsigned char>(c));
+            for (uint32_t i = 0; i < lower.size(); i++) {
+                bool wordStart = i == 0 ||
+                    (isalnum(static_cast<unsigned char>(lower[i])) &&
+                     !isalnum(static_cast<unsigned char>(lower[i - 1])));
+                if (wordStart) entries.push_back({id, i});
+            }
+            lowered.push_back(move(lower));
+        }
+        sort(entries.begin(), entries.end(), [this](const Entry& a, const Entry& b) {
+            string_view ka = key(a), kb = key(b);
+            return ka != kb ? ka < kb : a.name < b.name;
+        });
+    }
+    
+    Range all() const {
+        return {0, entries.size()};
+    }
+    
+    // Entries within an earlier range that also start with the longer
+    // lowercase prefix; typing a character only searches what already matched
+    Range narrow(Range within, const string& prefix) const {
+        auto begin = entries.begin() + within.first;
+        auto end = entries.begin() + within.last;
+        auto first = lower_bound(begin, end, prefix, [this](const Entry& e, const string& p) {
+            return key(e) < p;
+        });
+        auto last = partition_point(first, end, [this, &prefix](const Entry& e) {
+            return key(e).substr(0, prefix.size()) == prefix;
+        });
+        return {size_t(first - entries.begin()), size_t(last - entries.begin())};
+    }
+    
+    // Name ids in the range, in the caller's original order, each once
+    vector<uint32_t> names(Range range) const {
+        vector<uint32_t> ids;
+        ids.reserve(range.last - range.first);
+        for (size_t i = range.first; i < range.last; i++) ids.push_back(entries[i].name);
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+};
+
+// Scrolling picker for long name lists. Only the rows that fit the terminal
+// are drawn, and typing filters the list through a PrefixIndex.
+class EntityPicker {
+private:
+    const vector<string>& names;
+    string title;
+    PrefixIndex index;
+    string filter;
+    vector<PrefixIndex::Range> ranges; // ranges[i] matches the first i filter characters
+    vector<uint32_t> visible;
+    size_t selected;
+    size_t top;
+    FrameRenderer renderer;
+    
+    // Title, filter line and footer take nine rows, and the row under the
+    // frame holds the cursor
+    size_t pageRows() const {
+        size_t screenRows = Terminal::screenSize().first;
+        return screenRows > 10 ? screenRows - 10 : 1;
+    }
+    
+    void refilter() {
+        if (filter.empty()) {
+            visible.resize(names.size());
+            for (uint32_t id = 0; id < names.size(); id++) visible[id] = id;
+        } else {
+            visible = index.names(ranges.back());
+        }
+        selected = 0;
+        top = 0;
+    }
+    
+    void typeCharacter(char c) {
+        filter += tolower(static_cast<unsigned char>(c));
+        ranges.push_back(index.narrow(ranges.back(), filter));
+        refilter();
+    }
+    
+    void eraseCharacter() {
+        if (filter.empty()) return;
+        filter.pop_back();
+        ranges.pop_back();
+        refilter();
+    }
+    
+    void clearFilter() {
+        filter.clear();
+        ranges.resize(1);
+        refilter();
+    }
+    
+    // Cuts a row to the screen width without splitting a UTF-8 sequence
+    static string fitWidth(const string& text, size_t width) {
+        if (text.size() <= width) return text;
+        size_t cut = width;
+        while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) cut--;
+        return text.substr(0, cut);
+    }
+    
+    void display(size_t page) {
+        size_t width = Terminal::screenSize().second;
+        size_t nameWidth = width > 8 ? width - 8 : 1;
+        
+        // Keep the selection inside the viewport
+        if (selected < top) top = selected;
+        if (selected >= top + page) top = selected - page + 1;
+        
+        vector<string> rows;
+        rows.push_back("");
+        rows.push_back("  " + title);
+        rows.push_back("  " + string(title.length(), '='));
+        rows.push_back("  Filter: " + filter);
+        rows.push_back("");
+        
+        for (size_t row = 0; row < page; row++) {
+            size_t i = top + row;
+            if (i >= visible.size()) {
+                rows.push_back("");
+            } else if (i == selected) {
+                rows.push_back(Color::MENU_SELECTED + "  " + fitWidth(names[visible[i]], nameWidth) + "  " + Color::RESET);
+            } else {
+                rows.push_back("  " + fitWidth(names[visible[i]], nameWidth));
+            }
+        }
+        
+        rows.push_back("");
+        if (visible.empty()) {
+            rows.push_back("  No matches of " + to_string(names.size()));
+        } else {
+            rows.push_back("  " + to_string(top + 1) + "-" +
+                           to_string(min(top + page, visible.size())) + " of " +
+                           to_string(visible.size()) + " matches (" +
+                           to_string(names.size()) + " total)");
+        }
+        rows.push_back(fitWidth("  Type to filter, Up/Down/PgUp/PgDn/Home/End to move, Enter to select, Esc to clear or go back", width));
+        renderer.render(rows);
+    }
+    
+    int finish(int result) {
+        Terminal::write(Terminal::SHOW_CURSOR);
+        return result;
+    }
+
+public:
+    EntityPicker(const string& pickerTitle, const vector<string>& entityNames)
+        : names(entityNames), title(pickerTitle), index(entityNames),
+          selected(0), top(0) {
+        ranges.push_back(index.all());
+        refilter();
+    }
+    
+    // Returns the picked index into the names, or -1 if backed out
+    int show() {
+        Terminal::write(Terminal::HIDE_CURSOR);
+        while (true) {
+            size_t page = pageRows();
+            display(page);
+            
+            int key = Terminal::readKey();
+            size_t count = visible.size();
+            
+            switch (key) {
+                case Terminal::KEY_UP:
+                    if (selected > 0) selected--;
+                    break;
+                    
+                case Terminal::KEY_DOWN:
+                    if (selected + 1 < count) selected++;
+                    break;
+                    
+                case Terminal::KEY_PAGE_UP:
+                    selected -= min(selected, page);
+                    break;
+                    
+                case Terminal::KEY_PAGE_DOWN:
+                    if (count > 0) selected = min(selected + page, count - 1);
+                    break;
+                    
+                case Terminal::KEY_HOME:
+                    selected = 0;
+                    break;
+                    
+                case Terminal::KEY_END:
+                    if (count > 0) selected = count - 1;
+                    break;
+                    
+                case Terminal::KEY_ENTER:
+                    if (count > 0) return finish(visible[selected]);
+                    break;
+                    
+                case Terminal::KEY_BACKSPACE:
+                    eraseCharacter();
+                    break;
+                    
+                case Terminal::KEY_ESCAPE:
+                    if (filter.empty()) return finish(-1);
+                    clearFilter();
+                    break;
+                    
+                default:
+                    if (key >= 32 && key < 127) typeCharacter(static_cast<char>(key));
+                    break;
+            }
+        }
+    }
+    
+    static int pick(const string& title, const vector<string>& names) {
+        EntityPicker picker(title, names);
+        return picker.show();
+    }
+};
+
 // ============================================================================
 // DATA STRUCTURES
 // ============================================================================
 
+// createdAt of a tweet whose created_at did not parse. Such tweets are
+// scored but left out of trends and date buckets.
+static const long long invalidCreatedAt = LLONG_MIN;
+
+// One parsed tweets.csv record. Rows are parsed into this on the way in;
+// whole corpora are kept in a TweetTable.
 struct Tweet {
     string tweetId;
     string userId;
     string datetime;
     string senatorName;
     string text;
+    long long createdAt = 0; // datetime as epoch seconds (UTC), or invalidCreatedAt
+};
+
+// Fixed part of a tweet in a TweetTable: 40 bytes of integers. A record
+// whose id or timestamp text would not come back unchanged from the
+// integers is flagged verbatim and its original strings are kept aside.
+struct TweetRecord {
+    uint64_t tweetId;
+    uint64_t userId;
+    long long createdAt;     // epoch seconds (UTC)
+    uint64_t textOffset;     // into the table's text pool
+    uint32_t textLength;
+    uint32_t senatorId : 31; // into the table's intern table
+    uint32_t verbatim : 1;
+};
+
+// Compact in-memory corpus. Senator names are interned, every tweet's text
+// is a slice of one string pool, and ids and timestamps are integers, so a
+// tweet costs its text plus 40 bytes instead of five std::strings.
+// Views returned by text() stay valid until the next append().
+class TweetTable {
+public:
+    void reserve(size_t tweetCount, size_t textBytes);
+    void append(const Tweet& tweet);
+    void append(const TweetTable& other);
+    
+    size_t size() const { return records.size(); }
+    bool empty() const { return records.empty(); }
+    const TweetRecord& record(size_t i) const { return records[i]; }
+    string_view text(size_t i) const {
+        return string_view(textPool.data() + records[i].textOffset, records[i].textLength);
+    }
+    uint32_t senatorId(size_t i) const { return records[i].senatorId; }
+    const string& senatorName(size_t i) const { return senators[records[i].senatorId]; }
+    const vector<string>& senatorNames() const { return senators; } // intern id -> name
+    long long createdAt(size_t i) const { return records[i].createdAt; }
+    string tweetId(size_t i) const;
+    string userId(size_t i) const;
+    string datetime(size_t i) const;
+    size_t textBytes() const { return textPool.size(); }
+    size_t memoryBytes() const;
+
+private:
+    struct VerbatimFields {
+        string tweetId;
+        string userId;
+        string datetime;
+    };
+    
+    vector<TweetRecord> records;
+    string textPool;
+    vector<string> senators;
+    unordered_map<string, uint32_t> senatorIds;
+    unordered_map<size_t, VerbatimFields> verbatimFields; // record index -> original text
+};
+
+// Read-only view of a whole file: mapped on POSIX, read into memory on
+// Windows
+class MappedFile {
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+    string fallback;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    
+    bool open(const string& path);
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+// A record that was not loaded, for the rejects file
+struct RejectedRecord {
+    size_t line = 0;     // first physical line of the record
+    string reason;
+    string text;         // the record as it appeared in the file
+};
+
+// Cuts '|'-delimited records out of a buffer. Delimiters, newlines and
+// quotes are found 64 bytes at a time as bitmasks, and records are split at
+// the set bits, so unquoted data is never walked byte by byte. A field that
+// starts with '"' and whose closing quote is followed directly by '|', a
+// newline or the end of the input is quoted: it may hold '|' and newlines,
+// and "" inside it stands for one quote. A record with any other leading
+// quote (text after the closing quote, or no closing quote) is read again
+// as literal text ending at its first newline, the way it loaded before
+// quoting was supported. A quote anywhere else is an ordinary character.
+class RecordScanner {
+private:
+    const char* data;
+    size_t size;
+    size_t blockStart = 0;
+    uint64_t structural = 0;    // delimiters and newlines outside quotes left in this block
+    bool insideQuotes = false;  // quote state after the classified blocks
+    bool escapePending = false; // last block ended on the first quote of a ""
+    size_t position = 0;        // start of the next record
+    size_t limit;               // no record starts at or after this
+    size_t line = 1;
+    
+    uint64_t classifyBlock(size_t offset);
+    size_t nextStructural();
+    void splitLiteral(size_t start, vector<string>& fields, string_view& raw);
+
+public:
+    // Scans records that start in [start, stop). start must be a record
+    // boundary; the last record may run past stop.
+    RecordScanner(const char* bytes, size_t length, size_t start = 0, size_t stop = SIZE_MAX);
+    
+    // Fills fields with the next record and reports where it started,
+    // counting lines from 1 at start. Returns false at the end of the
+    // input or at stop. Blank lines are skipped.
+    bool next(vector<string>& fields, size_t& recordLine, string_view& raw);
+    
+    // Moves to the first record that starts at or after target
+    void skipTo(size_t target);
+    
+    size_t offset() const { return position; }  // start of the next record
+    size_t linesRead() const { return line - 1; }
+};
+
+
+// One worker's share of a parallel load. Lines in rejects count from 1 at
+// begin.
+struct ParsedChunk {
+    size_t begin = 0;
+    size_t end = 0;       // start of the first record at or past the range end
+    size_t lines = 0;     // physical lines in [begin, end)
+    TweetTable tweets;
+    vector<RejectedRecord> rejects;
 };
 
 struct SenatorStats {
@@ -248,7 +821,7 @@ struct SenatorStats {
 };
 
 struct TweetSentiment {
-    const Tweet* tweet = nullptr;
+    string_view text;
     int positiveCount = 0;
     int negativeCount = 0;
     int totalWords = 0;
@@ -262,11 +835,12 @@ struct TalkStats {
     double avgWordsPerTweet = 0.0;
 };
 
+// Scores for one tweet. The tweet itself stays in its TweetTable: row is
+// its index there, and the id, senator, date and text are read through the
+// table rather than copied.
 struct AdvancedTweetAnalysis {
-    string tweetId;
-    string senatorName;
-    string datetime;
-    string text;
+    size_t row = 0;
+    long long createdAt = 0;
 
     int totalWords = 0;
     int posWordCount = 0;
@@ -307,918 +881,7708 @@ struct AdvancedSenatorSummary {
     AdvancedTweetAnalysis mostNegativeTweet;
 };
 
-// ============================================================================
-// FUNCTION DECLARATIONS
-// ============================================================================
+// The advanced engine's tunable constants. The defaults are the values it
+// has always used.
+struct ScoringParams {
+    double negation = -0.7;         // multiplier for a word after a negation
+    double intensifier = 1.5;
+    double downtoner = 0.5;
+    int lookBack = 2;               // tokens before a word searched for modifiers
+    double exclamationBoost = 0.05; // per '!', applied to the whole tweet
+};
 
-// File I/O
-vector<vector<string>> read_tweets_csv_file();
-vector<string> readEmotionFile(string path);
+// Everything the advanced engine scores with: lexicon weights, the
+// modifier and marker word lists, n-gram and emoji/slang polarity, and the
+// tuning constants. Never modified once built, so scoring threads share
+// one through a shared_ptr<const ScoringModel> without locking. Marker
+// words are stored normalized, as tweet tokens are compared.
+struct ScoringModel {
+    unordered_map<string, double> wordPolarity;
+    unordered_set<string> negationWords;
+    unordered_set<string> intensifiers;
+    unordered_set<string> downtoners;
+    unordered_map<string, double> ngramPolarity;
+    unordered_set<string> positiveEmojisSlang;
+    unordered_set<string> negativeEmojisSlang;
+    ScoringParams params;
+    string source;                  // config file it came from, or "built-in"
+    uint64_t fingerprint = 0;       // scoringModelFingerprint of the above
+};
 
-// Data conversion and extraction
-vector<Tweet> convertToTweets(const vector<vector<string>>& rawData);
-vector<string> getUniqueSenators(const vector<Tweet>& tweets);
+// The current value of something a long-running process can replace while
+// other threads use it (read-copy-update). publish() swaps in a new
+// snapshot; threads that still hold the old one keep it alive until they
+// let go. Readers normally go through a SnapshotReader.
+template <typename T>
+class SnapshotHandle {
+private:
+    shared_ptr<const T> current;    // accessed only with atomic_load/atomic_store
+    atomic<uint64_t> version{0};
 
-// Word processing
-string normalizeWord(const string& raw);
-bool isAllCaps(const string& word);
-string escapeJsonString(const string& s);
+public:
+    explicit SnapshotHandle(shared_ptr<const T> initial) : current(move(initial)) {}
 
-// Part I: Base sentiment analysis
-unordered_set<string> buildLexiconSet(const vector<string>& words);
-vector<SenatorStats> computeBaseSenatorStats(
-    const vector<Tweet>& tweets,
-    const unordered_set<string>& positiveLexicon,
-    const unordered_set<string>& negativeLexicon
-);
-void printBaseSentimentTable(const vector<SenatorStats>& stats);
+    void publish(shared_ptr<const T> next) {
+        atomic_store(&current, move(next));
+        version.fetch_add(1, memory_order_release);
+    }
+    shared_ptr<const T> load() const { return atomic_load(&current); }
+    uint64_t currentVersion() const { return version.load(memory_order_acquire); }
+};
 
-// Part II Capability 1: Most positive/negative tweets
-TweetSentiment analyzeTweetLexiconOnly(
-    const Tweet& tweet,
-    const unordered_set<string>& positiveLexicon,
-    const unordered_set<string>& negativeLexicon
-);
-void showMostPositiveAndNegativeTweetForSenator(
-    const vector<Tweet>& tweets,
-    const unordered_set<string>& positiveLexicon,
-    const unordered_set<string>& negativeLexicon,
-    const string& senatorName
-);
+// One thread's view of a SnapshotHandle. get() costs a single atomic load
+// while nothing changes; after a publish it takes the new snapshot once.
+// The reference it returns stays valid until this thread's next get(), so
+// work started on the old snapshot finishes on it.
+template <typename T>
+class SnapshotReader {
+private:
+    const SnapshotHandle<T>& handle;
+    shared_ptr<const T> snapshot;
+    uint64_t seenVersion = UINT64_MAX;
 
-// Part II Capability 2: Talkative senators
-vector<TalkStats> computeTalkStats(const vector<Tweet>& tweets);
-void printTalkStatsAndMostTalkative(const vector<TalkStats>& stats);
+public:
+    explicit SnapshotReader(const SnapshotHandle<T>& source) : handle(source) {}
 
-// Extra Credit: Advanced sentiment engine
-unordered_map<string, double> buildWordPolarityMap(
-    const vector<string>& posWords,
-    const vector<string>& negWords
-);
-unordered_set<string> buildNegationWords();
-unordered_set<string> buildIntensifiers();
-unordered_set<string> buildDowntoners();
-unordered_map<string, double> buildNgramPolarity();
-unordered_set<string> buildPositiveEmojisSlang();
-unordered_set<string> buildNegativeEmojisSlang();
+    const T& get() {
+        uint64_t version = handle.currentVersion();
+        if (version != seenVersion) {
+            snapshot = handle.load();
+            seenVersion = version;
+        }
+        return *snapshot;
+    }
+    uint64_t version() const { return seenVersion; }
+};
 
-AdvancedTweetAnalysis analyzeTweetAdvanced(
-    const Tweet& tweet,
-    const unordered_map<string, double>& wordPolarity,
-    const unordered_set<string>& negationWords,
-    const unordered_set<string>& intensifiers,
-    const unordered_set<string>& downtoners,
-    const unordered_map<string, double>& ngramPolarity,
-    const unordered_set<string>& positiveEmojisSlang,
-    const unordered_set<string>& negativeEmojisSlang
-);
+// Polls scoring.conf from a background thread and publishes a new model
+// whenever the file's size or modification time changes. A file that
+// fails to parse is reported and the current model kept. onReload, if
+// set, runs on the watcher thread after each publish.
+class ScoringConfigWatcher {
+private:
+    SnapshotHandle<ScoringModel>& handle;
+    vector<string> posWords;
+    vector<string> negWords;
+    function<void(shared_ptr<const ScoringModel>)> onReload;
+    chrono::milliseconds interval;
+    atomic<bool> stopping{false};
+    thread worker;
 
-vector<AdvancedTweetAnalysis> analyzeAllTweetsAdvanced(
-    const vector<Tweet>& tweets,
-    const unordered_map<string, double>& wordPolarity,
-    const unordered_set<string>& negationWords,
-    const unordered_set<string>& intensifiers,
-    const unordered_set<string>& downtoners,
-    const unordered_map<string, double>& ngramPolarity,
-    const unordered_set<string>& positiveEmojisSlang,
-    const unordered_set<string>& negativeEmojisSlang
-);
+    void watch();
 
-vector<AdvancedSenatorSummary> summarizeAdvancedBySenator(
-    const vector<AdvancedTweetAnalysis>& perTweet
-);
+public:
+    ScoringConfigWatcher(
+        SnapshotHandle<ScoringModel>& target,
+        vector<string> positiveWords,
+        vector<string> negativeWords,
+        chrono::milliseconds pollInterval,
+        function<void(shared_ptr<const ScoringModel>)> reloaded = nullptr
+    );
+    ~ScoringConfigWatcher();
 
-// JSON export
-void writeAnalysisJson(
-    const vector<SenatorStats>& baseStats,
-    const vector<AdvancedSenatorSummary>& advancedSummaries,
-    const vector<AdvancedTweetAnalysis>& allTweetAnalyses,
+    ScoringConfigWatcher(const ScoringConfigWatcher&) = delete;
+    ScoringConfigWatcher& operator=(const ScoringConfigWatcher&) = delete;
+};
+
+// One contribution to a tweet's adjusted score, in token order. A lexicon
+// word records how far back the nearest negation, intensifier and
+// downtoner are (0 if none within the look-back); emoji, slang and n-gram
+// hits have none.
+struct ScoredTerm {
+    double weight = 0.0;
+    uint8_t negation = 0;
+    uint8_t intensifier = 0;
+    uint8_t downtoner = 0;
+};
+
+// One configuration's results in a parameter sweep. Per-senator vectors
+// follow the sweep's sorted senator names.
+struct SweepResult {
+    ScoringParams params;
+    double avgAdjusted = 0.0;
+    double positiveShare = 0.0;     // fraction of tweets scoring above 0
+    double negativeShare = 0.0;
+    double senatorSpread = 0.0;     // std. deviation of the senator averages
+    vector<double> senatorAvgAdjusted;
+    vector<double> senatorPositiveShare;
+    vector<double> senatorNegativeShare;
+};
+
+enum class ScoreKind { Base, Adjusted };
+enum class RankOrder { MostPositive, MostNegative };
+
+// Restricts a top-K query to a senator and a created_at range in epoch
+// seconds, fromTime inclusive and toTime exclusive
+struct TopKFilter {
+    int senatorId = -1; // -1 = all senators
+    long long fromTime = LLONG_MIN;
+    long long toTime = LLONG_MAX;
+
+    bool acceptsTime(long long createdAt) const;
+};
+
+// A ranked tweet (index into the analyses) or senator (senator id)
+struct RankedItem {
+    size_t index = 0;
+    double score = 0.0;
+};
+
+// Built once at load time so drill-down queries never rescan the corpus.
+// Senator ids are dense and follow sorted name order. Each senator's tweets
+// are laid out contiguously in tweetOrder (original file order within a
+// senator), and the lexicon-only extremes are cached per senator.
+// Holds views into the text of the tweets it was built from.
+struct SenatorIndex {
+    vector<string> names;                    // id -> name
+    unordered_map<string, int> idByName;
+    vector<int> senatorOfTweet;              // tweet index -> id
+    vector<size_t> tweetOffsets;             // id -> start in tweetOrder (size = ids + 1)
+    vector<size_t> tweetOrder;               // tweet indices grouped by senator
+    vector<TweetSentiment> lexiconScores;    // tweet index -> lexicon-only score
+    vector<size_t> mostPositiveTweet;        // id -> tweet index
+    vector<size_t> mostNegativeTweet;        // id -> tweet index
+
+    int findSenator(const string& name) const {
+        auto it = idByName.find(name);
+        return it == idByName.end() ? -1 : it->second;
+    }
+};
+
+enum class TrendBucket { Day, Week, Month };
+
+// Per-senator sentiment and volume per time bucket, stored as prefix sums
+// so any bucket range average is two subtractions. Series ids are senator
+// ids; the extra last series covers all senators. Each series row holds
+// bucketCount + 1 running totals, row[b] = sum of buckets [0, b).
+struct SentimentTrend {
+    TrendBucket bucket = TrendBucket::Day;
+    long long firstBucket = 0;
+    size_t bucketCount = 0;
+    int seriesCount = 0;
+    vector<double> basePrefix;
+    vector<double> adjustedPrefix;
+    vector<long long> countPrefix;
+
+    // Bucket holding a timestamp, clamped to [0, bucketCount]
+    size_t bucketOf(long long epochSeconds) const;
+    double rangeSum(int series, size_t fromBucket, size_t toBucket, ScoreKind kind) const;
+    long long rangeCount(int series, size_t fromBucket, size_t toBucket) const;
+    // False when the range holds no tweets
+    bool rangeAverage(int series, size_t fromBucket, size_t toBucket,
+                      ScoreKind kind, double& average) const;
+};
+
+// Dense group id per row for the group-by engine; ids are < groupCount.
+// A row keyed groupCount belongs to no group and is left out.
+struct GroupKeys {
+    vector<uint32_t> keys;
+    uint32_t groupCount = 0;
+};
+
+// Per-group statistics of one metric column, as flat arrays indexed by
+// group id. argMin/argMax are row indices (SIZE_MAX for empty groups).
+struct GroupAggregate {
+    vector<long long> count;
+    vector<double> sum;
+    vector<double> sumSquares;
+    vector<double> minValue;
+    vector<double> maxValue;
+    vector<size_t> argMin;
+    vector<size_t> argMax;
+
+    double mean(size_t group) const;
+    double variance(size_t group) const; // population variance
+};
+
+// Per-tweet metrics as columns, row i = analyses[i]
+struct TweetMetricColumns {
+    vector<double> totalWords;
+    vector<double> baseScore;
+    vector<double> adjustedScore;
+    vector<double> posPercent;
+    vector<double> negPercent;
+    vector<double> allCaps;
+    vector<double> exclamations;
+
+    // Column by command-line name, or nullptr
+    const vector<double>* find(const string& name) const;
+};
+
+// Near-duplicate clusters found by MinHash LSH. Every tweet belongs to
+// exactly one cluster; a tweet with no near-duplicates is a cluster of one.
+// The representative is the cluster's earliest tweet index.
+struct DuplicateClusters {
+    vector<uint32_t> clusterOf;       // tweet index -> cluster id
+    vector<uint32_t> clusterSize;     // cluster id -> tweets
+    vector<size_t> representative;    // cluster id -> first tweet index
+};
+
+enum class DedupMode { Exclude, DownWeight };
+
+// L2-normalized TF-IDF rows in compressed sparse row form. Row i's terms
+// are termIds[rowOffsets[i] .. rowOffsets[i + 1]), sorted by id.
+struct TfidfMatrix {
+    vector<string> terms;             // term id -> stemmed term
+    vector<size_t> rowOffsets;        // size = rows + 1
+    vector<uint32_t> termIds;
+    vector<float> weights;
+
+    size_t rows() const { return rowOffsets.empty() ? 0 : rowOffsets.size() - 1; }
+};
+
+// Spherical k-means result: unit-length centroids, stored densely as
+// k rows of terms.size() weights
+struct TopicModel {
+    size_t k = 0;
+    size_t dimensions = 0;
+    vector<float> centroids;
+    vector<uint32_t> assignment;      // row -> cluster, or k for rows with no terms
+    size_t iterations = 0;
+};
+
+// Running per-senator averages over the most recent tweets, bounded by a
+// tweet count, an age in seconds (relative to the newest created_at seen),
+// or both. Zero disables a bound. An undated tweet is older than any dated
+// one.
+class SlidingSentimentWindow {
+private:
+    struct Entry {
+        long long createdAt;
+        double baseScore;
+        double adjustedScore;
+    };
+    deque<Entry> entries;
+    double baseSum = 0.0;
+    double adjustedSum = 0.0;
+    long long newest = LLONG_MIN;
+
+public:
+    long long maxSeconds = 0;
+    size_t maxTweets = 0;
+
+    void add(long long createdAt, double baseScore, double adjustedScore);
+    size_t size() const { return entries.size(); }
+    double averageBase() const;
+    double averageAdjusted() const;
+};
+
+// Bounded lock-free single-producer/single-consumer ring buffer. Exactly
+// one thread may push and one other thread may pop. push() spins (with
+// yields) while the queue is full, which is what gives the pipeline its
+// backpressure. Capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+private:
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> head{0}; // next slot to pop (consumer-owned)
+    alignas(64) atomic<size_t> tail{0}; // next slot to push (producer-owned)
+    atomic<bool> closed{false};
+
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool tryPush(T& value) {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == slots.size()) return false;
+        slots[t & mask] = move(value);
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    void push(T&& value) {
+        while (!tryPush(value)) this_thread::yield();
+    }
+
+    bool tryPop(T& value) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) return false;
+        value = move(slots[h & mask]);
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    // Blocks until an item arrives; false once the queue is closed and drained
+    bool pop(T& value) {
+        while (true) {
+            if (tryPop(value)) return true;
+            if (closed.load(memory_order_acquire)) return tryPop(value);
+            this_thread::yield();
+        }
+    }
+
+    // Producer signals that no more items will be pushed
+    void close() { closed.store(true, memory_order_release); }
+};
+
+// Bump allocator for per-tweet scratch data (token lists, normalized
+// words). reset() rewinds to the start without freeing anything. If a
+// tweet outgrows the block, the overflow comes from the heap and the next
+// reset() swaps in one block big enough for it, so once the arena has
+// seen the largest tweet, scoring does no heap allocation.
+class ScratchArena : public pmr::memory_resource {
+private:
+    unique_ptr<char[]> block;
+    size_t capacity = 0;
+    size_t used = 0;
+    vector<unique_ptr<char[]>> overflow;
+    size_t overflowBytes = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit ScratchArena(size_t initialCapacity = 16 * 1024)
+        : block(new char[initialCapacity]), capacity(initialCapacity) {}
+
+    void reset();
+};
+
+// Line-delimited JSON export: one record per tweet as soon as it is scored,
+// then per-senator summary records and a closing run record. Output is
+// flushed whenever flushInterval has passed since the last flush (zero
+// means after every record), so consumers can follow a run in progress.
+class NdjsonSink {
+private:
+    ostream& out;
+    chrono::milliseconds flushInterval;
+    chrono::steady_clock::time_point lastFlush;
+    size_t records = 0;
+
+    void endRecord();
+
+public:
+    NdjsonSink(ostream& out, chrono::milliseconds flushInterval)
+        : out(out), flushInterval(flushInterval), lastFlush(chrono::steady_clock::now()) {}
+
+    void writeTweet(const Tweet& tweet, const AdvancedTweetAnalysis& analysis);
+    void writeSenatorSummary(const SenatorStats& base, const AdvancedSenatorSummary& summary);
+    void finish(size_t tweetCount, size_t senatorCount);
+    size_t recordCount() const { return records; }
+    bool writesToStdout() const { return &out == &cout; }
+};
+
+// Token counts by tweet polarity (0 = positive, 1 = negative adjusted
+// score; neutral tweets are not counted), corpus-wide and per senator.
+// Only term/senator pairs that occur are stored.
+struct PolarityCounts {
+    vector<string> terms;                                   // term id -> stemmed term
+    vector<array<uint64_t, 2>> corpus;                      // term id -> counts
+    unordered_map<uint64_t, array<uint32_t, 2>> bySenator;  // (senator << 32 | term) -> counts
+    vector<array<uint64_t, 2>> senatorTotals;               // senator id -> tokens per class
+    array<uint64_t, 2> totals{};
+};
+
+struct TermAssociation {
+    uint32_t term = 0;
+    uint32_t positive = 0;
+    uint32_t negative = 0;
+    double logOdds = 0.0;       // positive vs negative, with the prior
+    double zScore = 0.0;
+    double pmi = 0.0;           // PMI(term, positive)
+};
+
+// Count-Min sketch: depth rows of width counters. An estimate never
+// undercounts, and with probability 1 - delta it overcounts by at most
+// epsilon * N (N = total count added), for width = ceil(e / epsilon) and
+// depth = ceil(ln(1 / delta)).
+class CountMinSketch {
+private:
+    size_t width = 0;
+    size_t depth = 0;
+    vector<uint32_t> counters;
+
+public:
+    CountMinSketch() = default;
+    CountMinSketch(double epsilon, double delta);
+
+    void add(uint64_t hash, uint32_t count = 1);
+    uint32_t estimate(uint64_t hash) const;
+    void merge(const CountMinSketch& other);    // same dimensions only
+    size_t bytes() const { return counters.size() * sizeof(uint32_t); }
+    // What the constructor would allocate, as a double so that a tiny
+    // epsilon can be refused before anything is allocated or overflows
+    static double bytesFor(double epsilon, double delta);
+};
+
+// Space-Saving heavy hitters over at most `capacity` tracked words, kept
+// in a min-heap by count. Each entry's true count lies in
+// [count - error, count], and every word occurring more than N / capacity
+// times is guaranteed to be tracked. Merging follows Agarwal et al.'s
+// mergeable summaries, which keeps the same N / capacity guarantee.
+class SpaceSaving {
+public:
+    struct Entry {
+        string word;
+        uint64_t count = 0;
+        uint64_t error = 0;
+    };
+
+private:
+    size_t capacity = 0;
+    vector<Entry> heap;
+    unordered_map<string, size_t> position;
+
+    void swapEntries(size_t a, size_t b);
+    void siftDown(size_t i);
+    void siftUp(size_t i);
+    uint64_t minimum() const { return heap.size() < capacity || heap.empty() ? 0 : heap[0].count; }
+
+public:
+    explicit SpaceSaving(size_t capacity = 0) : capacity(capacity) {}
+
+    void add(const string& word, uint64_t count = 1);
+    void merge(const SpaceSaving& other);
+    vector<Entry> top() const;                  // by count, descending
+};
+
+// HyperLogLog distinct counter with 2^precision one-byte registers;
+// relative standard error is about 1.04 / sqrt(2^precision).
+class HyperLogLog {
+private:
+    int precision = 0;
+    vector<uint8_t> registers;
+
+public:
+    explicit HyperLogLog(int precision = 12) : precision(precision), registers((size_t)1 << precision, 0) {}
+
+    void add(uint64_t hash);
+    void merge(const HyperLogLog& other);       // same precision only
+    double estimate() const;
+    double relativeError() const { return 1.04 / sqrt((double)registers.size()); }
+};
+
+// Fixed-size word statistics for one slice of the corpus (a senator, a
+// thread's share, or everything), all mergeable
+struct WordSketches {
+    CountMinSketch counts;
+    SpaceSaving heavyHitters;
+    HyperLogLog vocabulary;
+    uint64_t tokens = 0;
+
+    WordSketches() = default;
+    WordSketches(double epsilon, double delta, size_t heavyHitterCapacity, int hllPrecision)
+        : counts(epsilon, delta), heavyHitters(heavyHitterCapacity), vocabulary(hllPrecision) {}
+
+    void add(const string& word);
+    void merge(const WordSketches& other);
+};
+
+// A senator's most positive or negative tweet by lexicon-only score, with
+// the counts the extremes menu shows
+struct LexiconExtreme {
+    uint64_t offset = UINT64_MAX;   // record's byte offset in tweets.csv
+    int positiveCount = 0;
+    int negativeCount = 0;
+    int totalWords = 0;
+    int rawScore = 0;
+    string text;
+};
+
+// A senator's most positive or negative tweet by adjusted score. A partial
+// has no TweetTable to point into, so the tweet's fields travel with it.
+struct AdvancedExtreme {
+    Tweet tweet;
+    AdvancedTweetAnalysis analysis;
+};
+
+// One senator's share of a shard, kept as totals, sums and extremes so
+// that partials merge exactly. Extremes carry their record's byte offset
+// in tweets.csv, so ties still go to the earlier record as in a single run.
+struct PartialSenatorAggregate {
+    string name;
+    long long tweets = 0;
+    long long words = 0;
+    long long positiveWords = 0;
+    long long negativeWords = 0;
+    double sums[6] = {};            // base, adjusted, pos %, neg %, all caps, exclamations
+    LexiconExtreme lexiconMostPositive;
+    LexiconExtreme lexiconMostNegative;
+    uint64_t mostPositiveOffset = UINT64_MAX;
+    uint64_t mostNegativeOffset = UINT64_MAX;
+    AdvancedExtreme mostPositiveTweet;
+    AdvancedExtreme mostNegativeTweet;
+};
+
+// How a run was split: equal byte ranges of tweets.csv (a record belongs
+// to the range holding its first byte) or senator name hash modulo count
+enum class ShardMode : uint32_t { ByteRange = 0, SenatorHash = 1 };
+
+// Aggregates for one or more shards of the same split of the same input
+struct PartialAggregate {
+    ShardMode mode = ShardMode::ByteRange;
+    uint32_t shardCount = 1;
+    uint64_t inputSize = 0;         // size of tweets.csv when the shards ran
+    uint64_t modelFingerprint = 0;  // the ScoringModel the shards were scored with
+    uint64_t rejected = 0;          // records the shards skipped as not tweets
+    vector<uint32_t> shards;        // shard numbers covered, sorted
+    map<string, PartialSenatorAggregate> senators;
+};
+
+// Reads one shard of tweets.csv in file order, with each record's byte
+// offset. Byte ranges split everything after the header into equal
+// slices and a record belongs to the slice holding its first byte, so
+// every record lands in exactly one shard whatever the line lengths.
+class ShardReader {
+private:
+    MappedFile file;
+    unique_ptr<RecordScanner> scanner;
+    ShardMode mode = ShardMode::ByteRange;
+    uint32_t shard = 0;
+    uint32_t shardCount = 1;
+    size_t lineBase = 0;            // lines before the scanner's start
+    vector<string> row;
+
+public:
+    // A nonzero resumeOffset is a position() saved by an earlier reader
+    // of the same shard
+    bool open(ShardMode mode, uint32_t shard, uint32_t shardCount, uint64_t resumeOffset = 0);
+    // Records that are not tweets are added to rejects, with their line
+    // in the file. Every record is in one byte range, so each shard reports
+    // its own; with senator hashing only shard 0 reports them.
+    bool next(Tweet& tweet, uint64_t& recordOffset, vector<RejectedRecord>& rejects);
+    uint64_t size() const { return file.size(); }
+    uint64_t position() const { return scanner ? scanner->offset() : 0; }  // start of the next record
+};
+
+// A long run's progress: the aggregates of every record before
+// resumeOffset. Replaced atomically, so a crash leaves the previous one.
+struct RunCheckpoint {
+    uint64_t resumeOffset = 0;
+    uint64_t records = 0;
+    PartialAggregate partial;
+    vector<RejectedRecord> rejects; // records before resumeOffset that are not tweets
+};
+
+// When to checkpoint: after everyRecords records or everySeconds seconds,
+// whichever comes first. An empty path disables checkpointing.
+struct CheckpointPolicy {
+    string path;
+    uint64_t everyRecords = 100000;
+    double everySeconds = 10.0;
+};
+
+// On-disk inverted index (see buildInvertedIndex for the layout). Fixed
+// records are written in host byte order and read back in place from the
+// memory map, so an index is only portable between machines of the same
+// endianness.
+struct IndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t docCount;
+    uint32_t termCount;
+    uint32_t senatorCount;
+    uint64_t docsOffset;        // IndexedDoc[docCount]
+    uint64_t senatorsOffset;    // uint64_t[senatorCount], offsets into strings
+    uint64_t termsOffset;       // IndexedTerm[termCount], sorted by term
+    uint64_t stringsOffset;     // varint length + bytes, back to back
+    uint64_t postingsOffset;
+    uint64_t fileSize;
+};
+
+struct IndexedDoc {
+    uint64_t stringOffset;      // tweet id, then text
+    uint32_t senatorId;
+    float baseScore;
+    float adjustedScore;
+    uint32_t reserved;
+};
+
+struct IndexedTerm {
+    uint64_t nameOffset;        // into strings
+    uint64_t postingsOffset;    // relative to postingsOffset
+    uint32_t docFreq;
+    uint32_t skipCount;
+};
+
+// One skip entry per block of postings: the block's first tweet and where
+// its encoding starts, relative to the end of the skip table
+struct PostingsSkip {
+    uint32_t firstDoc;
+    uint32_t byteOffset;
+};
+
+// Read-only view of an index file, memory-mapped where the platform
+// allows and read into memory otherwise
+class InvertedIndex {
+private:
+    const unsigned char* base = nullptr;
+    size_t size = 0;
+    vector<unsigned char> fallback;
+    const IndexFileHeader* header = nullptr;
+
+public:
+    InvertedIndex() = default;
+    InvertedIndex(const InvertedIndex&) = delete;
+    InvertedIndex& operator=(const InvertedIndex&) = delete;
+    ~InvertedIndex();
+
+    bool open(const string& path);
+
+    uint32_t docCount() const { return header->docCount; }
+    uint32_t senatorCount() const { return header->senatorCount; }
+    const IndexedDoc& doc(uint32_t id) const {
+        return ((const IndexedDoc*)(base + header->docsOffset))[id];
+    }
+    string_view stringAt(uint64_t offset) const;
+    string_view tweetId(uint32_t id) const { return stringAt(doc(id).stringOffset); }
+    string_view text(uint32_t id) const;
+    string_view senatorName(uint32_t id) const {
+        return stringAt(((const uint64_t*)(base + header->senatorsOffset))[id]);
+    }
+    const IndexedTerm* findTerm(const string& term) const;
+    const unsigned char* postings(const IndexedTerm& term) const {
+        return base + header->postingsOffset + term.postingsOffset;
+    }
+};
+
+// Walks one term's postings in tweet order. advance() uses the skip table
+// to jump straight to the block that may hold the target, so intersecting
+// a short list with a long one touches only the long list's useful blocks.
+class PostingsCursor {
+private:
+    const PostingsSkip* skips = nullptr;
+    const unsigned char* data = nullptr;
+    const unsigned char* next = nullptr;
+    uint32_t docFreq = 0;
+    uint32_t skipCount = 0;
+    uint32_t block = 0;
+    uint32_t read = 0;                  // postings decoded so far
+    uint32_t current = UINT32_MAX;
+    uint32_t positionCount = 0;
+    const unsigned char* positionData = nullptr;
+
+    void enterBlock(uint32_t b);
+
+public:
+    PostingsCursor(const InvertedIndex& index, const IndexedTerm& term);
+
+    bool atEnd() const { return current == UINT32_MAX; }
+    uint32_t doc() const { return current; }
+    void step();
+    void advance(uint32_t target);      // to the first posting >= target
+    void positions(vector<uint32_t>& out) const;
+};
+
+struct SearchOptions {
+    ScoreKind kind = ScoreKind::Adjusted;
+    int senatorId = -1;
+    bool hasMin = false, hasMax = false;
+    double minScore = 0.0, maxScore = 0.0;
+    int order = 0;                      // 0 = tweet order, 1 = descending, -1 = ascending
+    size_t limit = 20;
+};
+
+// Everything the query daemon needs, loaded and scored once at startup.
+// Read-only after loadCorpusState() returns, so client threads share it
+// without locking.
+struct CorpusState {
+    TweetTable tweets;
+    SenatorIndex senatorIndex;
+    vector<SenatorStats> baseStats;
+    vector<TalkStats> talkStats;
+    vector<AdvancedTweetAnalysis> analyses;
+    vector<AdvancedSenatorSummary> summaries;
+    SentimentTrend trends[3]; // indexed by TrendBucket
+    shared_ptr<const ScoringModel> model;
+
+    // Senator name -> index into baseStats / talkStats / summaries
+    unordered_map<string, size_t> baseIndex;
+    unordered_map<string, size_t> talkIndex;
+    unordered_map<string, size_t> summaryIndex;
+};
+
+// ============================================================================
+// FUNCTION DECLARATIONS
+// ============================================================================
+
+// File I/O
+TweetTable read_tweets_csv_file();
+TweetTable parseTweetTable(const MappedFile& file, size_t threadCount, vector<RejectedRecord>& rejects);
+vector<string> readEmotionFile(string path);
+bool writeRejectedRecords(const vector<RejectedRecord>& rejects, const string& path);
+void reportRejectedRecords(const vector<RejectedRecord>& rejects, const string& path);
+
+// Data conversion and extraction
+bool endsInsideQuotedField(string_view text);
+string tweetRowProblem(const vector<string>& row);
+Tweet tweetFromRow(const vector<string>& row);
+bool parseRecordId(const string& text, uint64_t& value);
+long long daysFromCivil(int year, int month, int day);
+void civilFromDays(long long days, long long& year, int& month, int& day);
+string formatCivilDate(long long days);
+string formatIsoTimestamp(long long epochSeconds);
+bool parseIsoTimestamp(const string& text, long long& epochSeconds);
+
+// Word processing
+string normalizeWord(const string& raw);
+size_t normalizeWordInto(string_view raw, char* out);
+bool isAllCaps(string_view word);
+ScratchArena& tweetScratchArena();
+string escapeJsonString(string_view s);
+
+// Group-by aggregation
+GroupKeys groupKeysFromIds(const vector<int>& ids, uint32_t groupCount);
+GroupKeys groupKeysFromNames(const vector<string>& values, vector<string>& names);
+GroupKeys dateBucketKeys(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    TrendBucket bucket,
+    vector<string>& bucketNames
+);
+GroupKeys combineGroupKeys(const GroupKeys& outer, const GroupKeys& inner);
+GroupAggregate groupByAggregate(const GroupKeys& keys, const vector<double>& values);
+TweetMetricColumns buildMetricColumns(const vector<AdvancedTweetAnalysis>& analyses);
+int runGroupByReport(const string& dimensions, const string& metric);
+
+// Part I: Base sentiment analysis
+unordered_set<string> buildLexiconSet(const vector<string>& words);
+vector<SenatorStats> computeBaseSenatorStats(const SenatorIndex& index);
+void printBaseSentimentTable(const vector<SenatorStats>& stats);
+
+// Part II Capability 1: Most positive/negative tweets
+TweetSentiment analyzeTweetLexiconOnly(
+    string_view text,
+    const unordered_set<string>& positiveLexicon,
+    const unordered_set<string>& negativeLexicon
+);
+SenatorIndex buildSenatorIndex(
+    const TweetTable& tweets,
+    const unordered_set<string>& positiveLexicon,
+    const unordered_set<string>& negativeLexicon
+);
+SenatorIndex buildSenatorIndex(
+    const TweetTable& tweets,
+    vector<TweetSentiment> lexiconScores
+);
+void showMostPositiveAndNegativeTweetForSenator(
+    const SenatorIndex& index,
+    const string& senatorName
+);
+
+// Part II Capability 2: Talkative senators
+vector<TalkStats> computeTalkStats(const SenatorIndex& index);
+void printTalkStatsAndMostTalkative(const vector<TalkStats>& stats);
+
+// Extra Credit: Advanced sentiment engine
+unordered_map<string, double> buildWordPolarityMap(
+    const vector<string>& posWords,
+    const vector<string>& negWords
+);
+unordered_set<string> buildNegationWords();
+unordered_set<string> buildIntensifiers();
+unordered_set<string> buildDowntoners();
+unordered_map<string, double> buildNgramPolarity();
+unordered_set<string> buildPositiveEmojisSlang();
+unordered_set<string> buildNegativeEmojisSlang();
+
+AdvancedTweetAnalysis analyzeTweetAdvanced(const Tweet& tweet, const ScoringModel& model);
+void scoreTweetText(string_view text, const ScoringModel& model, AdvancedTweetAnalysis& analysis);
+void collectScoredTerms(
+    string_view text,
+    const ScoringModel& model,
+    int maxLookBack,
+    AdvancedTweetAnalysis& analysis,
+    pmr::vector<ScoredTerm>& terms
+);
+vector<AdvancedTweetAnalysis> analyzeAllTweetsAdvanced(const TweetTable& tweets, const ScoringModel& model);
+
+// Scoring model and hot reload
+shared_ptr<const ScoringModel> buildBuiltInScoringModel(
+    const vector<string>& posWords,
+    const vector<string>& negWords
+);
+shared_ptr<const ScoringModel> parseScoringConfig(
+    const string& path,
+    const vector<string>& posWords,
+    const vector<string>& negWords,
+    string& error
+);
+shared_ptr<const ScoringModel> loadScoringModel(
+    const vector<string>& posWords,
+    const vector<string>& negWords
+);
+uint64_t scoringModelFingerprint(const ScoringModel& model);
+
+vector<AdvancedSenatorSummary> summarizeAdvancedBySenator(
+    const TweetTable& tweets,
+    const vector<AdvancedTweetAnalysis>& perTweet
+);
+vector<AdvancedSenatorSummary> summarizeAdvancedBySenator(
+    const TweetTable& tweets,
+    const vector<AdvancedTweetAnalysis>& perTweet,
+    const vector<double>& weights
+);
+
+// Near-duplicate detection
+vector<uint64_t> minHashSignatures(const TweetTable& tweets, size_t threadCount);
+DuplicateClusters findNearDuplicates(const TweetTable& tweets, double threshold, size_t threadCount);
+vector<double> dedupWeights(const DuplicateClusters& clusters, DedupMode mode);
+int runDedupReport(double threshold, DedupMode mode);
+
+// Topic clustering
+unordered_set<string> buildStopWords();
+TfidfMatrix buildTfidfMatrix(
+    const TweetTable& tweets,
+    const unordered_set<string>& stopWords,
+    size_t minDocFreq,
+    size_t threadCount
+);
+TopicModel kMeansTopics(const TfidfMatrix& matrix, size_t k, size_t maxIterations, size_t threadCount);
+int runTopicReport(size_t k, size_t maxIterations);
+
+// Word-sentiment association
+PolarityCounts countTermPolarity(
+    const TweetTable& tweets,
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    const unordered_set<string>& excluded,
+    size_t threadCount
+);
+vector<TermAssociation> rankTermAssociations(
+    const PolarityCounts& counts,
+    int senatorId,
+    double priorStrength,
+    uint32_t minCount
+);
+int runAssociationReport(size_t top, double priorStrength);
+
+// Approximate word statistics
+vector<WordSketches> sketchSenatorWords(
+    const TweetTable& tweets,
+    const SenatorIndex& index,
+    const WordSketches& prototype,
+    size_t threadCount
+);
+int runSketchReport(size_t top, double epsilon);
+
+// Top-K ranking engine
+double scoreOf(const AdvancedTweetAnalysis& analysis, ScoreKind kind);
+vector<RankedItem> topKTweets(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    size_t k,
+    ScoreKind kind,
+    RankOrder order,
+    const TopKFilter& filter
+);
+vector<RankedItem> topKSenators(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    size_t k,
+    ScoreKind kind,
+    RankOrder order,
+    const TopKFilter& filter
+);
+
+// Sentiment trends
+const char* trendBucketName(TrendBucket bucket);
+bool parseTrendBucket(const string& name, TrendBucket& bucket);
+long long absoluteBucket(long long epochSeconds, TrendBucket bucket);
+string bucketStartDate(long long absolute, TrendBucket bucket);
+SentimentTrend buildSentimentTrend(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    TrendBucket bucket
+);
+void writeTrendJson(
+    const SentimentTrend& trend,
+    const SenatorIndex& index,
+    size_t window,
+    const string& filename
+);
+
+// JSON export
+void writeAnalysisJson(
+    const vector<SenatorStats>& baseStats,
+    const vector<AdvancedSenatorSummary>& advancedSummaries,
+    const TweetTable& tweets,
+    const vector<AdvancedTweetAnalysis>& allTweetAnalyses,
     const string& filename
 );
+string formatTweetJson(const TweetTable& tweets, const AdvancedTweetAnalysis& t);
+string formatTweetJson(const Tweet& tweet, const AdvancedTweetAnalysis& t);
+void writeSenatorStatsJson(
+    ostream& out,
+    const SenatorStats& base,
+    const AdvancedSenatorSummary& summary,
+    const string& indent
+);
+void writeTweetDetailJson(ostream& out, const TweetTable& tweets, const AdvancedTweetAnalysis& t, const string& indent);
+uint64_t fnv1aHash(const string& data);
+string shardFileName(const string& senatorName);
+int exportSenatorShards(const CorpusState& state, const string& directory, size_t threadCount);
+
+// Partial aggregates for multi-process runs
+void addTweetToPartial(
+    PartialSenatorAggregate& partial,
+    uint64_t offset,
+    const Tweet& tweet,
+    const TweetSentiment& lexiconScore,
+    const AdvancedTweetAnalysis& analysis
+);
+bool mergePartialAggregates(PartialAggregate& into, const PartialAggregate& from, string& error);
+bool writeFileAtomically(const string& path, const vector<unsigned char>& data);
+bool writePartialAggregate(const PartialAggregate& partial, const string& path);
+bool readPartialAggregate(const string& path, PartialAggregate& partial);
+bool writeRunCheckpoint(const RunCheckpoint& checkpoint, const string& path);
+bool readRunCheckpoint(const string& path, RunCheckpoint& checkpoint);
+bool writeMergedAnalysisJson(const PartialAggregate& partial, const string& path);
+int runPartial(
+    const string& path,
+    ShardMode mode,
+    uint32_t shard,
+    uint32_t shardCount,
+    const CheckpointPolicy& checkpoint
+);
+int runMergePartials(const string& outputPath, const vector<string>& inputPaths);
+
+// Query daemon
+CorpusState loadCorpusState(shared_ptr<const ScoringModel> model = nullptr);
+string answerQuery(const CorpusState& state, const string& request);
+int runQueryDaemon(const string& socketPath);
+int runQueryClient(const string& socketPath, const string& request);
+
+// Inverted index and keyword search
+int buildInvertedIndex(const CorpusState& state, const string& path);
+int runSearch(const string& indexPath, const string& request);
+
+// Streaming scorer
+int runStreamingScorer(istream& input, long long windowSeconds, size_t windowTweets);
+
+// Pipelined batch run
+int runPipeline(const string& outputFile, size_t chunkSize, NdjsonSink* ndjson = nullptr);
+
+// Allocation self-check
+int runAllocationCheck();
+
+// Stemmer verification
+int runStemmerVerification(const vector<string>& wordLists);
+
+// Parallel load verification
+int runLoadVerification(size_t threadCount);
+
+// Scoring parameter sweep
+bool parseSweepGrid(
+    const vector<string>& specs,
+    const ScoringParams& defaults,
+    vector<ScoringParams>& grid,
+    string& csvPath
+);
+vector<SweepResult> sweepScoringParams(
+    const TweetTable& tweets,
+    const ScoringModel& model,
+    const vector<ScoringParams>& grid,
+    vector<string>& senatorNames,
+    size_t threadCount
+);
+int runSweepReport(const vector<string>& specs);
+
+// Command-line modes
+void printUsage(const char* program);
+int runCommandLine(int argc, char* argv[]);
+
+// ============================================================================
+// FILE I/O IMPLEMENTATIONS
+// ============================================================================
+
+// Parsed in parallel, one chunk per core for files of a few megabytes or
+// more. Records that can't be loaded are listed with their line numbers in
+// tweets_rejects.tsv.
+TweetTable read_tweets_csv_file()
+{
+    MappedFile file;
+    if (!file.open("tweets.csv")) {
+        cerr << "Error: Could not open tweets.csv" << endl;
+        return TweetTable();
+    }
+    
+    const size_t minChunkBytes = 1 << 20;
+    size_t threadCount = min<size_t>(max(1u, thread::hardware_concurrency()), file.size() / minChunkBytes + 1);
+    vector<RejectedRecord> rejects;
+    TweetTable tweets = parseTweetTable(file, threadCount, rejects);
+    reportRejectedRecords(rejects, "tweets_rejects.tsv");
+    return tweets;
+}
+
+vector<string> readEmotionFile(string path)
+{
+    vector<string> emotionWords;
+    fstream newfile;
+    newfile.open(path, ios::in);
+    
+    if(newfile.is_open()) {
+        string line;
+        while(getline(newfile, line)) {
+            if (!line.empty())
+                emotionWords.push_back(line);
+        }
+        newfile.close();
+    }
+    return emotionWords;
+}
+
+// Parses the records starting in [begin, stop), skipping the file's header
+// record when begin is 0. Rows go straight into the compact table; its
+// pool is reserved at the range size, which bounds the text, and pages it
+// never touches stay out of the resident set.
+static void parseChunk(const MappedFile& file, size_t begin, size_t stop, ParsedChunk& chunk)
+{
+    chunk = ParsedChunk();
+    chunk.begin = begin;
+    if (stop > begin) chunk.tweets.reserve(0, stop - begin);
+    
+    RecordScanner scanner(file.data(), file.size(), begin, stop);
+    vector<string> row;
+    size_t line;
+    string_view raw;
+    bool header = begin == 0;
+    
+    while (scanner.next(row, line, raw)) {
+        if (header) {
+            header = false;
+            continue;
+        }
+        string reason = tweetRowProblem(row);
+        if (reason.empty()) {
+            chunk.tweets.append(tweetFromRow(row));
+        } else {
+            chunk.rejects.push_back({line, reason, string(raw)});
+        }
+    }
+    chunk.end = max(begin, scanner.offset());
+    chunk.lines = scanner.linesRead();
+}
+
+// Splits the file into one byte range per thread and parses them at once.
+// Each range after the first starts just past the first newline at or
+// after its nominal start, on the guess that the newline ends a record.
+// The guess only fails when that newline is inside a quoted field. The
+// chunks are stitched in file order, and a chunk whose start does not
+// match where the previous one really stopped is parsed again from there.
+// The result, row ids included, matches a single-threaded parse.
+TweetTable parseTweetTable(const MappedFile& file, size_t threadCount, vector<RejectedRecord>& rejects)
+{
+    const char* data = file.data();
+    size_t size = file.size();
+    threadCount = max<size_t>(1, threadCount);
+    
+    vector<size_t> starts(threadCount + 1, size);
+    starts[0] = 0;
+    for (size_t k = 1; k < threadCount; k++) {
+        size_t nominal = size * k / threadCount;
+        const void* newline = nominal > 0 ? memchr(data + nominal - 1, '\n', size - nominal + 1) : data;
+        starts[k] = newline ? (const char*)newline - data + (nominal > 0) : size;
+        starts[k] = max(starts[k], starts[k - 1]);
+    }
+    
+    vector<ParsedChunk> chunks(threadCount);
+    vector<thread> workers;
+    for (size_t k = 1; k < threadCount; k++) {
+        workers.emplace_back(parseChunk, cref(file), starts[k], starts[k + 1], ref(chunks[k]));
+    }
+    parseChunk(file, starts[0], starts[1], chunks[0]);
+    for (thread& t : workers) t.join();
+    
+    size_t end = chunks[0].end;
+    for (size_t k = 1; k < threadCount; k++) {
+        if (chunks[k].begin != end) parseChunk(file, end, starts[k + 1], chunks[k]);
+        end = chunks[k].end;
+    }
+    
+    rejects.clear();
+    if (threadCount == 1) {
+        rejects = move(chunks[0].rejects);
+        return move(chunks[0].tweets);
+    }
+    
+    // Size the destination once, then copy each chunk in
+    size_t tweetCount = 0, textBytes = 0;
+    for (const ParsedChunk& chunk : chunks) {
+        tweetCount += chunk.tweets.size();
+        textBytes += chunk.tweets.textBytes();
+    }
+    TweetTable tweets;
+    tweets.reserve(tweetCount, textBytes);
+    size_t lines = 0;
+    for (ParsedChunk& chunk : chunks) {
+        tweets.append(chunk.tweets);
+        for (RejectedRecord& reject : chunk.rejects) {
+            reject.line += lines;
+            rejects.push_back(move(reject));
+        }
+        lines += chunk.lines;
+        chunk = ParsedChunk();
+    }
+    return tweets;
+}
+
+// One line per record: line number, reason, and the record with tabs,
+// newlines and backslashes escaped so it stays on its line
+bool writeRejectedRecords(const vector<RejectedRecord>& rejects, const string& path)
+{
+    ofstream out(path);
+    if (!out.is_open()) {
+        cerr << "Error: Could not write " << path << endl;
+        return false;
+    }
+    out << "line\treason\trecord\n";
+    for (const RejectedRecord& reject : rejects) {
+        out << reject.line << '\t' << reject.reason << '\t';
+        for (char c : reject.text) {
+            switch (c) {
+                case '\t': out << "\\t"; break;
+                case '\n': out << "\\n"; break;
+                case '\r': out << "\\r"; break;
+                case '\\': out << "\\\\"; break;
+                default: out << c;
+            }
+        }
+        out << '\n';
+    }
+    return true;
+}
+
+// Warns about skipped records and lists them in path, or removes path when
+// there are none, since a list left over from an earlier file would be
+// misleading
+void reportRejectedRecords(const vector<RejectedRecord>& rejects, const string& path)
+{
+    if (!rejects.empty()) {
+        cerr << "Warning: Skipped " << rejects.size() << " records in tweets.csv";
+        if (writeRejectedRecords(rejects, path)) cerr << " (listed in " << path << ")";
+        cerr << endl;
+    } else {
+        error_code ignored;
+        filesystem::remove(path, ignored);
+    }
+}
+
+// ============================================================================
+// RECORD SCANNER
+// ============================================================================
+
+bool MappedFile::open(const string& path)
+{
+    #ifdef _WIN32
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) return false;
+    fallback.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    base = fallback.data();
+    length = fallback.size();
+    return true;
+    #else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    length = info.st_size;
+    if (length == 0) {
+        close(fd);
+        base = fallback.data();
+        return true;
+    }
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        length = 0;
+        return false;
+    }
+    madvise(mapped, length, MADV_SEQUENTIAL);
+    base = (const char*)mapped;
+    return true;
+    #endif
+}
+
+MappedFile::~MappedFile()
+{
+    #ifndef _WIN32
+    if (length > 0) munmap((void*)base, length);
+    #endif
+}
+
+// Index of the lowest set bit of a nonzero mask
+static inline unsigned lowestBit(uint64_t mask)
+{
+    #if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+    #else
+    unsigned bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+    #endif
+}
+
+// Bit i of each mask is set when byte i of the 64-byte block is '|', '\n'
+// or '"'. SSE2 compares 16 bytes per instruction and AVX2 32; other
+// targets fall back to a loop.
+static inline void classifyBytes(const char* p, uint64_t& delimiters, uint64_t& newlines, uint64_t& quotes)
+{
+    #if defined(__AVX2__)
+    const __m256i pipe = _mm256_set1_epi8('|'), newline = _mm256_set1_epi8('\n'), quote = _mm256_set1_epi8('"');
+    __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+    auto mask = [&](__m256i needle) {
+        uint64_t low = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+        uint64_t high = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+        return low | (high << 32);
+    };
+    delimiters = mask(pipe);
+    newlines = mask(newline);
+    quotes = mask(quote);
+    #elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i pipe = _mm_set1_epi8('|'), newline = _mm_set1_epi8('\n'), quote = _mm_set1_epi8('"');
+    __m128i chunk[4];
+    for (int i = 0; i < 4; i++) chunk[i] = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+    auto mask = [&](__m128i needle) {
+        uint64_t bits = 0;
+        for (int i = 0; i < 4; i++) {
+            bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk[i], needle)) << (16 * i);
+        }
+        return bits;
+    };
+    delimiters = mask(pipe);
+    newlines = mask(newline);
+    quotes = mask(quote);
+    #else
+    delimiters = newlines = quotes = 0;
+    for (int i = 0; i < 64; i++) {
+        delimiters |= (uint64_t)(p[i] == '|') << i;
+        newlines |= (uint64_t)(p[i] == '\n') << i;
+        quotes |= (uint64_t)(p[i] == '"') << i;
+    }
+    #endif
+}
+
+// Strips the quotes from a quoted field and collapses "" to "; other
+// fields are copied as they are. Returns false if a leading quote is not
+// closed at the very end of the field, so the field is not really quoted.
+static bool unquoteField(const char* p, size_t n, string& out, size_t& newlines)
+{
+    if (n == 0 || p[0] != '"') {
+        out.assign(p, n);
+        return true;
+    }
+    out.clear();
+    for (size_t i = 1; i < n; i++) {
+        if (p[i] != '"') {
+            if (p[i] == '\n') newlines++;
+            out += p[i];
+        } else if (i + 1 < n && p[i + 1] == '"') {
+            out += '"';
+            i++;
+        } else {
+            return i + 1 == n;
+        }
+    }
+    return false;
+}
+
+RecordScanner::RecordScanner(const char* bytes, size_t length, size_t start, size_t stop)
+    : data(bytes), size(length), blockStart(start), position(start), limit(stop)
+{
+    if (start < size) structural = classifyBlock(start);
+}
+
+// Structural bits of one block. A block with no quotes, entered outside
+// a quoted field, is just its delimiter and newline masks; otherwise the
+// quote state is followed byte by byte to drop what is quoted.
+uint64_t RecordScanner::classifyBlock(size_t offset)
+{
+    size_t n = min<size_t>(64, size - offset);
+    const char* p = data + offset;
+    char padded[64];
+    if (n < 64) {
+        memcpy(padded, p, n);
+        memset(padded + n, ' ', 64 - n);
+        p = padded;
+    }
+    
+    uint64_t delimiters, newlines, quotes;
+    classifyBytes(p, delimiters, newlines, quotes);
+    if (quotes == 0 && !insideQuotes) return delimiters | newlines;
+    
+    uint64_t mask = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t pos = offset + i;
+        char c = data[pos];
+        if (escapePending) {
+            escapePending = false;
+        } else if (insideQuotes) {
+            if (c != '"') continue;
+            if (pos + 1 < size && data[pos + 1] == '"') {
+                escapePending = true;
+            } else {
+                insideQuotes = false;
+            }
+        } else if (c == '"') {
+            insideQuotes = pos == 0 || data[pos - 1] == '|' || data[pos - 1] == '\n';
+        } else if (c == '|' || c == '\n') {
+            mask |= 1ULL << i;
+        }
+    }
+    return mask;
+}
+
+// Position of the next delimiter or newline outside quotes, or size
+size_t RecordScanner::nextStructural()
+{
+    while (structural == 0) {
+        if (blockStart + 64 >= size) return size;
+        blockStart += 64;
+        structural = classifyBlock(blockStart);
+    }
+    size_t pos = blockStart + lowestBit(structural);
+    structural &= structural - 1;
+    return pos;
+}
+
+bool RecordScanner::next(vector<string>& fields, size_t& recordLine, string_view& raw)
+{
+    while (position < size && position < limit) {
+        size_t start = position;
+        size_t fieldStart = start;
+        size_t fieldCount = 0;
+        size_t quotedNewlines = 0;
+        bool quotesValid = true;
+        
+        while (true) {
+            size_t end = nextStructural();
+            bool lastField = end >= size || data[end] == '\n';
+            size_t fieldEnd = end;
+            if (lastField && fieldEnd > fieldStart && data[fieldEnd - 1] == '\r') fieldEnd--;
+            
+            if (fieldCount == fields.size()) fields.emplace_back();
+            if (!unquoteField(data + fieldStart, fieldEnd - fieldStart, fields[fieldCount], quotedNewlines)) {
+                quotesValid = false;
+            }
+            fieldCount++;
+            fieldStart = end + 1;
+            
+            if (lastField) {
+                position = min(end + 1, size);
+                raw = string_view(data + start, fieldEnd - start);
+                break;
+            }
+        }
+        
+        if (!quotesValid) {
+            splitLiteral(start, fields, raw);
+            fieldCount = fields.size();
+            quotedNewlines = 0;
+        }
+        recordLine = line;
+        line += 1 + quotedNewlines;
+        if (fieldCount == 1 && raw.empty()) continue;
+        fields.resize(fieldCount);
+        return true;
+    }
+    return false;
+}
+
+// Re-reads the record at start with quotes as ordinary characters, up to
+// its first newline, and restarts block classification after it
+void RecordScanner::splitLiteral(size_t start, vector<string>& fields, string_view& raw)
+{
+    const char* newline = (const char*)memchr(data + start, '\n', size - start);
+    size_t end = newline ? newline - data : size;
+    size_t textEnd = end > start && data[end - 1] == '\r' ? end - 1 : end;
+    
+    fields.clear();
+    size_t fieldStart = start;
+    while (true) {
+        const char* pipe = (const char*)memchr(data + fieldStart, '|', textEnd - fieldStart);
+        size_t fieldEnd = pipe ? pipe - data : textEnd;
+        fields.emplace_back(data + fieldStart, fieldEnd - fieldStart);
+        if (!pipe) break;
+        fieldStart = fieldEnd + 1;
+    }
+    raw = string_view(data + start, textEnd - start);
+    
+    position = min(end + 1, size);
+    blockStart = position;
+    insideQuotes = false;
+    escapePending = false;
+    structural = position < size ? classifyBlock(position) : 0;
+}
+
+void RecordScanner::skipTo(size_t target)
+{
+    vector<string> fields;
+    size_t recordLine;
+    string_view raw;
+    size_t savedLimit = limit;
+    limit = target;
+    while (next(fields, recordLine, raw)) {}
+    limit = savedLimit;
+}
+
+// True if text ends inside a quoted field that what follows may still
+// close, so a reader of a live feed should wait for more lines
+bool endsInsideQuotedField(string_view text)
+{
+    bool inside = false;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (inside) {
+            if (c != '"') continue;
+            if (i + 1 < text.size() && text[i + 1] == '"') i++;
+            else inside = false;
+        } else if (c == '"') {
+            inside = i == 0 || text[i - 1] == '|' || text[i - 1] == '\n';
+        }
+    }
+    return inside;
+}
+
+// ============================================================================
+// DATA CONVERSION
+// ============================================================================
+
+// Why a split record is not a tweet, or "" if it is one
+string tweetRowProblem(const vector<string>& row)
+{
+    if (row.size() != 5) return "expected 5 fields, found " + to_string(row.size());
+    if (row[4].empty()) return "empty tweet text";
+    return "";
+}
+
+// Expects a 5-field row: tweet id, user id, created_at, senator, text
+Tweet tweetFromRow(const vector<string>& row)
+{
+    Tweet t;
+    t.tweetId = row[0];
+    t.userId = row[1];
+    t.datetime = row[2];
+    t.senatorName = row[3];
+    t.text = row[4];
+    if (!parseIsoTimestamp(t.datetime, t.createdAt)) t.createdAt = invalidCreatedAt;
+    return t;
+}
+
+// Plain decimal with no sign or leading zeros, so the text is exactly
+// what to_string() gives back
+bool parseRecordId(const string& text, uint64_t& value)
+{
+    if (text.empty() || text.size() > 20 || (text[0] == '0' && text.size() > 1)) return false;
+    value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        uint64_t digit = c - '0';
+        if (value > (UINT64_MAX - digit) / 10) return false;
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
+// ============================================================================
+// COMPACT TWEET TABLE
+// ============================================================================
+
+void TweetTable::reserve(size_t tweetCount, size_t textBytes)
+{
+    records.reserve(tweetCount);
+    textPool.reserve(textBytes);
+}
+
+void TweetTable::append(const Tweet& tweet)
+{
+    TweetRecord record;
+    auto interned = senatorIds.emplace(tweet.senatorName, (uint32_t)senators.size());
+    if (interned.second) senators.push_back(tweet.senatorName);
+    record.senatorId = interned.first->second;
+    
+    record.createdAt = tweet.createdAt;
+    bool exact = parseRecordId(tweet.tweetId, record.tweetId) &&
+                 parseRecordId(tweet.userId, record.userId) &&
+                 tweet.createdAt != invalidCreatedAt &&
+                 formatIsoTimestamp(tweet.createdAt) == tweet.datetime;
+    record.verbatim = !exact;
+    if (!exact) {
+        verbatimFields[records.size()] = {tweet.tweetId, tweet.userId, tweet.datetime};
+    }
+    
+    record.textOffset = textPool.size();
+    record.textLength = tweet.text.size();
+    textPool += tweet.text;
+    records.push_back(record);
+}
+
+// Appends another table's records after this one's. Senators new to this
+// table are interned in the other table's first-seen order, so stitching
+// tables built from consecutive parts of a file gives the same ids as
+// loading the whole file into one.
+void TweetTable::append(const TweetTable& other)
+{
+    vector<uint32_t> senatorMap;
+    for (const string& name : other.senators) {
+        auto interned = senatorIds.emplace(name, (uint32_t)senators.size());
+        if (interned.second) senators.push_back(name);
+        senatorMap.push_back(interned.first->second);
+    }
+    
+    size_t firstRecord = records.size();
+    uint64_t poolBase = textPool.size();
+    textPool += other.textPool;
+    records.reserve(records.size() + other.records.size());
+    for (TweetRecord record : other.records) {
+        record.textOffset += poolBase;
+        record.senatorId = senatorMap[record.senatorId];
+        records.push_back(record);
+    }
+    for (const auto& entry : other.verbatimFields) {
+        verbatimFields[firstRecord + entry.first] = entry.second;
+    }
+}
+
+string TweetTable::tweetId(size_t i) const
+{
+    if (records[i].verbatim) return verbatimFields.at(i).tweetId;
+    return to_string(records[i].tweetId);
+}
+
+string TweetTable::userId(size_t i) const
+{
+    if (records[i].verbatim) return verbatimFields.at(i).userId;
+    return to_string(records[i].userId);
+}
+
+string TweetTable::datetime(size_t i) const
+{
+    if (records[i].verbatim) return verbatimFields.at(i).datetime;
+    return formatIsoTimestamp(records[i].createdAt);
+}
+
+// Heap bytes in use, counting capacity the containers have touched
+size_t TweetTable::memoryBytes() const
+{
+    size_t bytes = records.size() * sizeof(TweetRecord) + textPool.size();
+    for (const string& name : senators) bytes += sizeof(string) + name.capacity();
+    for (const auto& entry : verbatimFields) {
+        bytes += sizeof(entry) + entry.second.tweetId.capacity() +
+                 entry.second.userId.capacity() + entry.second.datetime.capacity();
+    }
+    return bytes;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (Hinnant's
+// days_from_civil), so no calendar tables or timegm() calls are needed.
+long long daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long yearOfEra = year - era * 400;
+    long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// Inverse of daysFromCivil (Hinnant's civil_from_days)
+void civilFromDays(long long days, long long& year, int& month, int& day)
+{
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    long long dayOfEra = days - era * 146097;
+    long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long long mp = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = yearOfEra + era * 400 + (month <= 2);
+}
+
+string formatCivilDate(long long days)
+{
+    long long year;
+    int month, day;
+    civilFromDays(days, year, month, day);
+    
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%04lld-%02d-%02d", year, month, day);
+    return buffer;
+}
+
+// The created_at layout tweets.csv uses, e.g. 2022-04-15T23:15:43.000Z
+string formatIsoTimestamp(long long epochSeconds)
+{
+    long long days = epochSeconds / 86400, seconds = epochSeconds % 86400;
+    if (seconds < 0) {
+        days--;
+        seconds += 86400;
+    }
+    
+    long long year;
+    int month, day;
+    civilFromDays(days, year, month, day);
+    if (year < 0 || year > 9999) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "T%02d:%02d:%02d.000Z",
+                 (int)(seconds / 3600), (int)(seconds / 60 % 60), (int)(seconds % 60));
+        return formatCivilDate(days) + buffer;
+    }
+    
+    // Every loaded record is checked against this, so digits are written
+    // directly rather than through snprintf
+    char text[] = "0000-00-00T00:00:00.000Z";
+    auto put = [&](size_t pos, long long value, int width) {
+        for (int i = width - 1; i >= 0; i--) {
+            text[pos + i] = '0' + value % 10;
+            value /= 10;
+        }
+    };
+    put(0, year, 4);
+    put(5, month, 2);
+    put(8, day, 2);
+    put(11, seconds / 3600, 2);
+    put(14, seconds / 60 % 60, 2);
+    put(17, seconds % 60, 2);
+    return string(text, sizeof(text) - 1);
+}
+
+// Parses the fixed "YYYY-MM-DDTHH:MM:SS" layout used by created_at (any
+// fractional seconds or zone suffix is ignored and treated as UTC). A bare
+// "YYYY-MM-DD" means midnight. Returns false if the digits are not where
+// the format puts them or do not name a real date and time. Years outside
+// 2000-2099 are refused too: trends are dense from the first bucket to the
+// last, so one mistyped year would stretch every series over centuries.
+bool parseIsoTimestamp(const string& text, long long& epochSeconds)
+{
+    auto digits = [&](size_t pos, size_t count, int& value) {
+        value = 0;
+        for (size_t i = pos; i < pos + count; i++) {
+            if (i >= text.size() || text[i] < '0' || text[i] > '9') return false;
+            value = value * 10 + (text[i] - '0');
+        }
+        return true;
+    };
+    
+    if (text.size() < 10 || (text.size() > 10 && text.size() < 19)) return false;
+    
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    if (!digits(0, 4, year) || text[4] != '-' || !digits(5, 2, month) ||
+        text[7] != '-' || !digits(8, 2, day)) {
+        return false;
+    }
+    static const int daysInMonth[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leapYear = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    if (year < 2000 || year > 2099 || month < 1 || month > 12 || day < 1 ||
+        day > daysInMonth[month - 1] + (month == 2 && leapYear)) {
+        return false;
+    }
+    
+    if (text.size() > 10) {
+        if ((text[10] != 'T' && text[10] != ' ') || !digits(11, 2, hour) || text[13] != ':' ||
+            !digits(14, 2, minute) || text[16] != ':' || !digits(17, 2, second)) {
+            return false;
+        }
+        if (hour > 23 || minute > 59 || second > 59) return false;
+    }
+    
+    epochSeconds = daysFromCivil(year, month, day) * 86400LL + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+// ============================================================================
+// WORD PROCESSING
+// ============================================================================
+
+string normalizeWord(const string& raw)
+{
+    string word(raw.size(), '\0');
+    word.resize(normalizeWordInto(raw, &word[0]));
+    return word;
+}
+
+// Writes the trimmed, lowercased, stemmed form of raw to out (which must
+// hold raw.size() chars) and returns its length; 0 if nothing is left.
+size_t normalizeWordInto(string_view raw, char* out)
+{
+    if (raw.empty()) return 0;
+    
+    // Find first and last alphanumeric character
+    int start = 0, end = raw.length() - 1;
+    
+    while (start <= end && !isalnum(raw[start])) start++;
+    while (end >= start && !isalnum(raw[end])) end--;
+    
+    if (start > end) return 0;
+    
+    // Copy into out, where the stemmer lowercases and stems in place
+    int length = end - start + 1;
+    memcpy(out, raw.data() + start, length);
+    return stemInPlace(out, length);
+}
+
+void* ScratchArena::do_allocate(size_t bytes, size_t alignment)
+{
+    size_t offset = (used + alignment - 1) & ~(alignment - 1);
+    if (offset + bytes <= capacity) {
+        used = offset + bytes;
+        return block.get() + offset;
+    }
+    
+    // Rare: this tweet needs more than the block. Serve it from the heap
+    // and remember how much, so reset() can size the next block.
+    overflow.emplace_back(new char[bytes + alignment]);
+    overflowBytes += bytes + alignment;
+    void* p = overflow.back().get();
+    size_t space = bytes + alignment;
+    return align(alignment, bytes, p, space);
+}
+
+void ScratchArena::reset()
+{
+    if (!overflow.empty()) {
+        capacity = max(capacity * 2, capacity + overflowBytes);
+        block.reset(new char[capacity]);
+        overflow.clear();
+        overflowBytes = 0;
+    }
+    used = 0;
+}
+
+// One arena per thread, so concurrent scorers never share scratch memory
+ScratchArena& tweetScratchArena()
+{
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+bool isAllCaps(string_view word)
+{
+    if (word.length() <= 1) return false;
+    
+    int alphaCount = 0;
+    for (char c : word) {
+        if (isalpha(c)) {
+            alphaCount++;
+            if (!isupper(c)) return false;
+        }
+    }
+    return alphaCount > 0;
+}
+
+string escapeJsonString(string_view s)
+{
+    string result;
+    for (char c : s) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default: result += c;
+        }
+    }
+    return result;
+}
+
+// ============================================================================
+// GROUP-BY AGGREGATION
+// ============================================================================
+
+double GroupAggregate::mean(size_t group) const
+{
+    return count[group] > 0 ? sum[group] / count[group] : 0.0;
+}
+
+double GroupAggregate::variance(size_t group) const
+{
+    if (count[group] == 0) return 0.0;
+    double m = mean(group);
+    return max(0.0, sumSquares[group] / count[group] - m * m);
+}
+
+GroupKeys groupKeysFromIds(const vector<int>& ids, uint32_t groupCount)
+{
+    GroupKeys keys;
+    keys.groupCount = groupCount;
+    keys.keys.assign(ids.begin(), ids.end());
+    return keys;
+}
+
+GroupKeys groupKeysFromNames(const vector<string>& values, vector<string>& names)
+{
+    names = values;
+    sort(names.begin(), names.end());
+    names.erase(unique(names.begin(), names.end()), names.end());
+    
+    unordered_map<string, uint32_t> idByName;
+    for (size_t id = 0; id < names.size(); id++) idByName[names[id]] = id;
+    
+    GroupKeys keys;
+    keys.groupCount = names.size();
+    keys.keys.reserve(values.size());
+    for (const auto& value : values) keys.keys.push_back(idByName[value]);
+    return keys;
+}
+
+GroupKeys dateBucketKeys(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    TrendBucket bucket,
+    vector<string>& bucketNames)
+{
+    // Same bucket boundaries as the TREND series; undated tweets are in none
+    vector<long long> absolute(analyses.size());
+    long long first = LLONG_MAX, last = LLONG_MIN;
+    for (size_t i = 0; i < analyses.size(); i++) {
+        if (analyses[i].createdAt == invalidCreatedAt) continue;
+        absolute[i] = absoluteBucket(analyses[i].createdAt, bucket);
+        first = min(first, absolute[i]);
+        last = max(last, absolute[i]);
+    }
+    
+    GroupKeys keys;
+    bucketNames.clear();
+    keys.keys.assign(analyses.size(), 0);
+    if (first > last) return keys;
+    
+    keys.groupCount = last - first + 1;
+    for (size_t i = 0; i < analyses.size(); i++) {
+        bool dated = analyses[i].createdAt != invalidCreatedAt;
+        keys.keys[i] = dated ? absolute[i] - first : keys.groupCount;
+    }
+    for (long long b = first; b <= last; b++) bucketNames.push_back(bucketStartDate(b, bucket));
+    return keys;
+}
+
+// Callers keep outer.groupCount * inner.groupCount within maxGroupCount
+GroupKeys combineGroupKeys(const GroupKeys& outer, const GroupKeys& inner)
+{
+    GroupKeys keys;
+    keys.groupCount = outer.groupCount * inner.groupCount;
+    keys.keys.resize(outer.keys.size());
+    for (size_t i = 0; i < keys.keys.size(); i++) {
+        bool excluded = outer.keys[i] == outer.groupCount || inner.keys[i] == inner.groupCount;
+        keys.keys[i] = excluded ? keys.groupCount : outer.keys[i] * inner.groupCount + inner.keys[i];
+    }
+    return keys;
+}
+
+// Each statistic gets its own pass over the column. The loops carry no
+// branches except min/max, so the compiler can keep them tight, and the
+// sums add rows in order exactly as a per-group loop would. Rows left out
+// of every group land in a spare slot that is dropped at the end.
+GroupAggregate groupByAggregate(const GroupKeys& keys, const vector<double>& values)
+{
+    GroupAggregate agg;
+    size_t groups = keys.groupCount;
+    size_t slots = groups + 1;
+    size_t rows = keys.keys.size();
+    agg.count.assign(slots, 0);
+    agg.sum.assign(slots, 0.0);
+    agg.sumSquares.assign(slots, 0.0);
+    agg.minValue.assign(slots, numeric_limits<double>::infinity());
+    agg.maxValue.assign(slots, -numeric_limits<double>::infinity());
+    agg.argMin.assign(slots, SIZE_MAX);
+    agg.argMax.assign(slots, SIZE_MAX);
+    
+    const uint32_t* key = keys.keys.data();
+    const double* v = values.data();
+    long long* count = agg.count.data();
+    double* sum = agg.sum.data();
+    double* sumSquares = agg.sumSquares.data();
+    
+    for (size_t i = 0; i < rows; i++) count[key[i]]++;
+    for (size_t i = 0; i < rows; i++) sum[key[i]] += v[i];
+    for (size_t i = 0; i < rows; i++) sumSquares[key[i]] += v[i] * v[i];
+    
+    // Strict comparisons keep the first row on ties
+    for (size_t i = 0; i < rows; i++) {
+        uint32_t k = key[i];
+        if (v[i] > agg.maxValue[k]) {
+            agg.maxValue[k] = v[i];
+            agg.argMax[k] = i;
+        }
+        if (v[i] < agg.minValue[k]) {
+            agg.minValue[k] = v[i];
+            agg.argMin[k] = i;
+        }
+    }
+    
+    agg.count.resize(groups);
+    agg.sum.resize(groups);
+    agg.sumSquares.resize(groups);
+    agg.minValue.resize(groups);
+    agg.maxValue.resize(groups);
+    agg.argMin.resize(groups);
+    agg.argMax.resize(groups);
+    return agg;
+}
+
+TweetMetricColumns buildMetricColumns(const vector<AdvancedTweetAnalysis>& analyses)
+{
+    TweetMetricColumns columns;
+    size_t n = analyses.size();
+    for (auto* column : {&columns.totalWords, &columns.baseScore, &columns.adjustedScore,
+                         &columns.posPercent, &columns.negPercent, &columns.allCaps,
+                         &columns.exclamations}) {
+        column->resize(n);
+    }
+    
+    for (size_t i = 0; i < n; i++) {
+        const auto& a = analyses[i];
+        columns.totalWords[i] = a.totalWords;
+        columns.baseScore[i] = a.baseSentimentScore;
+        columns.adjustedScore[i] = a.adjustedSentimentScore;
+        columns.posPercent[i] = a.totalWords > 0 ? 100.0 * a.posWordCount / a.totalWords : 0.0;
+        columns.negPercent[i] = a.totalWords > 0 ? 100.0 * a.negWordCount / a.totalWords : 0.0;
+        columns.allCaps[i] = a.allCapsWordCount;
+        columns.exclamations[i] = a.exclamationCount;
+    }
+    return columns;
+}
+
+const vector<double>* TweetMetricColumns::find(const string& name) const
+{
+    if (name == "words") return &totalWords;
+    if (name == "base") return &baseScore;
+    if (name == "adjusted") return &adjustedScore;
+    if (name == "pospct") return &posPercent;
+    if (name == "negpct") return &negPercent;
+    if (name == "allcaps") return &allCaps;
+    if (name == "exclamations") return &exclamations;
+    return nullptr;
+}
+
+// Group ids are dense, so every combination of the dimensions gets a slot
+// in each aggregate array; more than this is refused rather than allocated
+static const uint64_t maxGroupCount = 1 << 20;
+
+// Prints one metric grouped by a comma-separated list of dimensions
+// (senator, day, week, month), e.g. "senator,month".
+int runGroupByReport(const string& dimensions, const string& metric)
+{
+    CorpusState state = loadCorpusState();
+    TweetMetricColumns columns = buildMetricColumns(state.analyses);
+    const vector<double>* values = columns.find(metric);
+    if (values == nullptr) {
+        cerr << "Error: Unknown metric " << metric
+             << " (words, base, adjusted, pospct, negpct, allcaps, exclamations)" << endl;
+        return 1;
+    }
+    
+    GroupKeys keys;
+    keys.groupCount = 1;
+    keys.keys.assign(state.analyses.size(), 0);
+    vector<string> labels = {""};
+    
+    stringstream ss(dimensions);
+    string dimension;
+    unordered_set<string> seenDimensions;
+    while (getline(ss, dimension, ',')) {
+        if (!seenDimensions.insert(dimension).second) {
+            cerr << "Error: Dimension " << dimension << " is listed twice" << endl;
+            return 1;
+        }
+        GroupKeys dimensionKeys;
+        vector<string> dimensionNames;
+        TrendBucket bucket;
+        if (dimension == "senator") {
+            dimensionKeys = groupKeysFromIds(state.senatorIndex.senatorOfTweet, state.senatorIndex.names.size());
+            dimensionNames = state.senatorIndex.names;
+        } else if (parseTrendBucket(dimension, bucket)) {
+            dimensionKeys = dateBucketKeys(state.analyses, bucket, dimensionNames);
+        } else {
+            cerr << "Error: Unknown dimension " << dimension << " (senator, day, week, month)" << endl;
+            return 1;
+        }
+        
+        uint64_t groupCount = (uint64_t)keys.groupCount * dimensionKeys.groupCount;
+        if (groupCount > maxGroupCount) {
+            cerr << "Error: Grouping by " << dimensions << " would need " << groupCount
+                 << " groups (at most " << maxGroupCount << "); use fewer or coarser dimensions" << endl;
+            return 1;
+        }
+        keys = combineGroupKeys(keys, dimensionKeys);
+        vector<string> combined;
+        for (const auto& outer : labels) {
+            for (const auto& inner : dimensionNames) {
+                combined.push_back(outer.empty() ? inner : outer + " / " + inner);
+            }
+        }
+        labels = combined;
+    }
+    
+    GroupAggregate agg = groupByAggregate(keys, *values);
+    
+    cout << left << setw(40) << "Group"
+         << right << setw(8) << "Count"
+         << setw(10) << "Mean"
+         << setw(10) << "Min"
+         << setw(10) << "Max"
+         << setw(10) << "Variance"
+         << setw(10) << "Max Id" << "\n";
+    cout << string(98, '-') << "\n";
+    for (size_t g = 0; g < keys.groupCount; g++) {
+        if (agg.count[g] == 0) continue;
+        cout << left << setw(40) << labels[g]
+             << right << setw(8) << agg.count[g]
+             << fixed << setprecision(2)
+             << setw(10) << agg.mean(g)
+             << setw(10) << agg.minValue[g]
+             << setw(10) << agg.maxValue[g]
+             << setw(10) << agg.variance(g)
+             << setw(10) << state.tweets.tweetId(agg.argMax[g]) << "\n";
+    }
+    cout << flush;
+    return 0;
+}
+
+// ============================================================================
+// PART I: BASE SENTIMENT ANALYSIS
+// ============================================================================
+
+unordered_set<string> buildLexiconSet(const vector<string>& words)
+{
+    // Stem copies of the whole list with one batch call
+    vector<string> stems(words);
+    vector<char*> pointers;
+    vector<int> lengths;
+    for (auto& word : stems) {
+        pointers.push_back(&word[0]);
+        lengths.push_back(word.size());
+    }
+    stemWords(pointers.data(), lengths.data(), stems.size());
+    
+    unordered_set<string> lexicon;
+    for (size_t i = 0; i < stems.size(); i++) {
+        if (lengths[i] > 0)
+            lexicon.emplace(stems[i].data(), lengths[i]);
+    }
+    return lexicon;
+}
+
+vector<SenatorStats> computeBaseSenatorStats(const SenatorIndex& index)
+{
+    // Lexicon-only counts were already computed per tweet by the index
+    size_t n = index.lexiconScores.size();
+    vector<double> words(n), positive(n), negative(n);
+    for (size_t i = 0; i < n; i++) {
+        words[i] = index.lexiconScores[i].totalWords;
+        positive[i] = index.lexiconScores[i].positiveCount;
+        negative[i] = index.lexiconScores[i].negativeCount;
+    }
+    
+    GroupKeys keys = groupKeysFromIds(index.senatorOfTweet, index.names.size());
+    GroupAggregate wordAgg = groupByAggregate(keys, words);
+    GroupAggregate posAgg = groupByAggregate(keys, positive);
+    GroupAggregate negAgg = groupByAggregate(keys, negative);
+    
+    vector<SenatorStats> result;
+    for (size_t id = 0; id < index.names.size(); id++) {
+        SenatorStats stats;
+        stats.name = index.names[id];
+        stats.totalTweets = wordAgg.count[id];
+        stats.totalWords = wordAgg.sum[id];
+        stats.totalPositiveWords = posAgg.sum[id];
+        stats.totalNegativeWords = negAgg.sum[id];
+        if (stats.totalWords > 0) {
+            stats.positivePercent = 100.0 * stats.totalPositiveWords / stats.totalWords;
+            stats.negativePercent = 100.0 * stats.totalNegativeWords / stats.totalWords;
+        }
+        result.push_back(stats);
+    }
+    
+    return result;
+}
+
+void printBaseSentimentTable(const vector<SenatorStats>& stats)
+{
+    ostringstream out;
+    out << "\n========================================\n";
+    out << "PART I: BASE SENTIMENT ANALYSIS\n";
+    out << "========================================\n";
+    out << left << setw(30) << "Senator" 
+        << right << setw(12) << "Positive %" 
+        << setw(12) << "Negative %" << "\n";
+    out << string(54, '-') << "\n";
+    
+    for (const auto& s : stats) {
+        out << left << setw(30) << s.name;
+        
+        // Color code positive percent
+        out << Color::getPercentColor(s.positivePercent) 
+            << right << setw(12) << fixed << setprecision(5) << s.positivePercent 
+            << Color::RESET;
+        
+        // Color code negative percent
+        out << Color::getPercentColor(s.negativePercent) 
+            << setw(12) << fixed << setprecision(5) << s.negativePercent 
+            << Color::RESET << "\n";
+    }
+    out << "\n";
+    Terminal::write(out.str());
+}
+
+// ============================================================================
+// PART II CAPABILITY 1: MOST POSITIVE/NEGATIVE TWEETS
+// ============================================================================
+
+TweetSentiment analyzeTweetLexiconOnly(
+    string_view text,
+    const unordered_set<string>& positiveLexicon,
+    const unordered_set<string>& negativeLexicon)
+{
+    TweetSentiment result;
+    result.text = text;
+    
+    stringstream ss{string(text)};
+    string rawWord;
+    while (ss >> rawWord) {
+        string normalized = normalizeWord(rawWord);
+        if (normalized.empty()) continue;
+        
+        result.totalWords++;
+        
+        if (positiveLexicon.count(normalized)) {
+            result.positiveCount++;
+        }
+        if (negativeLexicon.count(normalized)) {
+            result.negativeCount++;
+        }
+    }
+    
+    result.rawScore = result.positiveCount - result.negativeCount;
+    return result;
+}
+
+SenatorIndex buildSenatorIndex(
+    const TweetTable& tweets,
+    const unordered_set<string>& positiveLexicon,
+    const unordered_set<string>& negativeLexicon)
+{
+    // Score every tweet once
+    vector<TweetSentiment> lexiconScores;
+    lexiconScores.reserve(tweets.size());
+    for (size_t i = 0; i < tweets.size(); i++) {
+        lexiconScores.push_back(analyzeTweetLexiconOnly(tweets.text(i), positiveLexicon, negativeLexicon));
+    }
+    return buildSenatorIndex(tweets, move(lexiconScores));
+}
+
+// Builds the index from scores computed elsewhere (one per tweet, same order)
+SenatorIndex buildSenatorIndex(
+    const TweetTable& tweets,
+    vector<TweetSentiment> lexiconScores)
+{
+    SenatorIndex index;
+    index.names = tweets.senatorNames();
+    sort(index.names.begin(), index.names.end());
+    for (size_t id = 0; id < index.names.size(); id++) {
+        index.idByName[index.names[id]] = id;
+    }
+    
+    // Interned ids follow first appearance; map them to sorted ids once
+    vector<int> idOfInterned;
+    for (const string& name : tweets.senatorNames()) idOfInterned.push_back(index.idByName[name]);
+    
+    // Count tweets per senator
+    size_t senatorCount = index.names.size();
+    index.senatorOfTweet.resize(tweets.size());
+    index.lexiconScores = move(lexiconScores);
+    index.tweetOffsets.assign(senatorCount + 1, 0);
+    for (size_t i = 0; i < tweets.size(); i++) {
+        int id = idOfInterned[tweets.senatorId(i)];
+        index.senatorOfTweet[i] = id;
+        index.tweetOffsets[id + 1]++;
+        index.lexiconScores[i].text = tweets.text(i);
+    }
+    for (size_t id = 0; id < senatorCount; id++) {
+        index.tweetOffsets[id + 1] += index.tweetOffsets[id];
+    }
+    
+    // Counting sort keeps file order within each senator's range
+    index.tweetOrder.resize(tweets.size());
+    vector<size_t> cursor(index.tweetOffsets.begin(), index.tweetOffsets.end() - 1);
+    for (size_t i = 0; i < tweets.size(); i++) {
+        index.tweetOrder[cursor[index.senatorOfTweet[i]]++] = i;
+    }
+    
+    // Cache extremes; the first tweet wins ties, as in a linear scan
+    index.mostPositiveTweet.resize(senatorCount);
+    index.mostNegativeTweet.resize(senatorCount);
+    for (size_t id = 0; id < senatorCount; id++) {
+        int maxScore = INT_MIN, minScore = INT_MAX;
+        for (size_t pos = index.tweetOffsets[id]; pos < index.tweetOffsets[id + 1]; pos++) {
+            size_t t = index.tweetOrder[pos];
+            int score = index.lexiconScores[t].rawScore;
+            if (score > maxScore) {
+                maxScore = score;
+                index.mostPositiveTweet[id] = t;
+            }
+            if (score < minScore) {
+                minScore = score;
+                index.mostNegativeTweet[id] = t;
+            }
+        }
+    }
+    
+    return index;
+}
+
+void showMostPositiveAndNegativeTweetForSenator(
+    const SenatorIndex& index,
+    const string& senatorName)
+{
+    ostringstream out;
+    int id = index.findSenator(senatorName);
+    if (id < 0) {
+        out << "Senator not found: " << senatorName << "\n";
+        Terminal::write(out.str());
+        return;
+    }
+    
+    const TweetSentiment& mostPositive = index.lexiconScores[index.mostPositiveTweet[id]];
+    const TweetSentiment& mostNegative = index.lexiconScores[index.mostNegativeTweet[id]];
+    
+    out << "\n========================================\n";
+    out << "MOST POSITIVE/NEGATIVE TWEETS FOR: " << senatorName << "\n";
+    out << "========================================\n";
+    
+    out << "\nMOST POSITIVE TWEET:\n";
+    out << "Text: " << mostPositive.text << "\n";
+    out << "Positive words: " << mostPositive.positiveCount << "\n";
+    out << "Negative words: " << mostPositive.negativeCount << "\n";
+    out << "Total words: " << mostPositive.totalWords << "\n";
+    out << "Raw score: " << mostPositive.rawScore << "\n";
+    
+    out << "\nMOST NEGATIVE TWEET:\n";
+    out << "Text: " << mostNegative.text << "\n";
+    out << "Positive words: " << mostNegative.positiveCount << "\n";
+    out << "Negative words: " << mostNegative.negativeCount << "\n";
+    out << "Total words: " << mostNegative.totalWords << "\n";
+    out << "Raw score: " << mostNegative.rawScore << "\n";
+    out << "\n";
+    Terminal::write(out.str());
+}
+
+// ============================================================================
+// PART II CAPABILITY 2: TALKATIVE SENATORS
+// ============================================================================
+
+vector<TalkStats> computeTalkStats(const SenatorIndex& index)
+{
+    vector<double> words(index.lexiconScores.size());
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] = index.lexiconScores[i].totalWords;
+    }
+    
+    GroupKeys keys = groupKeysFromIds(index.senatorOfTweet, index.names.size());
+    GroupAggregate wordAgg = groupByAggregate(keys, words);
+    
+    vector<TalkStats> result;
+    for (size_t id = 0; id < index.names.size(); id++) {
+        TalkStats stats;
+        stats.name = index.names[id];
+        stats.tweetCount = wordAgg.count[id];
+        stats.totalWords = wordAgg.sum[id];
+        if (stats.tweetCount > 0) {
+            stats.avgWordsPerTweet = (double)stats.totalWords / stats.tweetCount;
+        }
+        result.push_back(stats);
+    }
+    
+    return result;
+}
+
+void printTalkStatsAndMostTalkative(const vector<TalkStats>& stats)
+{
+    ostringstream out;
+    out << "\n========================================\n";
+    out << "PART II: TALKATIVE SENATORS\n";
+    out << "========================================\n";
+    out << left << setw(30) << "Senator"
+        << right << setw(12) << "Tweet Count"
+        << setw(18) << "Avg Words/Tweet" << "\n";
+    out << string(60, '-') << "\n";
+    
+    TalkStats mostTweets = stats[0];
+    TalkStats mostWordy = stats[0];
+    
+    for (const auto& s : stats) {
+        out << left << setw(30) << s.name
+            << right << setw(12) << s.tweetCount
+            << setw(18) << fixed << setprecision(2) << s.avgWordsPerTweet << "\n";
+        
+        if (s.tweetCount > mostTweets.tweetCount) {
+            mostTweets = s;
+        }
+        if (s.avgWordsPerTweet > mostWordy.avgWordsPerTweet) {
+            mostWordy = s;
+        }
+    }
+    
+    out << "\nMOST TWEETS: " << mostTweets.name 
+        << " (" << mostTweets.tweetCount << " tweets)\n";
+    out << "HIGHEST AVG WORDS/TWEET: " << mostWordy.name 
+        << " (" << fixed << setprecision(2) << mostWordy.avgWordsPerTweet << " words)\n";
+    out << "\n";
+    Terminal::write(out.str());
+}
+
+// ============================================================================
+// EXTRA CREDIT: ADVANCED SENTIMENT ENGINE - LEXICON BUILDING
+// ============================================================================
+
+unordered_map<string, double> buildWordPolarityMap(
+    const vector<string>& posWords,
+    const vector<string>& negWords)
+{
+    unordered_map<string, double> polarityMap;
+    
+    // Add positive words with default weight +1.0
+    for (const auto& word : posWords) {
+        string stemmed = stemString(word);
+        if (!stemmed.empty()) {
+            polarityMap[stemmed] = 1.0;
+        }
+    }
+    
+    // Add negative words with default weight -1.0
+    for (const auto& word : negWords) {
+        string stemmed = stemString(word);
+        if (!stemmed.empty()) {
+            polarityMap[stemmed] = -1.0;
+        }
+    }
+    
+    // Override specific strong words
+    polarityMap[stemString("love")] = 2.0;
+    polarityMap[stemString("amazing")] = 2.0;
+    polarityMap[stemString("excellent")] = 2.0;
+    polarityMap[stemString("hate")] = -2.0;
+    polarityMap[stemString("terrible")] = -2.0;
+    polarityMap[stemString("horrible")] = -2.0;
+    
+    return polarityMap;
+}
+
+unordered_set<string> buildNegationWords()
+{
+    return {
+        stemString("not"), stemString("no"), stemString("never"),
+        stemString("none"), stemString("nobody"), stemString("nothing"),
+        stemString("neither"), stemString("nowhere"), stemString("hardly"),
+        stemString("barely"), stemString("scarcely"), "n't"
+    };
+}
+
+unordered_set<string> buildIntensifiers()
+{
+    return {
+        stemString("very"), stemString("really"), stemString("extremely"),
+        stemString("so"), stemString("super"), stemString("highly"),
+        stemString("absolutely"), stemString("completely"), stemString("totally")
+    };
+}
+
+unordered_set<string> buildDowntoners()
+{
+    return {
+        stemString("slightly"), stemString("somewhat"), stemString("kind"),
+        stemString("bit"), stemString("little"), stemString("fairly"),
+        stemString("rather"), stemString("quite")
+    };
+}
+
+unordered_map<string, double> buildNgramPolarity()
+{
+    unordered_map<string, double> ngramMap;
+    
+    // Positive phrases
+    ngramMap["so much fun"] = 2.0;
+    ngramMap["great job"] = 1.5;
+    ngramMap["well done"] = 1.5;
+    ngramMap["thank you"] = 1.0;
+    ngramMap["looking forward"] = 1.5;
+    
+    // Negative phrases
+    ngramMap["sick of"] = -2.0;
+    ngramMap["waste of time"] = -2.0;
+    ngramMap["so tired of"] = -1.5;
+    ngramMap["fed up"] = -1.5;
+    ngramMap["not good"] = -1.5;
+    
+    return ngramMap;
+}
+
+unordered_set<string> buildPositiveEmojisSlang()
+{
+    return {
+        "lol", "lmao", "haha", "hehe", "yay", "awesome",
+        "😂", "🤣", "😊", "😃", "😄", "❤️", "💙", "👍", "✨"
+    };
+}
+
+unordered_set<string> buildNegativeEmojisSlang()
+{
+    return {
+        "ugh", "omg", "wtf", "smh",
+        "💀", "😡", "😭", "😢", "👎", "😠"
+    };
+}
+
+// ============================================================================
+// EXTRA CREDIT: ADVANCED SENTIMENT ENGINE - SCORING MODEL
+// ============================================================================
+
+shared_ptr<const ScoringModel> buildBuiltInScoringModel(
+    const vector<string>& posWords,
+    const vector<string>& negWords)
+{
+    auto model = make_shared<ScoringModel>();
+    model->wordPolarity = buildWordPolarityMap(posWords, negWords);
+    model->negationWords = buildNegationWords();
+    model->intensifiers = buildIntensifiers();
+    model->downtoners = buildDowntoners();
+    model->ngramPolarity = buildNgramPolarity();
+    model->positiveEmojisSlang = buildPositiveEmojisSlang();
+    model->negativeEmojisSlang = buildNegativeEmojisSlang();
+    model->source = "built-in";
+    model->fingerprint = scoringModelFingerprint(*model);
+    return model;
+}
+
+// An INI-style file. Lines starting with # are comments.
+//   [params]          negation, intensifier, downtoner, lookback and
+//                     exclamation, each as name = number
+//   [lexicon]         positive = weight and negative = weight for the words
+//                     in the lexicon files, then word = weight overrides
+//   [negation] [intensifiers] [downtoners] [positive-emoji] [negative-emoji]
+//                     whitespace-separated words
+//   [ngrams]          phrase = weight
+// Parameters not given keep their defaults. A section that is present
+// replaces the built-in list or lexicon weights; one that is absent keeps
+// them. Returns null with error set ("line N: ...") if the file can't be
+// used.
+shared_ptr<const ScoringModel> parseScoringConfig(
+    const string& path,
+    const vector<string>& posWords,
+    const vector<string>& negWords,
+    string& error)
+{
+    ifstream in(path);
+    if (!in.is_open()) {
+        error = "could not be opened";
+        return nullptr;
+    }
+    
+    auto model = make_shared<ScoringModel>(*buildBuiltInScoringModel(posWords, negWords));
+    model->source = path;
+    
+    const unordered_set<string> sections = {
+        "params", "lexicon", "negation", "intensifiers", "downtoners",
+        "ngrams", "positive-emoji", "negative-emoji"
+    };
+    unordered_set<string> seen;
+    double positiveWeight = 1.0, negativeWeight = -1.0;
+    vector<pair<string, double>> overrides;
+    
+    string section, line;
+    size_t lineNumber = 0;
+    auto fail = [&](const string& message) {
+        error = "line " + to_string(lineNumber) + ": " + message;
+        return nullptr;
+    };
+    // name = number, with name lowercased and its whitespace collapsed
+    auto splitAssignment = [](const string& text, string& name, double& value) {
+        size_t equals = text.rfind('=');
+        if (equals == string::npos) return false;
+        stringstream words(text.substr(0, equals));
+        string word;
+        name.clear();
+        while (words >> word) name += (name.empty() ? "" : " ") + word;
+        transform(name.begin(), name.end(), name.begin(), ::tolower);
+        stringstream number(text.substr(equals + 1));
+        return !name.empty() && number >> value && (number >> ws).eof();
+    };
+    
+    while (getline(in, line)) {
+        lineNumber++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#') continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        string text = line.substr(first, last - first + 1);
+        
+        if (text.front() == '[') {
+            if (text.back() != ']') return fail("expected [section]");
+            section = text.substr(1, text.size() - 2);
+            if (!sections.count(section)) return fail("unknown section [" + section + "]");
+            if (!seen.insert(section).second) return fail("[" + section + "] appears twice");
+            if (section == "negation") model->negationWords.clear();
+            if (section == "intensifiers") model->intensifiers.clear();
+            if (section == "downtoners") model->downtoners.clear();
+            if (section == "ngrams") model->ngramPolarity.clear();
+            if (section == "positive-emoji") model->positiveEmojisSlang.clear();
+            if (section == "negative-emoji") model->negativeEmojisSlang.clear();
+            continue;
+        }
+        if (section.empty()) return fail("expected a [section] first");
+        
+        string name;
+        double value;
+        if (section == "params" || section == "lexicon" || section == "ngrams") {
+            if (!splitAssignment(text, name, value)) return fail("expected name = number");
+        }
+        if (section == "params") {
+            ScoringParams& params = model->params;
+            if (name == "negation") params.negation = value;
+            else if (name == "intensifier") params.intensifier = value;
+            else if (name == "downtoner") params.downtoner = value;
+            else if (name == "exclamation") params.exclamationBoost = value;
+            else if (name == "lookback") {
+                if (value < 0 || value > 16 || value != floor(value)) {
+                    return fail("lookback must be a whole number from 0 to 16");
+                }
+                params.lookBack = (int)value;
+            }
+            else return fail("unknown parameter " + name);
+        } else if (section == "lexicon") {
+            if (name == "positive") positiveWeight = value;
+            else if (name == "negative") negativeWeight = value;
+            else if (name.find(' ') != string::npos) return fail("lexicon entries are single words");
+            else overrides.push_back({name, value});
+        } else if (section == "ngrams") {
+            model->ngramPolarity[name] = value;
+        } else {
+            stringstream words(text);
+            string word;
+            while (words >> word) {
+                transform(word.begin(), word.end(), word.begin(), ::tolower);
+                if (section == "positive-emoji") model->positiveEmojisSlang.insert(word);
+                else if (section == "negative-emoji") model->negativeEmojisSlang.insert(word);
+                else {
+                    // Stemmed like the built-in lists, which keep "n't" as is
+                    string normalized = word == "n't" ? word : stemString(word);
+                    if (normalized.empty()) continue;
+                    if (section == "negation") model->negationWords.insert(normalized);
+                    else if (section == "intensifiers") model->intensifiers.insert(normalized);
+                    else model->downtoners.insert(normalized);
+                }
+            }
+        }
+    }
+    
+    if (seen.count("lexicon")) {
+        model->wordPolarity.clear();
+        for (const auto& word : posWords) {
+            string stemmed = stemString(word);
+            if (!stemmed.empty()) model->wordPolarity[stemmed] = positiveWeight;
+        }
+        for (const auto& word : negWords) {
+            string stemmed = stemString(word);
+            if (!stemmed.empty()) model->wordPolarity[stemmed] = negativeWeight;
+        }
+        for (const auto& entry : overrides) {
+            string stemmed = stemString(entry.first);
+            if (!stemmed.empty()) model->wordPolarity[stemmed] = entry.second;
+        }
+    }
+    model->fingerprint = scoringModelFingerprint(*model);
+    return model;
+}
+
+// The model from scoring.conf in the working directory, or the built-in
+// one if there is no such file. A file that doesn't parse is reported and
+// the built-in model used.
+shared_ptr<const ScoringModel> loadScoringModel(
+    const vector<string>& posWords,
+    const vector<string>& negWords)
+{
+    const string path = "scoring.conf";
+    error_code ignored;
+    if (!filesystem::exists(path, ignored)) return buildBuiltInScoringModel(posWords, negWords);
+    
+    string error;
+    shared_ptr<const ScoringModel> model = parseScoringConfig(path, posWords, negWords, error);
+    if (!model) {
+        cerr << "Error: " << path << " " << error << "; using the built-in scoring model" << endl;
+        return buildBuiltInScoringModel(posWords, negWords);
+    }
+    return model;
+}
+
+// Hash of everything that affects scores, so saved partials can tell which
+// model produced them. Lists are hashed in sorted order and weights by
+// their exact bits, so equal models hash alike however they were built.
+uint64_t scoringModelFingerprint(const ScoringModel& model)
+{
+    string canonical;
+    auto addNumber = [&](double value) {
+        canonical.append((const char*)&value, sizeof(value));
+    };
+    auto addWeights = [&](const unordered_map<string, double>& weights) {
+        vector<pair<string, double>> sorted(weights.begin(), weights.end());
+        sort(sorted.begin(), sorted.end());
+        canonical += to_string(sorted.size()) + "\n";
+        for (const auto& entry : sorted) {
+            canonical += entry.first + "\n";
+            addNumber(entry.second);
+        }
+    };
+    auto addWords = [&](const unordered_set<string>& words) {
+        vector<string> sorted(words.begin(), words.end());
+        sort(sorted.begin(), sorted.end());
+        canonical += to_string(sorted.size()) + "\n";
+        for (const auto& word : sorted) canonical += word + "\n";
+    };
+    
+    addWeights(model.wordPolarity);
+    addWords(model.negationWords);
+    addWords(model.intensifiers);
+    addWords(model.downtoners);
+    addWeights(model.ngramPolarity);
+    addWords(model.positiveEmojisSlang);
+    addWords(model.negativeEmojisSlang);
+    const ScoringParams& params = model.params;
+    for (double value : {params.negation, params.intensifier, params.downtoner,
+                         (double)params.lookBack, params.exclamationBoost}) {
+        addNumber(value);
+    }
+    return fnv1aHash(canonical);
+}
+
+ScoringConfigWatcher::ScoringConfigWatcher(
+    SnapshotHandle<ScoringModel>& target,
+    vector<string> positiveWords,
+    vector<string> negativeWords,
+    chrono::milliseconds pollInterval,
+    function<void(shared_ptr<const ScoringModel>)> reloaded)
+    : handle(target), posWords(move(positiveWords)), negWords(move(negativeWords)),
+      onReload(move(reloaded)), interval(pollInterval)
+{
+    worker = thread(&ScoringConfigWatcher::watch, this);
+}
+
+ScoringConfigWatcher::~ScoringConfigWatcher()
+{
+    stopping = true;
+    worker.join();
+}
+
+void ScoringConfigWatcher::watch()
+{
+    const string path = "scoring.conf";
+    // Size and modification time, or (-1, epoch) while the file is absent
+    auto stamp = [&]() {
+        error_code error;
+        uintmax_t size = filesystem::file_size(path, error);
+        if (error) return make_pair((uintmax_t)-1, filesystem::file_time_type());
+        return make_pair(size, filesystem::last_write_time(path, error));
+    };
+    auto lastStamp = stamp();
+    
+    while (!stopping) {
+        // Sleep in short steps so the destructor doesn't wait out the interval
+        auto wakeAt = chrono::steady_clock::now() + interval;
+        while (!stopping && chrono::steady_clock::now() < wakeAt) {
+            this_thread::sleep_for(min<chrono::steady_clock::duration>(
+                chrono::milliseconds(50), wakeAt - chrono::steady_clock::now()));
+        }
+        if (stopping) break;
+        
+        auto currentStamp = stamp();
+        if (currentStamp == lastStamp) continue;
+        lastStamp = currentStamp;
+        
+        shared_ptr<const ScoringModel> model;
+        if (currentStamp.first == (uintmax_t)-1) {
+            model = buildBuiltInScoringModel(posWords, negWords);
+        } else {
+            string error;
+            model = parseScoringConfig(path, posWords, negWords, error);
+            if (!model) {
+                cerr << "Error: " << path << " " << error << "; keeping the current scoring model" << endl;
+                continue;
+            }
+        }
+        handle.publish(model);
+        cerr << "Scoring model reloaded from " << model->source << endl;
+        if (onReload) onReload(model);
+    }
+}
+
+// ============================================================================
+// EXTRA CREDIT: ADVANCED SENTIMENT ENGINE - ANALYSIS
+// ============================================================================
+
+AdvancedTweetAnalysis analyzeTweetAdvanced(const Tweet& tweet, const ScoringModel& model)
+{
+    AdvancedTweetAnalysis analysis;
+    analysis.createdAt = tweet.createdAt;
+    
+    scoreTweetText(tweet.text, model, analysis);
+    return analysis;
+}
+
+// Fills in the score and count fields of analysis. Token lists and
+// normalized words live in this thread's scratch arena and lexicon keys
+// are built in a reused buffer, so after warm-up this does no heap
+// allocation.
+void scoreTweetText(string_view text, const ScoringModel& model, AdvancedTweetAnalysis& analysis)
+{
+    const ScoringParams& params = model.params;
+    ScratchArena& arena = tweetScratchArena();
+    pmr::vector<ScoredTerm> terms(&arena);
+    collectScoredTerms(text, model, params.lookBack, analysis, terms);
+    
+    // Apply modifiers
+    for (const ScoredTerm& term : terms) {
+        double adjustedWeight = term.weight;
+        if (term.negation) adjustedWeight *= params.negation;
+        if (term.intensifier) adjustedWeight *= params.intensifier;
+        if (term.downtoner) adjustedWeight *= params.downtoner;
+        analysis.adjustedSentimentScore += adjustedWeight;
+    }
+    
+    // Adjust for punctuation emphasis
+    if (analysis.exclamationCount > 0) {
+        analysis.adjustedSentimentScore *= (1.0 + params.exclamationBoost * analysis.exclamationCount);
+    }
+    
+    // The token vectors are not touched again, and freeing arena memory
+    // is a no-op, so the scratch can be rewound before they go out of scope
+    arena.reset();
+}
+
+// Does everything scoreTweetText does except apply the modifier and
+// exclamation constants: it fills in the count fields and the base score,
+// and lists the adjusted-score terms with the distance to each modifier
+// up to maxLookBack tokens back. Scratch comes from this thread's arena,
+// which the caller rewinds once it is done with terms.
+void collectScoredTerms(
+    string_view text,
+    const ScoringModel& model,
+    int maxLookBack,
+    AdvancedTweetAnalysis& analysis,
+    pmr::vector<ScoredTerm>& terms)
+{
+    ScratchArena& arena = tweetScratchArena();
+    maxLookBack = min(maxLookBack, (int)UINT8_MAX);
+    
+    // The lexicons are keyed by std::string; reusing one buffer for lookup
+    // keys avoids a temporary string per probe.
+    thread_local string keyBuffer;
+    auto key = [](string_view word) -> const string& {
+        keyBuffer.assign(word.data(), word.size());
+        return keyBuffer;
+    };
+    
+    // Count punctuation
+    for (char c : text) {
+        if (c == '!') analysis.exclamationCount++;
+        if (c == '?') analysis.questionCount++;
+    }
+    
+    // Tokenize on whitespace (as stream extraction does) without copying
+    pmr::vector<string_view> rawTokens(&arena);
+    pmr::vector<string_view> normalizedTokens(&arena);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+        size_t start = pos;
+        while (pos < text.size() && !isspace((unsigned char)text[pos])) pos++;
+        if (pos == start) break;
+        
+        string_view rawWord(text.data() + start, pos - start);
+        rawTokens.push_back(rawWord);
+        char* normalized = (char*)arena.allocate(rawWord.size(), 1);
+        normalizedTokens.push_back(string_view(normalized, normalizeWordInto(rawWord, normalized)));
+        
+        // Check for ALL CAPS
+        if (isAllCaps(rawWord)) {
+            analysis.allCapsWordCount++;
+        }
+    }
+    
+    // Look up each token's modifier role once for the context checks below
+    size_t tokenCount = normalizedTokens.size();
+    pmr::vector<char> isNegation(tokenCount, 0, &arena);
+    pmr::vector<char> isIntensifier(tokenCount, 0, &arena);
+    pmr::vector<char> isDowntoner(tokenCount, 0, &arena);
+    for (size_t i = 0; i < tokenCount; i++) {
+        const string& token = key(normalizedTokens[i]);
+        isNegation[i] = model.negationWords.count(token) > 0;
+        isIntensifier[i] = model.intensifiers.count(token) > 0;
+        isDowntoner[i] = model.downtoners.count(token) > 0;
+    }
+    
+    // Analyze tokens
+    for (size_t i = 0; i < tokenCount; i++) {
+        string_view token = normalizedTokens[i];
+        string_view rawToken = rawTokens[i];
+        
+        if (token.empty()) continue;
+        analysis.totalWords++;
+        
+        // Check for emojis/slang in raw token (lowercase)
+        keyBuffer.assign(rawToken.data(), rawToken.size());
+        transform(keyBuffer.begin(), keyBuffer.end(), keyBuffer.begin(), ::tolower);
+        
+        if (model.positiveEmojisSlang.count(keyBuffer)) {
+            analysis.emojiPositiveCount++;
+            terms.push_back({1.0});
+            continue;
+        }
+        if (model.negativeEmojisSlang.count(keyBuffer)) {
+            analysis.emojiNegativeCount++;
+            terms.push_back({-1.0});
+            continue;
+        }
+        
+        // Check for n-grams (bigrams and trigrams)
+        bool inNgram = false;
+        if (i + 2 < tokenCount) {
+            keyBuffer.assign(normalizedTokens[i].data(), normalizedTokens[i].size());
+            keyBuffer.append(" ").append(normalizedTokens[i+1].data(), normalizedTokens[i+1].size());
+            keyBuffer.append(" ").append(normalizedTokens[i+2].data(), normalizedTokens[i+2].size());
+            auto it = model.ngramPolarity.find(keyBuffer);
+            if (it != model.ngramPolarity.end()) {
+                double score = it->second;
+                terms.push_back({score});
+                if (score > 0) analysis.ngramPositiveHits++;
+                else analysis.ngramNegativeHits++;
+                inNgram = true;
+            }
+        }
+        if (!inNgram && i + 1 < tokenCount) {
+            keyBuffer.assign(normalizedTokens[i].data(), normalizedTokens[i].size());
+            keyBuffer.append(" ").append(normalizedTokens[i+1].data(), normalizedTokens[i+1].size());
+            auto it = model.ngramPolarity.find(keyBuffer);
+            if (it != model.ngramPolarity.end()) {
+                double score = it->second;
+                terms.push_back({score});
+                if (score > 0) analysis.ngramPositiveHits++;
+                else analysis.ngramNegativeHits++;
+                inNgram = true;
+            }
+        }
+        
+        if (inNgram) continue;
+        
+        // Check for negation/intensifier/downtoner markers
+        if (isNegation[i]) {
+            analysis.negationHits++;
+        }
+        if (isIntensifier[i]) {
+            analysis.intensifierHits++;
+        }
+        if (isDowntoner[i]) {
+            analysis.downtonerHits++;
+        }
+        
+        // Analyze sentiment word
+        auto polarity = model.wordPolarity.find(key(token));
+        if (polarity != model.wordPolarity.end()) {
+            double baseWeight = polarity->second;
+            
+            // Check context: the nearest modifier of each kind within the look-back
+            ScoredTerm term;
+            term.weight = baseWeight;
+            for (int j = 1; j <= maxLookBack && (int)i - j >= 0; j++) {
+                if (isNegation[i - j] && !term.negation) term.negation = j;
+                if (isIntensifier[i - j] && !term.intensifier) term.intensifier = j;
+                if (isDowntoner[i - j] && !term.downtoner) term.downtoner = j;
+            }
+            terms.push_back(term);
+            
+            analysis.baseSentimentScore += baseWeight;
+            
+            if (baseWeight > 0) analysis.posWordCount++;
+            else if (baseWeight < 0) analysis.negWordCount++;
+        } else {
+            analysis.neutralWordCount++;
+        }
+    }
+}
+
+vector<AdvancedTweetAnalysis> analyzeAllTweetsAdvanced(const TweetTable& tweets, const ScoringModel& model)
+{
+    vector<AdvancedTweetAnalysis> results(tweets.size());
+    
+    for (size_t i = 0; i < tweets.size(); i++) {
+        AdvancedTweetAnalysis& analysis = results[i];
+        analysis.row = i;
+        analysis.createdAt = tweets.createdAt(i);
+        
+        scoreTweetText(tweets.text(i), model, analysis);
+    }
+    
+    return results;
+}
+
+vector<AdvancedSenatorSummary> summarizeAdvancedBySenator(
+    const TweetTable& tweets,
+    const vector<AdvancedTweetAnalysis>& perTweet)
+{
+    return summarizeAdvancedBySenator(tweets, perTweet, vector<double>());
+}
+
+// With weights (one per tweet), every average becomes sum(w * v) / sum(w);
+// an empty weights vector gives the plain per-tweet averages.
+vector<AdvancedSenatorSummary> summarizeAdvancedBySenator(
+    const TweetTable& tweets,
+    const vector<AdvancedTweetAnalysis>& perTweet,
+    const vector<double>& weights)
+{
+    vector<string> senatorNames;
+    for (const auto& analysis : perTweet) senatorNames.push_back(tweets.senatorName(analysis.row));
+    vector<string> names;
+    GroupKeys keys = groupKeysFromNames(senatorNames, names);
+    
+    bool weighted = !weights.empty();
+    GroupAggregate weightTotals;
+    if (weighted) weightTotals = groupByAggregate(keys, weights);
+    
+    auto groupMeans = [&](const vector<double>& column) {
+        vector<double> means(names.size());
+        if (!weighted) {
+            GroupAggregate agg = groupByAggregate(keys, column);
+            for (size_t id = 0; id < names.size(); id++) means[id] = agg.mean(id);
+            return means;
+        }
+        vector<double> product(column.size());
+        for (size_t i = 0; i < column.size(); i++) product[i] = column[i] * weights[i];
+        GroupAggregate agg = groupByAggregate(keys, product);
+        for (size_t id = 0; id < names.size(); id++) {
+            means[id] = weightTotals.sum[id] > 0 ? agg.sum[id] / weightTotals.sum[id] : 0.0;
+        }
+        return means;
+    };
+    
+    TweetMetricColumns columns = buildMetricColumns(perTweet);
+    GroupAggregate adjusted = groupByAggregate(keys, columns.adjustedScore);
+    vector<double> baseMeans = groupMeans(columns.baseScore);
+    vector<double> adjustedMeans = groupMeans(columns.adjustedScore);
+    vector<double> posPercentMeans = groupMeans(columns.posPercent);
+    vector<double> negPercentMeans = groupMeans(columns.negPercent);
+    vector<double> allCapsMeans = groupMeans(columns.allCaps);
+    vector<double> exclamationMeans = groupMeans(columns.exclamations);
+    
+    vector<AdvancedSenatorSummary> summaries;
+    
+    for (size_t id = 0; id < names.size(); id++) {
+        AdvancedSenatorSummary summary;
+        summary.name = names[id];
+        summary.tweetCount = adjusted.count[id];
+        summary.mostPositiveTweet = perTweet[adjusted.argMax[id]];
+        summary.mostNegativeTweet = perTweet[adjusted.argMin[id]];
+        
+        summary.avgBaseSentiment = baseMeans[id];
+        summary.avgAdjustedSentiment = adjustedMeans[id];
+        summary.avgPosPercent = posPercentMeans[id];
+        summary.avgNegPercent = negPercentMeans[id];
+        summary.avgAllCaps = allCapsMeans[id];
+        summary.avgExclamations = exclamationMeans[id];
+        
+        // Simple style score combining punctuation and casing
+        summary.avgStyleScore = summary.avgExclamations * 2.0 + summary.avgAllCaps * 1.5;
+        
+        summaries.push_back(summary);
+    }
+    
+    return summaries;
+}
+
+// ============================================================================
+// NEAR-DUPLICATE DETECTION
+// ============================================================================
+
+// MinHash signature layout: bands * rows hash values per tweet. Two tweets
+// land in the same bucket of a band when all `rows` values agree, which for
+// Jaccard similarity J happens with probability J^rows; with 16 bands of 4
+// a pair at J = 0.8 collides in at least one band 99.98% of the time.
+static const size_t minHashBands = 16;
+static const size_t minHashRows = 4;
+static const size_t minHashSize = minHashBands * minHashRows;
+
+static uint64_t mix64(uint64_t x)
+{
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Signatures over 3-word shingles of the normalized (stemmed) tokens, so
+// retweet-style copies with different punctuation or casing still match.
+// Tweets shorter than three words use single words. Tweet i occupies
+// [i * minHashSize, (i + 1) * minHashSize); a tweet with no words keeps
+// UINT64_MAX everywhere.
+vector<uint64_t> minHashSignatures(const TweetTable& tweets, size_t threadCount)
+{
+    vector<uint64_t> signatures(tweets.size() * minHashSize, UINT64_MAX);
+    uint64_t seeds[minHashSize];
+    for (size_t h = 0; h < minHashSize; h++) seeds[h] = mix64(h + 1);
+    
+    auto work = [&](size_t begin, size_t end) {
+        vector<uint64_t> wordHashes;
+        for (size_t t = begin; t < end; t++) {
+            wordHashes.clear();
+            stringstream ss{string(tweets.text(t))};
+            string rawWord;
+            while (ss >> rawWord) {
+                string word = normalizeWord(rawWord);
+                if (!word.empty()) wordHashes.push_back(fnv1aHash(word));
+            }
+            
+            uint64_t* signature = &signatures[t * minHashSize];
+            size_t width = wordHashes.size() >= 3 ? 3 : 1;
+            for (size_t w = 0; w + width <= wordHashes.size(); w++) {
+                uint64_t shingle = wordHashes[w];
+                for (size_t k = 1; k < width; k++) shingle = mix64(shingle ^ wordHashes[w + k]);
+                for (size_t h = 0; h < minHashSize; h++) {
+                    signature[h] = min(signature[h], mix64(shingle ^ seeds[h]));
+                }
+            }
+        }
+    };
+    
+    threadCount = max((size_t)1, min(threadCount, tweets.size() / 256 + 1));
+    size_t perThread = (tweets.size() + threadCount - 1) / threadCount;
+    vector<thread> workers;
+    for (size_t w = 1; w < threadCount; w++) {
+        size_t begin = min(tweets.size(), w * perThread);
+        workers.emplace_back(work, begin, min(tweets.size(), begin + perThread));
+    }
+    work(0, min(tweets.size(), perThread));
+    for (thread& t : workers) t.join();
+    
+    return signatures;
+}
+
+static size_t findRoot(vector<size_t>& parent, size_t x)
+{
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+// Candidate pairs come from LSH buckets: each (band, band hash) key is
+// sorted with its tweet index, and each tweet is compared with the first
+// and previous member of its bucket only, so the work stays O(n log n)
+// even when one bucket is huge. Candidates are confirmed when the fraction
+// of agreeing signature values (an estimate of Jaccard similarity) reaches
+// threshold.
+DuplicateClusters findNearDuplicates(const TweetTable& tweets, double threshold, size_t threadCount)
+{
+    size_t n = tweets.size();
+    vector<uint64_t> signatures = minHashSignatures(tweets, threadCount);
+    
+    auto similarity = [&](size_t a, size_t b) {
+        const uint64_t* sa = &signatures[a * minHashSize];
+        const uint64_t* sb = &signatures[b * minHashSize];
+        size_t agree = 0;
+        for (size_t h = 0; h < minHashSize; h++) agree += sa[h] == sb[h];
+        return (double)agree / minHashSize;
+    };
+    
+    vector<size_t> parent(n);
+    for (size_t i = 0; i < n; i++) parent[i] = i;
+    
+    vector<pair<uint64_t, size_t>> buckets;
+    buckets.reserve(n);
+    for (size_t band = 0; band < minHashBands; band++) {
+        buckets.clear();
+        for (size_t t = 0; t < n; t++) {
+            const uint64_t* rows = &signatures[t * minHashSize + band * minHashRows];
+            if (rows[0] == UINT64_MAX) continue; // no words
+            uint64_t key = band;
+            for (size_t r = 0; r < minHashRows; r++) key = mix64(key ^ rows[r]);
+            buckets.push_back({key, t});
+        }
+        sort(buckets.begin(), buckets.end());
+        
+        size_t first = 0;
+        for (size_t i = 1; i < buckets.size(); i++) {
+            if (buckets[i].first != buckets[i - 1].first) {
+                first = i;
+                continue;
+            }
+            size_t t = buckets[i].second;
+            for (size_t other : {buckets[first].second, buckets[i - 1].second}) {
+                size_t a = findRoot(parent, t), b = findRoot(parent, other);
+                if (a != b && similarity(t, other) >= threshold) parent[max(a, b)] = min(a, b);
+            }
+        }
+    }
+    
+    // Roots are always the smallest index in their set, so numbering
+    // clusters in index order makes each representative its root
+    DuplicateClusters clusters;
+    clusters.clusterOf.resize(n);
+    vector<uint32_t> idOfRoot(n, UINT32_MAX);
+    for (size_t t = 0; t < n; t++) {
+        size_t root = findRoot(parent, t);
+        if (idOfRoot[root] == UINT32_MAX) {
+            idOfRoot[root] = clusters.clusterSize.size();
+            clusters.clusterSize.push_back(0);
+            clusters.representative.push_back(root);
+        }
+        clusters.clusterOf[t] = idOfRoot[root];
+        clusters.clusterSize[idOfRoot[root]]++;
+    }
+    return clusters;
+}
+
+// Exclude keeps only each cluster's representative; DownWeight spreads one
+// tweet's worth of weight over every member of a cluster.
+vector<double> dedupWeights(const DuplicateClusters& clusters, DedupMode mode)
+{
+    vector<double> weights(clusters.clusterOf.size());
+    for (size_t t = 0; t < weights.size(); t++) {
+        uint32_t cluster = clusters.clusterOf[t];
+        if (mode == DedupMode::Exclude) weights[t] = clusters.representative[cluster] == t ? 1.0 : 0.0;
+        else weights[t] = 1.0 / clusters.clusterSize[cluster];
+    }
+    return weights;
+}
+
+// Lists the largest near-duplicate clusters and compares each senator's
+// averages with and without deduplication
+int runDedupReport(double threshold, DedupMode mode)
+{
+    CorpusState state = loadCorpusState();
+    size_t threadCount = max(1u, thread::hardware_concurrency());
+    DuplicateClusters clusters = findNearDuplicates(state.tweets, threshold, threadCount);
+    
+    vector<uint32_t> largest;
+    size_t duplicateTweets = 0;
+    for (uint32_t c = 0; c < clusters.clusterSize.size(); c++) {
+        if (clusters.clusterSize[c] < 2) continue;
+        largest.push_back(c);
+        duplicateTweets += clusters.clusterSize[c];
+    }
+    stable_sort(largest.begin(), largest.end(), [&](uint32_t a, uint32_t b) {
+        return clusters.clusterSize[a] > clusters.clusterSize[b];
+    });
+    
+    cout << largest.size() << " near-duplicate clusters covering " << duplicateTweets << " of "
+         << state.tweets.size() << " tweets (threshold " << fixed << setprecision(2) << threshold << ")\n\n";
+    for (size_t i = 0; i < min((size_t)10, largest.size()); i++) {
+        size_t tweet = clusters.representative[largest[i]];
+        string_view text = state.tweets.text(tweet);
+        string preview(text.substr(0, 70));
+        if (text.size() > 70) preview += "...";
+        cout << setw(4) << clusters.clusterSize[largest[i]] << "x  " << state.tweets.senatorName(tweet) << ": " << preview << "\n";
+    }
+    
+    // Keep only the representatives or spread the weight, then summarize
+    vector<double> weights = dedupWeights(clusters, mode);
+    vector<AdvancedSenatorSummary> deduped;
+    if (mode == DedupMode::Exclude) {
+        vector<AdvancedTweetAnalysis> kept;
+        for (size_t t = 0; t < weights.size(); t++) {
+            if (weights[t] > 0) kept.push_back(state.analyses[t]);
+        }
+        deduped = summarizeAdvancedBySenator(state.tweets, kept);
+    } else {
+        deduped = summarizeAdvancedBySenator(state.tweets, state.analyses, weights);
+    }
+    
+    cout << "\n" << left << setw(28) << "Senator"
+         << right << setw(8) << "Tweets"
+         << setw(8) << "Kept"
+         << setw(12) << "Adjusted"
+         << setw(12) << "Deduped" << "\n";
+    cout << string(68, '-') << "\n";
+    for (const auto& summary : deduped) {
+        const auto& original = state.summaries[state.summaryIndex.at(summary.name)];
+        double kept = 0.0;
+        int id = state.senatorIndex.findSenator(summary.name);
+        for (size_t i = state.senatorIndex.tweetOffsets[id]; i < state.senatorIndex.tweetOffsets[id + 1]; i++) {
+            kept += weights[state.senatorIndex.tweetOrder[i]];
+        }
+        cout << left << setw(28) << summary.name
+             << right << setw(8) << original.tweetCount
+             << setprecision(1) << setw(8) << kept
+             << setprecision(2) << setw(12) << original.avgAdjustedSentiment
+             << setw(12) << summary.avgAdjustedSentiment << "\n";
+    }
+    return 0;
+}
+
+// ============================================================================
+// TOPIC CLUSTERING
+// ============================================================================
+
+// Function words and Twitter boilerplate, stemmed like the tokens they
+// filter. They are too common to name a topic but not common enough for
+// the document-frequency cut alone to remove.
+unordered_set<string> buildStopWords()
+{
+    const char* words[] = {
+        "a", "about", "after", "all", "also", "am", "an", "and", "any", "are", "as", "at",
+        "be", "been", "before", "being", "but", "by", "can", "could", "did", "do", "does",
+        "for", "from", "get", "had", "has", "have", "he", "her", "here", "his", "how", "i",
+        "if", "in", "into", "is", "it", "its", "just", "me", "more", "my", "now", "of", "on",
+        "one", "or", "our", "out", "over", "she", "should", "so", "than", "that", "the",
+        "their", "them", "there", "these", "they", "this", "those", "to", "up", "us", "was",
+        "we", "were", "what", "when", "where", "which", "who", "will", "with", "would", "you",
+        "your", "rt", "amp", "http", "https", "today", "s"
+    };
+    unordered_set<string> stopWords;
+    for (const char* word : words) stopWords.insert(stemString(word));
+    return stopWords;
+}
+
+// Tokens are stemmed and counted on worker threads, each with its own
+// vocabulary, then merged; only the merged document frequencies decide
+// which terms are kept. Stop words, terms in fewer than minDocFreq tweets
+// and terms in more than half of them carry no topic signal and are dropped. Weights are
+// (1 + log tf) * smoothed idf, normalized per row so that a dot product
+// with a unit centroid is a cosine similarity.
+TfidfMatrix buildTfidfMatrix(
+    const TweetTable& tweets,
+    const unordered_set<string>& stopWords,
+    size_t minDocFreq,
+    size_t threadCount)
+{
+    struct LocalTerms {
+        unordered_map<string, uint32_t> vocabulary;
+        vector<string> terms;
+        vector<size_t> offsets{0};
+        vector<uint32_t> ids;
+    };
+    
+    size_t n = tweets.size();
+    threadCount = max((size_t)1, min(threadCount, n / 1024 + 1));
+    size_t perThread = (n + threadCount - 1) / threadCount;
+    vector<LocalTerms> local(threadCount);
+    
+    auto work = [&](size_t part) {
+        LocalTerms& out = local[part];
+        size_t begin = min(n, part * perThread), end = min(n, begin + perThread);
+        for (size_t t = begin; t < end; t++) {
+            stringstream ss{string(tweets.text(t))};
+            string rawWord;
+            while (ss >> rawWord) {
+                string word = normalizeWord(rawWord);
+                if (word.empty() || stopWords.count(word)) continue;
+                auto inserted = out.vocabulary.emplace(word, (uint32_t)out.terms.size());
+                if (inserted.second) out.terms.push_back(word);
+                out.ids.push_back(inserted.first->second);
+            }
+            out.offsets.push_back(out.ids.size());
+        }
+    };
+    vector<thread> workers;
+    for (size_t part = 1; part < threadCount; part++) workers.emplace_back(work, part);
+    work(0);
+    for (thread& t : workers) t.join();
+    
+    // Merge vocabularies and rewrite each document as sorted (term, tf) runs
+    unordered_map<string, uint32_t> vocabulary;
+    vector<string> allTerms;
+    vector<size_t> docOffsets{0};
+    vector<uint32_t> docTerms;
+    vector<uint32_t> docCounts;
+    for (LocalTerms& part : local) {
+        vector<uint32_t> toGlobal(part.terms.size());
+        for (size_t i = 0; i < part.terms.size(); i++) {
+            auto inserted = vocabulary.emplace(part.terms[i], (uint32_t)allTerms.size());
+            if (inserted.second) allTerms.push_back(part.terms[i]);
+            toGlobal[i] = inserted.first->second;
+        }
+        vector<uint32_t> doc;
+        for (size_t d = 0; d + 1 < part.offsets.size(); d++) {
+            doc.clear();
+            for (size_t i = part.offsets[d]; i < part.offsets[d + 1]; i++) doc.push_back(toGlobal[part.ids[i]]);
+            sort(doc.begin(), doc.end());
+            for (size_t i = 0; i < doc.size(); ) {
+                size_t j = i;
+                while (j < doc.size() && doc[j] == doc[i]) j++;
+                docTerms.push_back(doc[i]);
+                docCounts.push_back(j - i);
+                i = j;
+            }
+            docOffsets.push_back(docTerms.size());
+        }
+        part = LocalTerms();
+    }
+    
+    vector<size_t> docFreq(allTerms.size(), 0);
+    for (uint32_t term : docTerms) docFreq[term]++;
+    
+    // Kept terms get dense ids in alphabetical order so output is stable
+    vector<uint32_t> keptOrder;
+    for (uint32_t term = 0; term < allTerms.size(); term++) {
+        if (docFreq[term] >= minDocFreq && docFreq[term] * 2 <= n) keptOrder.push_back(term);
+    }
+    sort(keptOrder.begin(), keptOrder.end(), [&](uint32_t a, uint32_t b) { return allTerms[a] < allTerms[b]; });
+    vector<uint32_t> newId(allTerms.size(), UINT32_MAX);
+    vector<float> idf(keptOrder.size());
+    TfidfMatrix matrix;
+    for (uint32_t i = 0; i < keptOrder.size(); i++) {
+        newId[keptOrder[i]] = i;
+        matrix.terms.push_back(allTerms[keptOrder[i]]);
+        idf[i] = log((1.0 + n) / (1.0 + docFreq[keptOrder[i]])) + 1.0;
+    }
+    
+    matrix.rowOffsets.push_back(0);
+    vector<pair<uint32_t, float>> row;
+    for (size_t d = 0; d + 1 < docOffsets.size(); d++) {
+        row.clear();
+        double norm = 0.0;
+        for (size_t i = docOffsets[d]; i < docOffsets[d + 1]; i++) {
+            uint32_t id = newId[docTerms[i]];
+            if (id == UINT32_MAX) continue;
+            float weight = (1.0 + log((double)docCounts[i])) * idf[id];
+            row.push_back({id, weight});
+            norm += (double)weight * weight;
+        }
+        sort(row.begin(), row.end());
+        float scale = norm > 0 ? 1.0 / sqrt(norm) : 0.0;
+        for (const auto& entry : row) {
+            matrix.termIds.push_back(entry.first);
+            matrix.weights.push_back(entry.second * scale);
+        }
+        matrix.rowOffsets.push_back(matrix.termIds.size());
+    }
+    return matrix;
+}
+
+// Sparse row times dense centroid. Four independent accumulators break the
+// add dependency chain so the gathers overlap; rows are short, so this
+// beats a SIMD gather, which would mostly load the same cache lines.
+static float sparseDot(const TfidfMatrix& matrix, size_t row, const float* centroid)
+{
+    const uint32_t* ids = matrix.termIds.data();
+    const float* w = matrix.weights.data();
+    size_t i = matrix.rowOffsets[row], end = matrix.rowOffsets[row + 1];
+    float a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    for (; i + 4 <= end; i += 4) {
+        a0 += w[i] * centroid[ids[i]];
+        a1 += w[i + 1] * centroid[ids[i + 1]];
+        a2 += w[i + 2] * centroid[ids[i + 2]];
+        a3 += w[i + 3] * centroid[ids[i + 3]];
+    }
+    for (; i < end; i++) a0 += w[i] * centroid[ids[i]];
+    return (a0 + a1) + (a2 + a3);
+}
+
+// Spherical k-means (cosine similarity) with k-means++ seeding from a
+// fixed seed, so runs are repeatable. Each iteration splits the rows over
+// threads; a thread assigns its rows and accumulates them into its own
+// centroid sums, which are then added and renormalized. Stops when no row
+// changes cluster. An empty cluster is reseeded with the row that fits its
+// current centroid worst.
+TopicModel kMeansTopics(const TfidfMatrix& matrix, size_t k, size_t maxIterations, size_t threadCount)
+{
+    TopicModel model;
+    size_t n = matrix.rows();
+    size_t dims = matrix.terms.size();
+    model.dimensions = dims;
+    
+    vector<size_t> candidates;
+    for (size_t r = 0; r < n; r++) {
+        if (matrix.rowOffsets[r + 1] > matrix.rowOffsets[r]) candidates.push_back(r);
+    }
+    k = min(k, candidates.size());
+    model.k = k;
+    model.assignment.assign(n, k);
+    if (k == 0) return model;
+    model.centroids.assign(k * dims, 0.0f);
+    
+    auto setCentroidToRow = [&](size_t c, size_t row) {
+        float* centroid = &model.centroids[c * dims];
+        fill(centroid, centroid + dims, 0.0f);
+        for (size_t i = matrix.rowOffsets[row]; i < matrix.rowOffsets[row + 1]; i++) {
+            centroid[matrix.termIds[i]] = matrix.weights[i];
+        }
+    };
+    
+    // k-means++: pick each next seed with probability proportional to its
+    // cosine distance from the nearest seed so far
+    mt19937_64 random(20180101);
+    vector<double> distance(candidates.size(), 1.0);
+    setCentroidToRow(0, candidates[random() % candidates.size()]);
+    for (size_t c = 1; c < k; c++) {
+        double total = 0.0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            double d = 1.0 - sparseDot(matrix, candidates[i], &model.centroids[(c - 1) * dims]);
+            distance[i] = min(distance[i], max(0.0, d));
+            total += distance[i];
+        }
+        double target = uniform_real_distribution<double>(0.0, total)(random);
+        size_t chosen = candidates.size() - 1;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            target -= distance[i];
+            if (target <= 0) {
+                chosen = i;
+                break;
+            }
+        }
+        setCentroidToRow(c, candidates[chosen]);
+    }
+    
+    threadCount = max((size_t)1, min(threadCount, candidates.size() / 4096 + 1));
+    size_t perThread = (candidates.size() + threadCount - 1) / threadCount;
+    vector<vector<float>> sums(threadCount, vector<float>(k * dims));
+    vector<vector<size_t>> counts(threadCount, vector<size_t>(k));
+    vector<size_t> changes(threadCount);
+    vector<float> similarity(n, 0.0f);
+    
+    auto assign = [&](size_t part) {
+        vector<float>& sum = sums[part];
+        vector<size_t>& count = counts[part];
+        fill(sum.begin(), sum.end(), 0.0f);
+        fill(count.begin(), count.end(), 0);
+        changes[part] = 0;
+        size_t begin = min(candidates.size(), part * perThread);
+        size_t end = min(candidates.size(), begin + perThread);
+        for (size_t i = begin; i < end; i++) {
+            size_t row = candidates[i];
+            uint32_t best = 0;
+            float bestScore = -1.0f;
+            for (uint32_t c = 0; c < k; c++) {
+                float score = sparseDot(matrix, row, &model.centroids[c * dims]);
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = c;
+                }
+            }
+            if (model.assignment[row] != best) changes[part]++;
+            model.assignment[row] = best;
+            similarity[row] = bestScore;
+            count[best]++;
+            float* target = &sum[best * dims];
+            for (size_t j = matrix.rowOffsets[row]; j < matrix.rowOffsets[row + 1]; j++) {
+                target[matrix.termIds[j]] += matrix.weights[j];
+            }
+        }
+    };
+    
+    for (model.iterations = 0; model.iterations < maxIterations; model.iterations++) {
+        vector<thread> workers;
+        for (size_t part = 1; part < threadCount; part++) workers.emplace_back(assign, part);
+        assign(0);
+        for (thread& t : workers) t.join();
+        
+        size_t changed = 0;
+        for (size_t part = 0; part < threadCount; part++) changed += changes[part];
+        if (changed == 0) break;
+        
+        for (size_t c = 0; c < k; c++) {
+            float* centroid = &model.centroids[c * dims];
+            size_t members = 0;
+            fill(centroid, centroid + dims, 0.0f);
+            for (size_t part = 0; part < threadCount; part++) {
+                members += counts[part][c];
+                const float* sum = &sums[part][c * dims];
+                for (size_t d = 0; d < dims; d++) centroid[d] += sum[d];
+            }
+            
+            if (members == 0) {
+                size_t worst = candidates[0];
+                for (size_t row : candidates) {
+                    if (similarity[row] < similarity[worst]) worst = row;
+                }
+                setCentroidToRow(c, worst);
+                similarity[worst] = 1.0f;
+                continue;
+            }
+            
+            double norm = 0.0;
+            for (size_t d = 0; d < dims; d++) norm += (double)centroid[d] * centroid[d];
+            float scale = norm > 0 ? 1.0 / sqrt(norm) : 0.0;
+            for (size_t d = 0; d < dims; d++) centroid[d] *= scale;
+        }
+    }
+    return model;
+}
+
+// Clusters the corpus into k topics and prints each topic's size, top
+// terms and average adjusted sentiment, then every senator's average per
+// topic
+int runTopicReport(size_t k, size_t maxIterations)
+{
+    auto started = chrono::steady_clock::now();
+    CorpusState state = loadCorpusState();
+    size_t threadCount = max(1u, thread::hardware_concurrency());
+    TfidfMatrix matrix = buildTfidfMatrix(state.tweets, buildStopWords(), 2, threadCount);
+    TopicModel model = kMeansTopics(matrix, k, maxIterations, threadCount);
+    if (model.k == 0) {
+        cerr << "Error: No tweets with usable terms" << endl;
+        return 1;
+    }
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+    
+    // Rows with no kept terms form an extra, unreported group k
+    GroupKeys topicKeys;
+    topicKeys.keys = model.assignment;
+    topicKeys.groupCount = model.k + 1;
+    TweetMetricColumns columns = buildMetricColumns(state.analyses);
+    GroupAggregate byTopic = groupByAggregate(topicKeys, columns.adjustedScore);
+    
+    cout << model.k << " topics over " << matrix.rows() << " tweets and " << matrix.terms.size()
+         << " terms (" << model.iterations << " iterations, " << elapsed.count() << " ms)\n\n";
+    for (size_t c = 0; c < model.k; c++) {
+        const float* centroid = &model.centroids[c * model.dimensions];
+        vector<uint32_t> top(model.dimensions);
+        for (uint32_t d = 0; d < top.size(); d++) top[d] = d;
+        size_t shown = min((size_t)8, top.size());
+        partial_sort(top.begin(), top.begin() + shown, top.end(), [&](uint32_t a, uint32_t b) {
+            return centroid[a] > centroid[b];
+        });
+        
+        cout << "Topic " << c + 1 << "  (" << byTopic.count[c] << " tweets, avg adjusted "
+             << fixed << setprecision(2) << byTopic.mean(c) << ")\n    ";
+        for (size_t i = 0; i < shown; i++) cout << (i ? ", " : "") << matrix.terms[top[i]];
+        cout << "\n";
+    }
+    if (byTopic.count[model.k] > 0) {
+        cout << "(" << byTopic.count[model.k] << " tweets had no clustered terms)\n";
+    }
+    
+    // Senator x topic averages through the group-by engine
+    GroupKeys senatorKeys = groupKeysFromIds(state.senatorIndex.senatorOfTweet, state.senatorIndex.names.size());
+    GroupKeys keys = combineGroupKeys(senatorKeys, topicKeys);
+    GroupAggregate bySenatorTopic = groupByAggregate(keys, columns.adjustedScore);
+    
+    cout << "\nAverage adjusted sentiment by senator and topic\n";
+    cout << left << setw(24) << "Senator" << right;
+    for (size_t c = 0; c < model.k; c++) cout << setw(8) << ("T" + to_string(c + 1));
+    cout << "\n" << string(24 + 8 * model.k, '-') << "\n";
+    for (size_t id = 0; id < state.senatorIndex.names.size(); id++) {
+        cout << left << setw(24) << state.senatorIndex.names[id] << right;
+        for (size_t c = 0; c < model.k; c++) {
+            size_t group = id * topicKeys.groupCount + c;
+            if (bySenatorTopic.count[group] == 0) cout << setw(8) << "-";
+            else cout << setw(8) << bySenatorTopic.mean(group);
+        }
+        cout << "\n";
+    }
+    return 0;
+}
+
+// ============================================================================
+// WORD-SENTIMENT ASSOCIATION
+// ============================================================================
+
+// One pass over the corpus. Each thread counts its share of tweets into
+// its own vocabulary and maps, which are merged at the end, so memory is
+// proportional to the vocabulary (times threads) rather than the corpus.
+PolarityCounts countTermPolarity(
+    const TweetTable& tweets,
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    const unordered_set<string>& excluded,
+    size_t threadCount)
+{
+    struct LocalCounts {
+        unordered_map<string, uint32_t> vocabulary;
+        vector<string> terms;
+        vector<array<uint64_t, 2>> corpus;
+        unordered_map<uint64_t, array<uint32_t, 2>> bySenator;
+    };
+    
+    size_t n = analyses.size();
+    size_t senatorCount = index.names.size();
+    threadCount = max((size_t)1, min(threadCount, n / 1024 + 1));
+    size_t perThread = (n + threadCount - 1) / threadCount;
+    vector<LocalCounts> local(threadCount);
+    
+    auto work = [&](size_t part) {
+        LocalCounts& out = local[part];
+        size_t begin = min(n, part * perThread), end = min(n, begin + perThread);
+        for (size_t t = begin; t < end; t++) {
+            double score = analyses[t].adjustedSentimentScore;
+            if (score == 0.0) continue;
+            int polarity = score > 0 ? 0 : 1;
+            uint64_t senator = index.senatorOfTweet[t];
+            
+            stringstream ss{string(tweets.text(analyses[t].row))};
+            string rawWord;
+            while (ss >> rawWord) {
+                string word = normalizeWord(rawWord);
+                if (word.empty() || excluded.count(word)) continue;
+                auto inserted = out.vocabulary.emplace(word, (uint32_t)out.terms.size());
+                if (inserted.second) {
+                    out.terms.push_back(word);
+                    out.corpus.push_back({0, 0});
+                }
+                uint32_t term = inserted.first->second;
+                out.corpus[term][polarity]++;
+                out.bySenator[(senator << 32) | term][polarity]++;
+            }
+        }
+    };
+    vector<thread> workers;
+    for (size_t part = 1; part < threadCount; part++) workers.emplace_back(work, part);
+    work(0);
+    for (thread& t : workers) t.join();
+    
+    PolarityCounts counts;
+    counts.senatorTotals.assign(senatorCount, {0, 0});
+    unordered_map<string, uint32_t> vocabulary;
+    for (LocalCounts& part : local) {
+        vector<uint32_t> toGlobal(part.terms.size());
+        for (size_t i = 0; i < part.terms.size(); i++) {
+            auto inserted = vocabulary.emplace(part.terms[i], (uint32_t)counts.terms.size());
+            if (inserted.second) {
+                counts.terms.push_back(part.terms[i]);
+                counts.corpus.push_back({0, 0});
+            }
+            toGlobal[i] = inserted.first->second;
+            for (int c = 0; c < 2; c++) {
+                counts.corpus[toGlobal[i]][c] += part.corpus[i][c];
+                counts.totals[c] += part.corpus[i][c];
+            }
+        }
+        for (const auto& entry : part.bySenator) {
+            uint64_t senator = entry.first >> 32;
+            uint64_t key = (senator << 32) | toGlobal[(uint32_t)entry.first];
+            auto& merged = counts.bySenator[key];
+            for (int c = 0; c < 2; c++) {
+                merged[c] += entry.second[c];
+                counts.senatorTotals[senator][c] += entry.second[c];
+            }
+        }
+        part = LocalCounts();
+    }
+    return counts;
+}
+
+// Log-odds ratio with an informative Dirichlet prior (Monroe, Colaresi &
+// Quinn, "Fightin' Words"): each term's prior is its corpus-wide share of
+// priorStrength pseudo-tokens, so rare words are pulled toward the corpus
+// rate instead of producing huge ratios from one or two uses. Ranked by
+// z-score (delta / its standard error), most positive first. senatorId -1
+// ranks the whole corpus.
+vector<TermAssociation> rankTermAssociations(
+    const PolarityCounts& counts,
+    int senatorId,
+    double priorStrength,
+    uint32_t minCount)
+{
+    vector<TermAssociation> ranked;
+    double corpusTokens = counts.totals[0] + counts.totals[1];
+    if (corpusTokens == 0) return ranked;
+    
+    auto countsOf = [&](uint32_t term) -> array<uint64_t, 2> {
+        if (senatorId < 0) return counts.corpus[term];
+        auto it = counts.bySenator.find(((uint64_t)senatorId << 32) | term);
+        if (it == counts.bySenator.end()) return {0, 0};
+        return {it->second[0], it->second[1]};
+    };
+    array<uint64_t, 2> total = senatorId < 0 ? counts.totals : counts.senatorTotals[senatorId];
+    double sliceTokens = total[0] + total[1];
+    if (total[0] == 0 || total[1] == 0) return ranked;
+    
+    for (uint32_t term = 0; term < counts.terms.size(); term++) {
+        array<uint64_t, 2> c = countsOf(term);
+        if (c[0] + c[1] < minCount) continue;
+        
+        double prior = priorStrength * (counts.corpus[term][0] + counts.corpus[term][1]) / corpusTokens;
+        double positiveOdds = (c[0] + prior) / (total[0] + priorStrength - c[0] - prior);
+        double negativeOdds = (c[1] + prior) / (total[1] + priorStrength - c[1] - prior);
+        
+        TermAssociation association;
+        association.term = term;
+        association.positive = c[0];
+        association.negative = c[1];
+        association.logOdds = log(positiveOdds) - log(negativeOdds);
+        association.zScore = association.logOdds / sqrt(1.0 / (c[0] + prior) + 1.0 / (c[1] + prior));
+        association.pmi = log((c[0] + 0.5) * sliceTokens / ((c[0] + c[1] + 1.0) * total[0]));
+        ranked.push_back(association);
+    }
+    
+    sort(ranked.begin(), ranked.end(), [&](const TermAssociation& a, const TermAssociation& b) {
+        if (a.zScore != b.zScore) return a.zScore > b.zScore;
+        return counts.terms[a.term] < counts.terms[b.term];
+    });
+    return ranked;
+}
+
+// Prints, corpus-wide and per senator, the non-lexicon words most tied to
+// positive and to negative tweets: candidates for new lexicon entries
+int runAssociationReport(size_t top, double priorStrength)
+{
+    CorpusState state = loadCorpusState();
+    const ScoringModel& model = *state.model;
+    
+    unordered_set<string> excluded = buildStopWords();
+    for (const auto& entry : model.wordPolarity) excluded.insert(entry.first);
+    for (const auto& word : model.negationWords) excluded.insert(word);
+    for (const auto& word : model.intensifiers) excluded.insert(word);
+    for (const auto& word : model.downtoners) excluded.insert(word);
+    
+    size_t threadCount = max(1u, thread::hardware_concurrency());
+    PolarityCounts counts = countTermPolarity(state.tweets, state.analyses, state.senatorIndex, excluded, threadCount);
+    
+    auto printRanking = [&](const string& title, int senatorId, uint32_t minCount) {
+        vector<TermAssociation> ranked = rankTermAssociations(counts, senatorId, priorStrength, minCount);
+        cout << title << "\n";
+        if (ranked.empty()) {
+            cout << "    (not enough positive and negative tweets)\n\n";
+            return;
+        }
+        size_t shown = min(top, ranked.size() / 2);
+        auto printRow = [&](const TermAssociation& a) {
+            cout << "    " << left << setw(16) << counts.terms[a.term] << right
+                 << setw(6) << a.positive << setw(6) << a.negative
+                 << fixed << setprecision(2) << setw(9) << a.zScore << setw(9) << a.pmi << "\n";
+        };
+        cout << "    " << left << setw(16) << "Term" << right << setw(6) << "Pos" << setw(6) << "Neg"
+             << setw(9) << "z" << setw(9) << "PMI+" << "\n";
+        for (size_t i = 0; i < shown; i++) printRow(ranked[i]);
+        cout << "    ...\n";
+        for (size_t i = ranked.size() - shown; i < ranked.size(); i++) printRow(ranked[i]);
+        cout << "\n";
+    };
+    
+    cout << "Non-lexicon words by association with positive vs negative tweets\n"
+         << "(log-odds z-score with a Dirichlet prior of " << priorStrength << " tokens)\n\n";
+    printRanking("All senators", -1, 5);
+    for (size_t id = 0; id < state.senatorIndex.names.size(); id++) {
+        printRanking(state.senatorIndex.names[id], id, 3);
+    }
+    return 0;
+}
+
+// ============================================================================
+// APPROXIMATE WORD STATISTICS
+// ============================================================================
+
+CountMinSketch::CountMinSketch(double epsilon, double delta)
+    : width((size_t)ceil(exp(1.0) / epsilon)),
+      depth((size_t)ceil(log(1.0 / delta))),
+      counters(width * depth, 0)
+{
+}
+
+double CountMinSketch::bytesFor(double epsilon, double delta)
+{
+    return ceil(exp(1.0) / epsilon) * ceil(log(1.0 / delta)) * sizeof(uint32_t);
+}
+
+// Row hashes come from one 64-bit hash by double hashing (Kirsch and
+// Mitzenmacher), which keeps the error bound
+void CountMinSketch::add(uint64_t hash, uint32_t count)
+{
+    uint64_t h1 = hash, h2 = mix64(hash) | 1;
+    for (size_t row = 0; row < depth; row++) {
+        counters[row * width + (h1 + row * h2) % width] += count;
+    }
+}
+
+uint32_t CountMinSketch::estimate(uint64_t hash) const
+{
+    uint64_t h1 = hash, h2 = mix64(hash) | 1;
+    uint32_t best = UINT32_MAX;
+    for (size_t row = 0; row < depth; row++) {
+        best = min(best, counters[row * width + (h1 + row * h2) % width]);
+    }
+    return depth == 0 ? 0 : best;
+}
+
+void CountMinSketch::merge(const CountMinSketch& other)
+{
+    for (size_t i = 0; i < counters.size() && i < other.counters.size(); i++) counters[i] += other.counters[i];
+}
+
+void SpaceSaving::swapEntries(size_t a, size_t b)
+{
+    swap(heap[a], heap[b]);
+    position[heap[a].word] = a;
+    position[heap[b].word] = b;
+}
+
+void SpaceSaving::siftDown(size_t i)
+{
+    while (true) {
+        size_t smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < heap.size() && heap[left].count < heap[smallest].count) smallest = left;
+        if (right < heap.size() && heap[right].count < heap[smallest].count) smallest = right;
+        if (smallest == i) return;
+        swapEntries(i, smallest);
+        i = smallest;
+    }
+}
+
+void SpaceSaving::siftUp(size_t i)
+{
+    while (i > 0 && heap[(i - 1) / 2].count > heap[i].count) {
+        swapEntries(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void SpaceSaving::add(const string& word, uint64_t count)
+{
+    if (capacity == 0) return;
+    auto found = position.find(word);
+    if (found != position.end()) {
+        heap[found->second].count += count;
+        siftDown(found->second);
+        return;
+    }
+    if (heap.size() < capacity) {
+        heap.push_back({word, count, 0});
+        position[word] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+        return;
+    }
+    // Evict the smallest; the newcomer inherits its count as error
+    position.erase(heap[0].word);
+    uint64_t evicted = heap[0].count;
+    heap[0] = {word, evicted + count, evicted};
+    position[word] = 0;
+    siftDown(0);
+}
+
+// Words missing from one side may have occurred there up to that side's
+// minimum count, so they are credited with it (as both count and error);
+// the largest `capacity` of the combined entries are kept
+void SpaceSaving::merge(const SpaceSaving& other)
+{
+    uint64_t ourMinimum = minimum(), theirMinimum = other.minimum();
+    unordered_map<string, Entry> combined;
+    for (const Entry& e : heap) combined[e.word] = {e.word, e.count + theirMinimum, e.error + theirMinimum};
+    for (const Entry& e : other.heap) {
+        auto found = combined.find(e.word);
+        if (found != combined.end()) {
+            found->second.count += e.count - theirMinimum;
+            found->second.error += e.error - theirMinimum;
+        } else {
+            combined[e.word] = {e.word, e.count + ourMinimum, e.error + ourMinimum};
+        }
+    }
+    
+    vector<Entry> entries;
+    for (auto& entry : combined) entries.push_back(move(entry.second));
+    sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.count != b.count ? a.count > b.count : a.word < b.word;
+    });
+    if (entries.size() > capacity) entries.resize(capacity);
+    
+    heap.clear();
+    position.clear();
+    for (Entry& entry : entries) {
+        heap.push_back(move(entry));
+        position[heap.back().word] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+    }
+}
+
+vector<SpaceSaving::Entry> SpaceSaving::top() const
+{
+    vector<Entry> entries = heap;
+    sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.count != b.count ? a.count > b.count : a.word < b.word;
+    });
+    return entries;
+}
+
+void HyperLogLog::add(uint64_t hash)
+{
+    hash = mix64(hash);
+    size_t index = hash >> (64 - precision);
+    uint64_t rest = hash << precision;
+    uint8_t rank = 1;
+    while (rank <= 64 - precision && !(rest & (1ULL << 63))) {
+        rest <<= 1;
+        rank++;
+    }
+    registers[index] = max(registers[index], rank);
+}
+
+void HyperLogLog::merge(const HyperLogLog& other)
+{
+    for (size_t i = 0; i < registers.size() && i < other.registers.size(); i++) {
+        registers[i] = max(registers[i], other.registers[i]);
+    }
+}
+
+double HyperLogLog::estimate() const
+{
+    double m = registers.size();
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t r : registers) {
+        sum += ldexp(1.0, -(int)r);
+        if (r == 0) zeros++;
+    }
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double raw = alpha * m * m / sum;
+    // Small cardinalities: linear counting is far more accurate
+    if (raw <= 2.5 * m && zeros > 0) return m * log(m / zeros);
+    return raw;
+}
+
+void WordSketches::add(const string& word)
+{
+    uint64_t hash = fnv1aHash(word);
+    counts.add(hash);
+    heavyHitters.add(word);
+    vocabulary.add(hash);
+    tokens++;
+}
+
+void WordSketches::merge(const WordSketches& other)
+{
+    counts.merge(other.counts);
+    heavyHitters.merge(other.heavyHitters);
+    vocabulary.merge(other.vocabulary);
+    tokens += other.tokens;
+}
+
+// Each senator is sketched by one thread, which reads that senator's
+// tweets in file order, so there is nothing to merge. Threads take
+// contiguous runs of senators holding about equal numbers of tweets.
+// Memory is one copy of prototype per senator, whatever the thread count
+// or corpus size.
+vector<WordSketches> sketchSenatorWords(
+    const TweetTable& tweets,
+    const SenatorIndex& index,
+    const WordSketches& prototype,
+    size_t threadCount)
+{
+    size_t n = tweets.size();
+    size_t senatorCount = index.names.size();
+    threadCount = max((size_t)1, min(threadCount, n / 1024 + 1));
+    vector<WordSketches> bySenator(senatorCount, prototype);
+    
+    // Part p sketches senators [firstSenator[p], firstSenator[p + 1])
+    vector<size_t> firstSenator(threadCount + 1, senatorCount);
+    auto offsetsEnd = index.tweetOffsets.begin() + senatorCount;
+    for (size_t part = 0; part < threadCount; part++) {
+        firstSenator[part] = lower_bound(index.tweetOffsets.begin(), offsetsEnd, n * part / threadCount) -
+                             index.tweetOffsets.begin();
+    }
+    
+    auto work = [&](size_t part) {
+        for (size_t id = firstSenator[part]; id < firstSenator[part + 1]; id++) {
+            WordSketches& sketches = bySenator[id];
+            for (size_t pos = index.tweetOffsets[id]; pos < index.tweetOffsets[id + 1]; pos++) {
+                stringstream ss{string(tweets.text(index.tweetOrder[pos]))};
+                string rawWord;
+                while (ss >> rawWord) {
+                    string word = normalizeWord(rawWord);
+                    if (!word.empty()) sketches.add(word);
+                }
+            }
+        }
+    };
+    vector<thread> workers;
+    for (size_t part = 1; part < threadCount; part++) workers.emplace_back(work, part);
+    work(0);
+    for (thread& t : workers) t.join();
+    return bySenator;
+}
+
+// Per senator and overall: the exact base stats next to the sketched
+// token count, estimated vocabulary size and heavy-hitter words
+int runSketchReport(size_t top, double epsilon)
+{
+    CorpusState state = loadCorpusState();
+    const double delta = 0.01;
+    const size_t heavyHitterCapacity = 1024;
+    const int hllPrecision = 12;
+    const double maxSketchBytes = 1 << 30;  // all Count-Min counters together
+    
+    // One sketch per senator, the corpus-wide merge and the prototype
+    size_t copies = state.senatorIndex.names.size() + 2;
+    double sketchBytes = CountMinSketch::bytesFor(epsilon, delta) * copies;
+    if (sketchBytes > maxSketchBytes) {
+        double widthLimit = floor(maxSketchBytes / (copies * ceil(log(1.0 / delta)) * sizeof(uint32_t)));
+        double smallest = exp(1.0) / (widthLimit - 1);
+        double scale = pow(10.0, floor(log10(smallest)) - 1);
+        smallest = ceil(smallest / scale) * scale;  // rounded up to two digits
+        cerr << "Error: Epsilon " << epsilon << " would need more than " << (size_t)maxSketchBytes / (1 << 20)
+             << " MiB of Count-Min counters for " << copies - 2 << " senators; use epsilon "
+             << setprecision(2) << smallest << " or larger" << endl;
+        return 1;
+    }
+    WordSketches prototype(epsilon, delta, heavyHitterCapacity, hllPrecision);
+    
+    size_t threadCount = max(1u, thread::hardware_concurrency());
+    vector<WordSketches> bySenator = sketchSenatorWords(state.tweets, state.senatorIndex, prototype, threadCount);
+    WordSketches all = prototype;
+    for (const auto& sketches : bySenator) all.merge(sketches);
+    unordered_set<string> stopWords = buildStopWords();
+    
+    cout << "Approximate word statistics (fixed memory per slice: Count-Min "
+         << prototype.counts.bytes() / 1024 << " KiB, Space-Saving " << heavyHitterCapacity
+         << " words, HyperLogLog " << (1 << hllPrecision) << " registers)\n"
+         << "Count-Min: +" << epsilon * 100 << "% of tokens at most, with " << (1 - delta) * 100
+         << "% confidence; HyperLogLog: +/-" << fixed << setprecision(1)
+         << prototype.vocabulary.relativeError() * 100 << "% standard error\n\n";
+    
+    auto printSlice = [&](const string& name, const WordSketches& sketches,
+                          int tweets, int words, double positivePercent, double negativePercent) {
+        cout << name << "\n"
+             << "    exact: " << tweets << " tweets, " << words << " words, "
+             << setprecision(2) << positivePercent << "% positive, " << negativePercent << "% negative\n"
+             << "    sketch: " << sketches.tokens << " tokens, ~"
+             << setprecision(0) << sketches.vocabulary.estimate() << " distinct stems\n"
+             << "    heavy hitters (count range, Count-Min estimate):";
+        size_t shown = 0;
+        for (const auto& entry : sketches.heavyHitters.top()) {
+            if (shown == top) break;
+            if (stopWords.count(entry.word)) continue;
+            cout << (shown % 3 == 0 ? "\n        " : "  ")
+                 << left << setw(12) << entry.word << right
+                 << setw(5) << entry.count - entry.error << "-" << left << setw(5) << entry.count << right
+                 << " ~" << setw(5) << left << sketches.counts.estimate(fnv1aHash(entry.word)) << right;
+            shown++;
+        }
+        cout << "\n\n";
+    };
+    
+    int allTweets = 0, allWords = 0, allPositive = 0, allNegative = 0;
+    for (size_t id = 0; id < state.senatorIndex.names.size(); id++) {
+        const string& name = state.senatorIndex.names[id];
+        auto base = state.baseIndex.find(name);
+        if (base == state.baseIndex.end()) continue;
+        const SenatorStats& stats = state.baseStats[base->second];
+        allTweets += stats.totalTweets;
+        allWords += stats.totalWords;
+        allPositive += stats.totalPositiveWords;
+        allNegative += stats.totalNegativeWords;
+        printSlice(name, bySenator[id], stats.totalTweets, stats.totalWords,
+                   stats.positivePercent, stats.negativePercent);
+    }
+    printSlice("All senators", all, allTweets, allWords,
+               allWords ? 100.0 * allPositive / allWords : 0.0,
+               allWords ? 100.0 * allNegative / allWords : 0.0);
+    return 0;
+}
+
+// ============================================================================
+// TOP-K RANKING ENGINE
+// ============================================================================
+
+double scoreOf(const AdvancedTweetAnalysis& analysis, ScoreKind kind)
+{
+    return kind == ScoreKind::Base ? analysis.baseSentimentScore
+                                   : analysis.adjustedSentimentScore;
+}
+
+// True when a should be listed before b. Ties go to the earlier tweet (or
+// lower senator id) so results do not depend on thread scheduling.
+static bool ranksBefore(const RankedItem& a, const RankedItem& b, RankOrder order)
+{
+    if (a.score != b.score) {
+        return order == RankOrder::MostPositive ? a.score > b.score : a.score < b.score;
+    }
+    return a.index < b.index;
+}
+
+// Bounded heap holding the best k items seen so far. The heap top is the
+// worst item kept, so each candidate costs one comparison and at most one
+// O(log k) replacement.
+class TopKHeap {
+private:
+    size_t k;
+    RankOrder order;
+    vector<RankedItem> heap;
+    
+public:
+    // At most candidateCount items will be offered, so a client's k larger
+    // than that never reserves more than the candidates need
+    TopKHeap(size_t limit, RankOrder rankOrder, size_t candidateCount)
+        : k(min(limit, candidateCount)), order(rankOrder) {
+        heap.reserve(k);
+    }
+    
+    void offer(const RankedItem& item) {
+        // Ordering the heap by ranksBefore puts the worst kept item on top
+        auto cmp = [this](const RankedItem& a, const RankedItem& b) { return ranksBefore(a, b, order); };
+        if (heap.size() < k) {
+            heap.push_back(item);
+            push_heap(heap.begin(), heap.end(), cmp);
+        } else if (k > 0 && ranksBefore(item, heap.front(), order)) {
+            pop_heap(heap.begin(), heap.end(), cmp);
+            heap.back() = item;
+            push_heap(heap.begin(), heap.end(), cmp);
+        }
+    }
+    
+    void merge(const TopKHeap& other) {
+        for (const auto& item : other.heap) offer(item);
+    }
+    
+    // Drains the heap into best-first order
+    vector<RankedItem> sorted() const {
+        vector<RankedItem> result = heap;
+        sort(result.begin(), result.end(), [this](const RankedItem& a, const RankedItem& b) {
+            return ranksBefore(a, b, order);
+        });
+        return result;
+    }
+};
+
+bool TopKFilter::acceptsTime(long long createdAt) const
+{
+    // Undated tweets only pass when the range is unbounded
+    if (createdAt == invalidCreatedAt) return fromTime == LLONG_MIN && toTime == LLONG_MAX;
+    return createdAt >= fromTime && createdAt < toTime;
+}
+
+// Collects the tweet indices a filter can match: one senator's range from
+// the index, or every tweet.
+static vector<size_t> candidateTweets(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    const TopKFilter& filter)
+{
+    vector<size_t> candidates;
+    if (filter.senatorId >= 0) {
+        for (size_t pos = index.tweetOffsets[filter.senatorId];
+             pos < index.tweetOffsets[filter.senatorId + 1]; pos++) {
+            candidates.push_back(index.tweetOrder[pos]);
+        }
+    } else {
+        candidates.resize(analyses.size());
+        for (size_t i = 0; i < analyses.size(); i++) candidates[i] = i;
+    }
+    return candidates;
+}
+
+vector<RankedItem> topKTweets(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    size_t k,
+    ScoreKind kind,
+    RankOrder order,
+    const TopKFilter& filter)
+{
+    vector<size_t> candidates = candidateTweets(analyses, index, filter);
+    
+    auto scanRange = [&](size_t begin, size_t end, TopKHeap& heap) {
+        for (size_t c = begin; c < end; c++) {
+            const auto& analysis = analyses[candidates[c]];
+            if (!filter.acceptsTime(analysis.createdAt)) continue;
+            heap.offer({candidates[c], scoreOf(analysis, kind)});
+        }
+    };
+    
+    // Small inputs are not worth a thread launch
+    const size_t minPerThread = 1 << 15;
+    size_t threadCount = max(1u, thread::hardware_concurrency());
+    threadCount = min(threadCount, max((size_t)1, candidates.size() / minPerThread));
+    
+    TopKHeap result(k, order, candidates.size());
+    if (threadCount == 1) {
+        scanRange(0, candidates.size(), result);
+        return result.sorted();
+    }
+    
+    // Each thread keeps its own heap; merging costs O(threads * k log k)
+    size_t chunk = (candidates.size() + threadCount - 1) / threadCount;
+    vector<TopKHeap> heaps(threadCount, TopKHeap(k, order, chunk));
+    vector<thread> workers;
+    for (size_t t = 0; t < threadCount; t++) {
+        size_t begin = t * chunk;
+        size_t end = min(candidates.size(), begin + chunk);
+        workers.emplace_back([&, t, begin, end]() { scanRange(begin, end, heaps[t]); });
+    }
+    for (auto& worker : workers) worker.join();
+    for (const auto& heap : heaps) result.merge(heap);
+    return result.sorted();
+}
+
+vector<RankedItem> topKSenators(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    size_t k,
+    ScoreKind kind,
+    RankOrder order,
+    const TopKFilter& filter)
+{
+    // Averages are computed over the tweets that pass the date filter, so a
+    // date range ranks senators by how they tweeted in that window.
+    size_t firstId = filter.senatorId >= 0 ? filter.senatorId : 0;
+    size_t lastId = filter.senatorId >= 0 ? filter.senatorId + 1 : index.names.size();
+    TopKHeap heap(k, order, lastId - firstId);
+    for (size_t id = firstId; id < lastId; id++) {
+        double total = 0.0;
+        int count = 0;
+        for (size_t pos = index.tweetOffsets[id]; pos < index.tweetOffsets[id + 1]; pos++) {
+            const auto& analysis = analyses[index.tweetOrder[pos]];
+            if (!filter.acceptsTime(analysis.createdAt)) continue;
+            total += scoreOf(analysis, kind);
+            count++;
+        }
+        if (count > 0) heap.offer({id, total / count});
+    }
+    return heap.sorted();
+}
+
+// ============================================================================
+// SENTIMENT TRENDS
+// ============================================================================
+
+const char* trendBucketName(TrendBucket bucket)
+{
+    switch (bucket) {
+        case TrendBucket::Day: return "day";
+        case TrendBucket::Week: return "week";
+        case TrendBucket::Month: return "month";
+    }
+    return "day";
+}
+
+bool parseTrendBucket(const string& name, TrendBucket& bucket)
+{
+    if (name == "day") bucket = TrendBucket::Day;
+    else if (name == "week") bucket = TrendBucket::Week;
+    else if (name == "month") bucket = TrendBucket::Month;
+    else return false;
+    return true;
+}
+
+// Absolute bucket number: days since the epoch, Monday-based weeks since
+// the epoch, or months since January 1970.
+long long absoluteBucket(long long epochSeconds, TrendBucket bucket)
+{
+    long long days = epochSeconds >= 0 ? epochSeconds / 86400 : (epochSeconds - 86399) / 86400;
+    switch (bucket) {
+        case TrendBucket::Day:
+            return days;
+        case TrendBucket::Week:
+            // 1970-01-01 was a Thursday; shift so weeks start on Monday
+            return (days + 3 >= 0) ? (days + 3) / 7 : (days + 3 - 6) / 7;
+        case TrendBucket::Month: {
+            long long year;
+            int month, day;
+            civilFromDays(days, year, month, day);
+            return (year - 1970) * 12 + (month - 1);
+        }
+    }
+    return days;
+}
+
+string bucketStartDate(long long absolute, TrendBucket bucket)
+{
+    switch (bucket) {
+        case TrendBucket::Day:
+            return formatCivilDate(absolute);
+        case TrendBucket::Week:
+            return formatCivilDate(absolute * 7 - 3);
+        case TrendBucket::Month: {
+            long long year = 1970 + (absolute >= 0 ? absolute / 12 : (absolute - 11) / 12);
+            int month = absolute - (year - 1970) * 12 + 1;
+            return formatCivilDate(daysFromCivil(year, month, 1));
+        }
+    }
+    return "";
+}
+
+size_t SentimentTrend::bucketOf(long long epochSeconds) const
+{
+    long long b = absoluteBucket(epochSeconds, bucket) - firstBucket;
+    if (b < 0) return 0;
+    return min((size_t)b, bucketCount);
+}
+
+double SentimentTrend::rangeSum(int series, size_t fromBucket, size_t toBucket, ScoreKind kind) const
+{
+    const vector<double>& prefix = kind == ScoreKind::Base ? basePrefix : adjustedPrefix;
+    size_t row = series * (bucketCount + 1);
+    return prefix[row + toBucket] - prefix[row + fromBucket];
+}
+
+long long SentimentTrend::rangeCount(int series, size_t fromBucket, size_t toBucket) const
+{
+    size_t row = series * (bucketCount + 1);
+    return countPrefix[row + toBucket] - countPrefix[row + fromBucket];
+}
+
+bool SentimentTrend::rangeAverage(int series, size_t fromBucket, size_t toBucket,
+                                  ScoreKind kind, double& average) const
+{
+    long long count = rangeCount(series, fromBucket, toBucket);
+    if (count == 0) return false;
+    average = rangeSum(series, fromBucket, toBucket, kind) / count;
+    return true;
+}
+
+SentimentTrend buildSentimentTrend(
+    const vector<AdvancedTweetAnalysis>& analyses,
+    const SenatorIndex& index,
+    TrendBucket bucket)
+{
+    SentimentTrend trend;
+    trend.bucket = bucket;
+    trend.seriesCount = index.names.size() + 1;
+    
+    // Undated tweets are left out of every series
+    vector<long long> buckets(analyses.size());
+    long long first = LLONG_MAX, last = LLONG_MIN;
+    for (size_t i = 0; i < analyses.size(); i++) {
+        if (analyses[i].createdAt == invalidCreatedAt) continue;
+        buckets[i] = absoluteBucket(analyses[i].createdAt, bucket);
+        first = min(first, buckets[i]);
+        last = max(last, buckets[i]);
+    }
+    if (first > last) first = last = 0;
+    
+    trend.firstBucket = first;
+    trend.bucketCount = last - first + 1;
+    
+    // Scatter per-bucket totals into slot b + 1 of each series row, then
+    // turn every row into running sums.
+    size_t rowSize = trend.bucketCount + 1;
+    trend.basePrefix.assign(trend.seriesCount * rowSize, 0.0);
+    trend.adjustedPrefix.assign(trend.seriesCount * rowSize, 0.0);
+    trend.countPrefix.assign(trend.seriesCount * rowSize, 0);
+    
+    int allSeries = trend.seriesCount - 1;
+    for (size_t i = 0; i < analyses.size(); i++) {
+        if (analyses[i].createdAt == invalidCreatedAt) continue;
+        size_t slot = buckets[i] - first + 1;
+        for (int series : {index.senatorOfTweet[i], allSeries}) {
+            size_t cell = series * rowSize + slot;
+            trend.basePrefix[cell] += analyses[i].baseSentimentScore;
+            trend.adjustedPrefix[cell] += analyses[i].adjustedSentimentScore;
+            trend.countPrefix[cell]++;
+        }
+    }
+    for (int series = 0; series < trend.seriesCount; series++) {
+        size_t row = series * rowSize;
+        for (size_t b = 1; b < rowSize; b++) {
+            trend.basePrefix[row + b] += trend.basePrefix[row + b - 1];
+            trend.adjustedPrefix[row + b] += trend.adjustedPrefix[row + b - 1];
+            trend.countPrefix[row + b] += trend.countPrefix[row + b - 1];
+        }
+    }
+    
+    return trend;
+}
+
+void writeTrendJson(
+    const SentimentTrend& trend,
+    const SenatorIndex& index,
+    size_t window,
+    const string& filename)
+{
+    ofstream out(filename);
+    if (!out.is_open()) {
+        cerr << "Error: Could not create " << filename << endl;
+        return;
+    }
+    
+    auto writeAverage = [&](int series, size_t from, size_t to, ScoreKind kind) {
+        double average;
+        if (trend.rangeAverage(series, from, to, kind, average)) out << average;
+        else out << "null";
+    };
+    
+    out << fixed << setprecision(4);
+    out << "{\n";
+    out << "  \"bucket\": \"" << trendBucketName(trend.bucket) << "\",\n";
+    out << "  \"rollingWindow\": " << window << ",\n";
+    out << "  \"series\": [\n";
+    for (int series = 0; series < trend.seriesCount; series++) {
+        bool all = (series == trend.seriesCount - 1);
+        out << "    {\n";
+        out << "      \"name\": \"" << (all ? "All Senators" : escapeJsonString(index.names[series])) << "\",\n";
+        out << "      \"points\": [\n";
+        for (size_t b = 0; b < trend.bucketCount; b++) {
+            // Rolling average over the last `window` buckets, weighted by tweets
+            size_t windowStart = b + 1 >= window ? b + 1 - window : 0;
+            out << "        {\"start\": \"" << bucketStartDate(trend.firstBucket + b, trend.bucket) << "\""
+                << ", \"count\": " << trend.rangeCount(series, b, b + 1)
+                << ", \"avgBase\": ";
+            writeAverage(series, b, b + 1, ScoreKind::Base);
+            out << ", \"avgAdjusted\": ";
+            writeAverage(series, b, b + 1, ScoreKind::Adjusted);
+            out << ", \"rollingAdjusted\": ";
+            writeAverage(series, windowStart, b + 1, ScoreKind::Adjusted);
+            out << "}";
+            if (b + 1 < trend.bucketCount) out << ",";
+            out << "\n";
+        }
+        out << "      ]\n";
+        out << "    }";
+        if (!all) out << ",";
+        out << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    
+    out.close();
+    cout << "Trends exported to " << filename << endl;
+}
+
+// ============================================================================
+// JSON EXPORT
+// ============================================================================
+
+void writeAnalysisJson(
+    const vector<SenatorStats>& baseStats,
+    const vector<AdvancedSenatorSummary>& advancedSummaries,
+    const TweetTable& tweets,
+    const vector<AdvancedTweetAnalysis>& allTweetAnalyses,
+    const string& filename)
+{
+    ofstream out(filename);
+    if (!out.is_open()) {
+        cerr << "Error: Could not create " << filename << endl;
+        return;
+    }
+    
+    // Get current timestamp
+    time_t now = time(0);
+    char timestamp[100];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    
+    out << "{\n";
+    out << "  \"generatedAt\": \"" << timestamp << "\",\n";
+    out << "  \"senators\": [\n";
+    
+    // Build maps for easy lookup
+    unordered_map<string, SenatorStats> baseMap;
+    for (const auto& stat : baseStats) {
+        baseMap[stat.name] = stat;
+    }
+    
+    unordered_map<string, vector<size_t>> tweetsBySenator; // name -> indexes into allTweetAnalyses
+    for (size_t i = 0; i < allTweetAnalyses.size(); i++) {
+        tweetsBySenator[tweets.senatorName(allTweetAnalyses[i].row)].push_back(i);
+    }
+    
+    for (size_t i = 0; i < advancedSummaries.size(); i++) {
+        const auto& summary = advancedSummaries[i];
+        const auto& base = baseMap[summary.name];
+        
+        out << "    {\n";
+        out << "      \"name\": \"" << escapeJsonString(summary.name) << "\",\n";
+        
+        writeSenatorStatsJson(out, base, summary, "      ");
+        
+        // Tweets
+        out << "      \"tweets\": [\n";
+        const auto& senatorTweets = tweetsBySenator[summary.name];
+        for (size_t j = 0; j < senatorTweets.size(); j++) {
+            writeTweetDetailJson(out, tweets, allTweetAnalyses[senatorTweets[j]], "        ");
+            if (j < senatorTweets.size() - 1) out << ",";
+            out << "\n";
+        }
+        out << "      ]\n";
+        out << "    }";
+        if (i < advancedSummaries.size() - 1) out << ",";
+        out << "\n";
+    }
+    
+    out << "  ]\n";
+    out << "}\n";
+    
+    out.close();
+    cout << "Analysis exported to " << filename << endl;
+}
+
+// Shared by the monolithic export and the per-senator shards, so both
+// stay byte-for-byte consistent. Writes the baseStats and advancedSummary
+// members, each followed by a comma.
+void writeSenatorStatsJson(
+    ostream& out,
+    const SenatorStats& base,
+    const AdvancedSenatorSummary& summary,
+    const string& indent)
+{
+    // Base stats
+    out << indent << "\"baseStats\": {\n";
+    out << indent << "  \"totalTweets\": " << base.totalTweets << ",\n";
+    out << indent << "  \"totalWords\": " << base.totalWords << ",\n";
+    out << indent << "  \"positivePercent\": " << fixed << setprecision(2) << base.positivePercent << ",\n";
+    out << indent << "  \"negativePercent\": " << fixed << setprecision(2) << base.negativePercent << "\n";
+    out << indent << "},\n";
+    
+    // Advanced summary
+    out << indent << "\"advancedSummary\": {\n";
+    out << indent << "  \"avgBaseSentiment\": " << fixed << setprecision(2) << summary.avgBaseSentiment << ",\n";
+    out << indent << "  \"avgAdjustedSentiment\": " << fixed << setprecision(2) << summary.avgAdjustedSentiment << ",\n";
+    out << indent << "  \"avgPosPercent\": " << fixed << setprecision(2) << summary.avgPosPercent << ",\n";
+    out << indent << "  \"avgNegPercent\": " << fixed << setprecision(2) << summary.avgNegPercent << ",\n";
+    out << indent << "  \"avgAllCaps\": " << fixed << setprecision(2) << summary.avgAllCaps << ",\n";
+    out << indent << "  \"avgExclamations\": " << fixed << setprecision(2) << summary.avgExclamations << ",\n";
+    out << indent << "  \"avgStyleScore\": " << fixed << setprecision(2) << summary.avgStyleScore << "\n";
+    out << indent << "},\n";
+}
+
+// Writes one tweet object without a trailing comma or newline
+void writeTweetDetailJson(ostream& out, const TweetTable& tweets, const AdvancedTweetAnalysis& t, const string& indent)
+{
+    out << indent << "{\n";
+    out << indent << "  \"tweetId\": \"" << escapeJsonString(tweets.tweetId(t.row)) << "\",\n";
+    out << indent << "  \"datetime\": \"" << escapeJsonString(tweets.datetime(t.row)) << "\",\n";
+    out << indent << "  \"text\": \"" << escapeJsonString(tweets.text(t.row)) << "\",\n";
+    out << indent << "  \"totalWords\": " << t.totalWords << ",\n";
+    out << indent << "  \"posWordCount\": " << t.posWordCount << ",\n";
+    out << indent << "  \"negWordCount\": " << t.negWordCount << ",\n";
+    out << indent << "  \"baseSentimentScore\": " << fixed << setprecision(2) << t.baseSentimentScore << ",\n";
+    out << indent << "  \"adjustedSentimentScore\": " << fixed << setprecision(2) << t.adjustedSentimentScore << ",\n";
+    out << indent << "  \"negationHits\": " << t.negationHits << ",\n";
+    out << indent << "  \"intensifierHits\": " << t.intensifierHits << ",\n";
+    out << indent << "  \"downtonerHits\": " << t.downtonerHits << ",\n";
+    out << indent << "  \"exclamationCount\": " << t.exclamationCount << ",\n";
+    out << indent << "  \"questionCount\": " << t.questionCount << ",\n";
+    out << indent << "  \"allCapsWordCount\": " << t.allCapsWordCount << ",\n";
+    out << indent << "  \"emojiPositiveCount\": " << t.emojiPositiveCount << ",\n";
+    out << indent << "  \"emojiNegativeCount\": " << t.emojiNegativeCount << ",\n";
+    out << indent << "  \"slangPositiveCount\": " << t.slangPositiveCount << ",\n";
+    out << indent << "  \"slangNegativeCount\": " << t.slangNegativeCount << ",\n";
+    out << indent << "  \"ngramPositiveHits\": " << t.ngramPositiveHits << ",\n";
+    out << indent << "  \"ngramNegativeHits\": " << t.ngramNegativeHits << "\n";
+    out << indent << "}";
+}
+
+static string formatTweetJson(
+    string_view tweetId,
+    string_view senatorName,
+    string_view datetime,
+    string_view text,
+    const AdvancedTweetAnalysis& t)
+{
+    ostringstream out;
+    out << "{\"tweetId\":\"" << escapeJsonString(tweetId) << "\""
+        << ",\"senator\":\"" << escapeJsonString(senatorName) << "\""
+        << ",\"datetime\":\"" << escapeJsonString(datetime) << "\""
+        << ",\"text\":\"" << escapeJsonString(text) << "\""
+        << ",\"totalWords\":" << t.totalWords
+        << ",\"posWordCount\":" << t.posWordCount
+        << ",\"negWordCount\":" << t.negWordCount
+        << fixed << setprecision(2)
+        << ",\"baseSentimentScore\":" << t.baseSentimentScore
+        << ",\"adjustedSentimentScore\":" << t.adjustedSentimentScore
+        << "}";
+    return out.str();
+}
+
+string formatTweetJson(const TweetTable& tweets, const AdvancedTweetAnalysis& t)
+{
+    return formatTweetJson(tweets.tweetId(t.row), tweets.senatorName(t.row), tweets.datetime(t.row), tweets.text(t.row), t);
+}
+
+// For a tweet scored on its own, outside any TweetTable
+string formatTweetJson(const Tweet& tweet, const AdvancedTweetAnalysis& t)
+{
+    return formatTweetJson(tweet.tweetId, tweet.senatorName, tweet.datetime, tweet.text, t);
+}
+
+// ============================================================================
+// SHARDED EXPORT
+// ============================================================================
+
+// 64-bit FNV-1a; only used to notice that a shard's bytes changed
+uint64_t fnv1aHash(const string& data)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// "Sen. Jane Doe-Smith" -> "sen-jane-doe-smith"
+string shardFileName(const string& senatorName)
+{
+    string slug;
+    for (unsigned char c : senatorName) {
+        if (isalnum(c)) slug += (char)tolower(c);
+        else if (!slug.empty() && slug.back() != '-') slug += '-';
+    }
+    while (!slug.empty() && slug.back() == '-') slug.pop_back();
+    return slug.empty() ? "senator" : slug;
+}
+
+// Writes <directory>/index.json (per-senator summaries plus shard file names
+// and hashes) and one <slug>.json of tweet detail per senator. Shards are
+// rendered and written in parallel; a shard whose content hash matches the
+// one recorded in shards.manifest by the previous run, and whose file on
+// disk still holds exactly that content, is left untouched.
+// Files are written to a temporary name and renamed, so a reader never sees
+// a half-written shard.
+int exportSenatorShards(const CorpusState& state, const string& directory, size_t threadCount)
+{
+    namespace fs = std::filesystem;
+    
+    error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec) {
+        cerr << "Error: Could not create " << directory << endl;
+        return 1;
+    }
+    fs::path root(directory);
+    
+    // Previous run's hashes
+    unordered_map<string, uint64_t> previousHashes;
+    ifstream manifestIn(root / "shards.manifest");
+    string hashText, fileName;
+    while (manifestIn >> hashText >> fileName) {
+        previousHashes[fileName] = strtoull(hashText.c_str(), nullptr, 16);
+    }
+    manifestIn.close();
+    
+    // Shard names are fixed before any thread starts; a second senator with
+    // the same slug gets a numeric suffix
+    const SenatorIndex& index = state.senatorIndex;
+    size_t senatorCount = index.names.size();
+    vector<string> fileNames(senatorCount);
+    unordered_set<string> usedNames = {"index.json"};
+    for (size_t id = 0; id < senatorCount; id++) {
+        string slug = shardFileName(index.names[id]);
+        string name = slug + ".json";
+        for (int suffix = 2; usedNames.count(name); suffix++) {
+            name = slug + "-" + to_string(suffix) + ".json";
+        }
+        usedNames.insert(name);
+        fileNames[id] = name;
+    }
+    
+    auto writeAtomically = [](const fs::path& path, const string& content) {
+        fs::path temporary = path;
+        temporary += ".tmp";
+        ofstream out(temporary, ios::binary);
+        if (!out.is_open()) return false;
+        out << content;
+        out.close();
+        if (!out) return false;
+        error_code renameError;
+        fs::rename(temporary, path, renameError);
+        return !renameError;
+    };
+    
+    // The manifest only says what was written last time; the file may have
+    // been edited, truncated or replaced since
+    auto fileHolds = [](const fs::path& path, const string& content) {
+        error_code sizeError;
+        if (fs::file_size(path, sizeError) != content.size() || sizeError) return false;
+        ifstream in(path, ios::binary);
+        string existing(content.size(), '\0');
+        return in.read(&existing[0], existing.size()) && existing == content;
+    };
+    
+    vector<uint64_t> hashes(senatorCount);
+    vector<char> rewritten(senatorCount, 0);
+    vector<char> failed(senatorCount, 0);
+    atomic<size_t> nextSenator{0};
+    
+    auto worker = [&]() {
+        for (size_t id = nextSenator++; id < senatorCount; id = nextSenator++) {
+            ostringstream shard;
+            shard << "{\n";
+            shard << "  \"name\": \"" << escapeJsonString(index.names[id]) << "\",\n";
+            shard << "  \"tweets\": [\n";
+            for (size_t i = index.tweetOffsets[id]; i < index.tweetOffsets[id + 1]; i++) {
+                writeTweetDetailJson(shard, state.tweets, state.analyses[index.tweetOrder[i]], "    ");
+                if (i + 1 < index.tweetOffsets[id + 1]) shard << ",";
+                shard << "\n";
+            }
+            shard << "  ]\n";
+            shard << "}\n";
+            
+            string content = shard.str();
+            hashes[id] = fnv1aHash(content);
+            fs::path path = root / fileNames[id];
+            auto previous = previousHashes.find(fileNames[id]);
+            if (previous != previousHashes.end() && previous->second == hashes[id] && fileHolds(path, content)) {
+                continue;
+            }
+            rewritten[id] = 1;
+            failed[id] = !writeAtomically(path, content);
+        }
+    };
+    
+    threadCount = max((size_t)1, min(threadCount, senatorCount));
+    vector<thread> workers;
+    for (size_t t = 1; t < threadCount; t++) workers.emplace_back(worker);
+    worker();
+    for (thread& t : workers) t.join();
+    
+    for (size_t id = 0; id < senatorCount; id++) {
+        if (failed[id]) {
+            cerr << "Error: Could not write " << (root / fileNames[id]).string() << endl;
+            return 1;
+        }
+    }
+    
+    // Index: everything the dashboard needs before any senator is opened
+    time_t now = time(0);
+    char timestamp[100];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    
+    ostringstream indexJson;
+    indexJson << "{\n";
+    indexJson << "  \"generatedAt\": \"" << timestamp << "\",\n";
+    indexJson << "  \"senators\": [\n";
+    for (size_t id = 0; id < senatorCount; id++) {
+        const string& name = index.names[id];
+        auto base = state.baseIndex.find(name);
+        auto summary = state.summaryIndex.find(name);
+        
+        indexJson << "    {\n";
+        indexJson << "      \"name\": \"" << escapeJsonString(name) << "\",\n";
+        indexJson << "      \"file\": \"" << escapeJsonString(fileNames[id]) << "\",\n";
+        indexJson << "      \"hash\": \"" << hex << setw(16) << setfill('0') << hashes[id] << dec << setfill(' ') << "\",\n";
+        if (base != state.baseIndex.end() && summary != state.summaryIndex.end()) {
+            writeSenatorStatsJson(indexJson, state.baseStats[base->second],
+                                  state.summaries[summary->second], "      ");
+        }
+        indexJson << "      \"tweetCount\": " << index.tweetOffsets[id + 1] - index.tweetOffsets[id] << "\n";
+        indexJson << "    }";
+        if (id + 1 < senatorCount) indexJson << ",";
+        indexJson << "\n";
+    }
+    indexJson << "  ]\n";
+    indexJson << "}\n";
+    
+    ostringstream manifest;
+    for (size_t id = 0; id < senatorCount; id++) {
+        manifest << hex << setw(16) << setfill('0') << hashes[id] << " " << fileNames[id] << "\n";
+    }
+    
+    if (!writeAtomically(root / "index.json", indexJson.str()) ||
+        !writeAtomically(root / "shards.manifest", manifest.str())) {
+        cerr << "Error: Could not write the shard index in " << directory << endl;
+        return 1;
+    }
+    
+    // Shards of senators that are no longer in the data. Only names of the
+    // form shardFileName() gives, plus ".json", are removed, so an edited
+    // manifest can't point outside the directory.
+    auto isShardName = [](const string& name) {
+        const string extension = ".json";
+        if (name.size() <= extension.size() ||
+            name.compare(name.size() - extension.size(), extension.size(), extension) != 0) {
+            return false;
+        }
+        string slug = name.substr(0, name.size() - extension.size());
+        if (slug.front() == '-' || slug.back() == '-') return false;
+        return all_of(slug.begin(), slug.end(), [](unsigned char c) {
+            return islower(c) || isdigit(c) || c == '-';
+        });
+    };
+    size_t removed = 0;
+    for (const auto& entry : previousHashes) {
+        if (usedNames.count(entry.first) || !isShardName(entry.first)) continue;
+        if (fs::remove(root / entry.first, ec)) removed++;
+    }
+    
+    size_t written = count(rewritten.begin(), rewritten.end(), 1);
+    cout << "Exported " << senatorCount << " senator shards to " << directory << " ("
+         << written << " written, " << senatorCount - written << " unchanged";
+    if (removed > 0) cout << ", " << removed << " removed";
+    cout << ")" << endl;
+    return 0;
+}
+
+// ============================================================================
+// NDJSON EXPORT
+// ============================================================================
+
+void NdjsonSink::endRecord()
+{
+    out << '\n';
+    records++;
+    auto now = chrono::steady_clock::now();
+    if (now - lastFlush >= flushInterval) {
+        out.flush();
+        lastFlush = now;
+    }
+}
+
+void NdjsonSink::writeTweet(const Tweet& tweet, const AdvancedTweetAnalysis& analysis)
+{
+    // formatTweetJson's object with a record type in front
+    out << "{\"type\":\"tweet\"," << formatTweetJson(tweet, analysis).substr(1);
+    endRecord();
+}
+
+void NdjsonSink::writeSenatorSummary(const SenatorStats& base, const AdvancedSenatorSummary& summary)
+{
+    out << "{\"type\":\"senator\",\"name\":\"" << escapeJsonString(summary.name) << "\""
+        << ",\"tweetCount\":" << summary.tweetCount
+        << ",\"totalWords\":" << base.totalWords
+        << fixed << setprecision(2)
+        << ",\"positivePercent\":" << base.positivePercent
+        << ",\"negativePercent\":" << base.negativePercent
+        << ",\"avgBaseSentiment\":" << summary.avgBaseSentiment
+        << ",\"avgAdjustedSentiment\":" << summary.avgAdjustedSentiment
+        << ",\"avgAllCaps\":" << summary.avgAllCaps
+        << ",\"avgExclamations\":" << summary.avgExclamations
+        << ",\"avgStyleScore\":" << summary.avgStyleScore
+        << "}";
+    endRecord();
+}
+
+void NdjsonSink::finish(size_t tweetCount, size_t senatorCount)
+{
+    out << "{\"type\":\"run\",\"tweets\":" << tweetCount << ",\"senators\":" << senatorCount << "}\n";
+    records++;
+    out.flush();
+}
+
+// ============================================================================
+// INVERTED INDEX
+// ============================================================================
+
+// File layout, each section 8-byte aligned:
+//   IndexFileHeader
+//   IndexedDoc[docCount]          scores and senator per tweet
+//   uint64_t[senatorCount]        senator name offsets into strings
+//   IndexedTerm[termCount]        sorted by term, for binary search
+//   strings                       varint length + bytes
+//   postings                      per term: PostingsSkip[skipCount], then
+//                                 blocks of postingsBlockSize postings
+// A posting is varint(doc delta) varint(position count) and that many
+// varint position deltas. Deltas restart at each block (the first posting
+// of a block has delta 0 from the skip entry's firstDoc), so any block can
+// be decoded on its own.
+static const char indexMagic[8] = {'S', 'N', 'T', 'I', 'D', 'X', '1', '\0'};
+static const uint32_t indexVersion = 1;
+static const uint32_t postingsBlockSize = 64;
+
+static void appendVarint(vector<unsigned char>& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static uint64_t readVarint(const unsigned char*& p)
+{
+    uint64_t value = *p & 0x7f;
+    int shift = 7;
+    while (*p++ & 0x80) {
+        value |= (uint64_t)(*p & 0x7f) << shift;
+        shift += 7;
+    }
+    return value;
+}
+
+static void skipVarints(const unsigned char*& p, uint32_t count)
+{
+    while (count > 0) {
+        if (!(*p++ & 0x80)) count--;
+    }
+}
+
+// Stemmed terms with their position among the tweet's words; words that
+// normalize to nothing (pure punctuation) take no position, so a phrase
+// matches across them exactly as it would in the query
+static void indexTerms(const string& text, vector<string>& terms)
+{
+    terms.clear();
+    stringstream ss(text);
+    string rawWord;
+    while (ss >> rawWord) {
+        string word = normalizeWord(rawWord);
+        if (!word.empty()) terms.push_back(word);
+    }
+}
+
+int buildInvertedIndex(const CorpusState& state, const string& path)
+{
+    // Postings are gathered in tweet order, so every list is already sorted
+    unordered_map<string, uint32_t> termIds;
+    vector<string> termNames;
+    vector<vector<uint64_t>> postingsByTerm;    // (doc << 32) | position
+    vector<string> terms;
+    for (uint32_t doc = 0; doc < state.analyses.size(); doc++) {
+        indexTerms(string(state.tweets.text(doc)), terms);
+        for (uint32_t position = 0; position < terms.size(); position++) {
+            auto inserted = termIds.emplace(terms[position], (uint32_t)termNames.size());
+            if (inserted.second) {
+                termNames.push_back(terms[position]);
+                postingsByTerm.emplace_back();
+            }
+            postingsByTerm[inserted.first->second].push_back(((uint64_t)doc << 32) | position);
+        }
+    }
+    vector<uint32_t> sortedTerms(termNames.size());
+    for (uint32_t i = 0; i < sortedTerms.size(); i++) sortedTerms[i] = i;
+    sort(sortedTerms.begin(), sortedTerms.end(), [&](uint32_t a, uint32_t b) {
+        return termNames[a] < termNames[b];
+    });
+    
+    vector<unsigned char> strings;
+    auto appendString = [&](string_view value) {
+        uint64_t offset = strings.size();
+        appendVarint(strings, value.size());
+        strings.insert(strings.end(), value.begin(), value.end());
+        return offset;
+    };
+    
+    vector<IndexedDoc> docs(state.analyses.size());
+    for (size_t doc = 0; doc < docs.size(); doc++) {
+        docs[doc].stringOffset = appendString(state.tweets.tweetId(doc));
+        appendString(state.tweets.text(doc));
+        docs[doc].senatorId = state.senatorIndex.senatorOfTweet[doc];
+        docs[doc].baseScore = state.analyses[doc].baseSentimentScore;
+        docs[doc].adjustedScore = state.analyses[doc].adjustedSentimentScore;
+        docs[doc].reserved = 0;
+    }
+    vector<uint64_t> senators;
+    for (const string& name : state.senatorIndex.names) senators.push_back(appendString(name));
+    
+    vector<IndexedTerm> termTable;
+    vector<unsigned char> postings;
+    vector<unsigned char> blockData;
+    vector<PostingsSkip> skips;
+    size_t postingCount = 0;
+    for (uint32_t id : sortedTerms) {
+        const vector<uint64_t>& entries = postingsByTerm[id];
+        blockData.clear();
+        skips.clear();
+        uint32_t docFreq = 0;
+        uint32_t previousDoc = 0;
+        for (size_t i = 0; i < entries.size(); ) {
+            uint32_t doc = entries[i] >> 32;
+            size_t end = i;
+            while (end < entries.size() && (entries[end] >> 32) == doc) end++;
+            
+            if (docFreq % postingsBlockSize == 0) {
+                skips.push_back({doc, (uint32_t)blockData.size()});
+                previousDoc = doc;
+            }
+            appendVarint(blockData, doc - previousDoc);
+            appendVarint(blockData, end - i);
+            uint32_t previousPosition = 0;
+            for (size_t j = i; j < end; j++) {
+                uint32_t position = (uint32_t)entries[j];
+                appendVarint(blockData, position - previousPosition);
+                previousPosition = position;
+            }
+            previousDoc = doc;
+            docFreq++;
+            i = end;
+        }
+        postingCount += docFreq;
+        
+        while (postings.size() % alignof(PostingsSkip)) postings.push_back(0);
+        IndexedTerm term;
+        term.nameOffset = appendString(termNames[id]);
+        term.postingsOffset = postings.size();
+        term.docFreq = docFreq;
+        term.skipCount = skips.size();
+        termTable.push_back(term);
+        const unsigned char* skipBytes = (const unsigned char*)skips.data();
+        postings.insert(postings.end(), skipBytes, skipBytes + skips.size() * sizeof(PostingsSkip));
+        postings.insert(postings.end(), blockData.begin(), blockData.end());
+        vector<uint64_t>().swap(postingsByTerm[id]);
+    }
+    
+    IndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.version = indexVersion;
+    header.docCount = docs.size();
+    header.termCount = termTable.size();
+    header.senatorCount = senators.size();
+    auto aligned = [](uint64_t offset) { return (offset + 7) & ~(uint64_t)7; };
+    header.docsOffset = aligned(sizeof(header));
+    header.senatorsOffset = aligned(header.docsOffset + docs.size() * sizeof(IndexedDoc));
+    header.termsOffset = aligned(header.senatorsOffset + senators.size() * sizeof(uint64_t));
+    header.stringsOffset = aligned(header.termsOffset + termTable.size() * sizeof(IndexedTerm));
+    header.postingsOffset = aligned(header.stringsOffset + strings.size());
+    header.fileSize = header.postingsOffset + postings.size();
+    
+    vector<unsigned char> file(header.fileSize, 0);
+    memcpy(&file[0], &header, sizeof(header));
+    if (!docs.empty()) memcpy(&file[header.docsOffset], docs.data(), docs.size() * sizeof(IndexedDoc));
+    if (!senators.empty()) memcpy(&file[header.senatorsOffset], senators.data(), senators.size() * sizeof(uint64_t));
+    if (!termTable.empty()) memcpy(&file[header.termsOffset], termTable.data(), termTable.size() * sizeof(IndexedTerm));
+    if (!strings.empty()) memcpy(&file[header.stringsOffset], strings.data(), strings.size());
+    if (!postings.empty()) memcpy(&file[header.postingsOffset], postings.data(), postings.size());
+    
+    string temporary = path + ".tmp";
+    ofstream out(temporary, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Error: Could not create " << temporary << endl;
+        return 1;
+    }
+    out.write((const char*)file.data(), file.size());
+    out.close();
+    if (!out || rename(temporary.c_str(), path.c_str()) != 0) {
+        cerr << "Error: Could not write " << path << endl;
+        return 1;
+    }
+    
+    cout << "Indexed " << docs.size() << " tweets, " << termTable.size() << " terms, "
+         << postingCount << " postings into " << path << " (" << file.size() / 1024 << " KiB, "
+         << fixed << setprecision(1) << (postingCount ? (double)postings.size() / postingCount : 0.0)
+         << " bytes per posting with positions)" << endl;
+    return 0;
+}
+
+InvertedIndex::~InvertedIndex()
+{
+    #ifndef _WIN32
+    if (base != nullptr && fallback.empty()) munmap((void*)base, size);
+    #endif
+}
+
+bool InvertedIndex::open(const string& path)
+{
+    #ifdef _WIN32
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) {
+        cerr << "Error: Could not open " << path << endl;
+        return false;
+    }
+    fallback.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    base = fallback.data();
+    size = fallback.size();
+    #else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "Error: Could not open " << path << endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(IndexFileHeader)) {
+        close(fd);
+        cerr << "Error: " << path << " is not an index file" << endl;
+        return false;
+    }
+    size = info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        cerr << "Error: Could not map " << path << endl;
+        return false;
+    }
+    base = (const unsigned char*)mapped;
+    #endif
+    
+    header = (const IndexFileHeader*)base;
+    if (size < sizeof(IndexFileHeader) || memcmp(header->magic, indexMagic, sizeof(indexMagic)) != 0 ||
+        header->version != indexVersion || header->fileSize != size || header->postingsOffset > size ||
+        header->docsOffset + (uint64_t)header->docCount * sizeof(IndexedDoc) > header->senatorsOffset ||
+        header->termsOffset + (uint64_t)header->termCount * sizeof(IndexedTerm) > header->stringsOffset) {
+        cerr << "Error: " << path << " is not a compatible index file; rebuild it with --build-index" << endl;
+        return false;
+    }
+    return true;
+}
+
+string_view InvertedIndex::stringAt(uint64_t offset) const
+{
+    const unsigned char* p = base + header->stringsOffset + offset;
+    size_t length = readVarint(p);
+    return string_view((const char*)p, length);
+}
+
+string_view InvertedIndex::text(uint32_t id) const
+{
+    string_view tweetIdText = tweetId(id);
+    const unsigned char* p = (const unsigned char*)tweetIdText.data() + tweetIdText.size();
+    size_t length = readVarint(p);
+    return string_view((const char*)p, length);
+}
+
+const IndexedTerm* InvertedIndex::findTerm(const string& term) const
+{
+    const IndexedTerm* terms = (const IndexedTerm*)(base + header->termsOffset);
+    const IndexedTerm* end = terms + header->termCount;
+    const IndexedTerm* found = lower_bound(terms, end, term, [&](const IndexedTerm& entry, const string& key) {
+        return stringAt(entry.nameOffset) < key;
+    });
+    return (found != end && stringAt(found->nameOffset) == term) ? found : nullptr;
+}
+
+PostingsCursor::PostingsCursor(const InvertedIndex& index, const IndexedTerm& term)
+    : skips((const PostingsSkip*)index.postings(term)),
+      docFreq(term.docFreq),
+      skipCount(term.skipCount)
+{
+    data = (const unsigned char*)(skips + skipCount);
+    step();
+}
+
+void PostingsCursor::enterBlock(uint32_t b)
+{
+    block = b;
+    read = b * postingsBlockSize;
+    next = data + skips[b].byteOffset;
+    current = skips[b].firstDoc;
+}
+
+void PostingsCursor::step()
+{
+    if (read == docFreq) {
+        current = UINT32_MAX;
+        return;
+    }
+    if (read % postingsBlockSize == 0) enterBlock(read / postingsBlockSize);
+    current += readVarint(next);
+    positionCount = readVarint(next);
+    positionData = next;
+    skipVarints(next, positionCount);
+    read++;
+}
+
+void PostingsCursor::advance(uint32_t target)
+{
+    if (atEnd() || current >= target) return;
+    
+    // Last block starting at or before target
+    const PostingsSkip* later = upper_bound(skips + block + 1, skips + skipCount, target,
+        [](uint32_t value, const PostingsSkip& skip) { return value < skip.firstDoc; });
+    uint32_t targetBlock = (later - skips) - 1;
+    if (targetBlock > block) {
+        enterBlock(targetBlock);
+        step();
+    }
+    while (!atEnd() && current < target) step();
+}
+
+void PostingsCursor::positions(vector<uint32_t>& out) const
+{
+    out.clear();
+    const unsigned char* p = positionData;
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < positionCount; i++) {
+        position += readVarint(p);
+        out.push_back(position);
+    }
+}
+
+// Parsed search expression. Terms are already stemmed.
+struct SearchNode {
+    enum Kind { Term, Phrase, And, Or, Not } kind = Term;
+    vector<string> terms;
+    vector<SearchNode> children;
+};
+
+// Grammar (AND binds tighter than OR, adjacent terms are ANDed):
+//   or    := and (OR and)*
+//   and   := unary ((AND)? unary)*
+//   unary := NOT unary | '(' or ')' | "phrase" | word
+class SearchParser {
+private:
+    vector<string> tokens;
+    size_t pos = 0;
+    string error;
+
+    bool peek(const string& token) const { return pos < tokens.size() && tokens[pos] == token; }
+    SearchNode parseOr();
+    SearchNode parseAnd();
+    SearchNode parseUnary();
+
+public:
+    explicit SearchParser(const string& query);
+    bool parse(SearchNode& root);
+    const string& errorMessage() const { return error; }
+};
+
+SearchParser::SearchParser(const string& query)
+{
+    for (size_t i = 0; i < query.size(); ) {
+        char c = query[i];
+        if (isspace((unsigned char)c)) {
+            i++;
+        } else if (c == '(' || c == ')') {
+            tokens.push_back(string(1, c));
+            i++;
+        } else if (c == '"') {
+            size_t end = query.find('"', i + 1);
+            if (end == string::npos) end = query.size();
+            tokens.push_back(query.substr(i, end - i + 1));
+            i = end + 1;
+        } else {
+            size_t start = i;
+            while (i < query.size() && !isspace((unsigned char)query[i]) && query[i] != '(' &&
+                   query[i] != ')' && query[i] != '"') i++;
+            tokens.push_back(query.substr(start, i - start));
+        }
+    }
+}
+
+bool SearchParser::parse(SearchNode& root)
+{
+    if (tokens.empty()) {
+        error = "empty query";
+        return false;
+    }
+    root = parseOr();
+    if (error.empty() && pos < tokens.size()) error = "unexpected '" + tokens[pos] + "'";
+    return error.empty();
+}
+
+SearchNode SearchParser::parseOr()
+{
+    SearchNode first = parseAnd();
+    if (!peek("OR")) return first;
+    SearchNode node;
+    node.kind = SearchNode::Or;
+    node.children.push_back(first);
+    while (error.empty() && peek("OR")) {
+        pos++;
+        node.children.push_back(parseAnd());
+    }
+    return node;
+}
+
+SearchNode SearchParser::parseAnd()
+{
+    SearchNode node;
+    node.kind = SearchNode::And;
+    node.children.push_back(parseUnary());
+    while (error.empty() && pos < tokens.size() && !peek("OR") && !peek(")")) {
+        if (peek("AND")) pos++;
+        node.children.push_back(parseUnary());
+    }
+    if (node.children.size() == 1) return node.children[0];
+    return node;
+}
+
+SearchNode SearchParser::parseUnary()
+{
+    SearchNode node;
+    if (pos >= tokens.size()) {
+        error = "query ends early";
+        return node;
+    }
+    string token = tokens[pos++];
+    if (token == "NOT") {
+        node.kind = SearchNode::Not;
+        node.children.push_back(parseUnary());
+        return node;
+    }
+    if (token == "(") {
+        node = parseOr();
+        if (!peek(")")) {
+            if (error.empty()) error = "missing ')'";
+            return node;
+        }
+        pos++;
+        return node;
+    }
+    if (token == ")" || token == "AND" || token == "OR") {
+        error = "unexpected '" + token + "'";
+        return node;
+    }
+    
+    bool quoted = token[0] == '"';
+    if (quoted) token = token.substr(1, token.size() >= 2 && token.back() == '"' ? token.size() - 2 : token.size() - 1);
+    indexTerms(token, node.terms);
+    if (node.terms.empty()) {
+        error = "'" + token + "' has no searchable words";
+        return node;
+    }
+    node.kind = (quoted && node.terms.size() > 1) ? SearchNode::Phrase : SearchNode::Term;
+    if (node.kind == SearchNode::Term && node.terms.size() > 1) {
+        // "rock-n-roll" style tokens split into several words: all required
+        SearchNode all;
+        all.kind = SearchNode::And;
+        for (const string& term : node.terms) {
+            SearchNode child;
+            child.terms.push_back(term);
+            all.children.push_back(child);
+        }
+        return all;
+    }
+    return node;
+}
+
+static vector<uint32_t> evaluateSearch(const InvertedIndex& index, const SearchNode& node);
+
+// Rough result size, used to evaluate the most selective AND operand first
+static size_t searchCost(const InvertedIndex& index, const SearchNode& node)
+{
+    switch (node.kind) {
+    case SearchNode::Term: {
+        const IndexedTerm* term = index.findTerm(node.terms[0]);
+        return term ? term->docFreq : 0;
+    }
+    case SearchNode::Phrase: {
+        size_t cost = SIZE_MAX;
+        for (const string& name : node.terms) {
+            const IndexedTerm* term = index.findTerm(name);
+            cost = min(cost, term ? (size_t)term->docFreq : (size_t)0);
+        }
+        return cost;
+    }
+    case SearchNode::Or: {
+        size_t cost = 0;
+        for (const auto& child : node.children) cost += searchCost(index, child);
+        return cost;
+    }
+    case SearchNode::And: {
+        size_t cost = SIZE_MAX;
+        for (const auto& child : node.children) {
+            if (child.kind != SearchNode::Not) cost = min(cost, searchCost(index, child));
+        }
+        return cost == SIZE_MAX ? index.docCount() : cost;
+    }
+    case SearchNode::Not:
+        return index.docCount();
+    }
+    return index.docCount();
+}
+
+// Leapfrog intersection of every term's postings, then a position check
+static vector<uint32_t> phraseMatches(const InvertedIndex& index, const vector<string>& terms)
+{
+    vector<PostingsCursor> cursors;
+    for (const string& name : terms) {
+        const IndexedTerm* term = index.findTerm(name);
+        if (term == nullptr) return {};
+        cursors.emplace_back(index, *term);
+    }
+    
+    vector<uint32_t> result;
+    vector<uint32_t> first, other;
+    while (!cursors[0].atEnd()) {
+        uint32_t candidate = cursors[0].doc();
+        bool aligned = true;
+        for (size_t i = 1; i < cursors.size(); i++) {
+            cursors[i].advance(candidate);
+            if (cursors[i].atEnd()) return result;
+            if (cursors[i].doc() != candidate) {
+                cursors[0].advance(cursors[i].doc());
+                aligned = false;
+                break;
+            }
+        }
+        if (!aligned) continue;
+        
+        cursors[0].positions(first);
+        for (uint32_t start : first) {
+            bool matched = true;
+            for (size_t i = 1; i < cursors.size() && matched; i++) {
+                cursors[i].positions(other);
+                matched = binary_search(other.begin(), other.end(), start + (uint32_t)i);
+            }
+            if (matched) {
+                result.push_back(candidate);
+                break;
+            }
+        }
+        cursors[0].step();
+    }
+    return result;
+}
+
+static vector<uint32_t> evaluateSearch(const InvertedIndex& index, const SearchNode& node)
+{
+    vector<uint32_t> result;
+    switch (node.kind) {
+    case SearchNode::Term: {
+        const IndexedTerm* term = index.findTerm(node.terms[0]);
+        if (term == nullptr) return result;
+        result.reserve(term->docFreq);
+        for (PostingsCursor cursor(index, *term); !cursor.atEnd(); cursor.step()) result.push_back(cursor.doc());
+        return result;
+    }
+    case SearchNode::Phrase:
+        return phraseMatches(index, node.terms);
+    case SearchNode::Or: {
+        for (const auto& child : node.children) {
+            vector<uint32_t> docs = evaluateSearch(index, child);
+            vector<uint32_t> merged;
+            set_union(result.begin(), result.end(), docs.begin(), docs.end(), back_inserter(merged));
+            result.swap(merged);
+        }
+        return result;
+    }
+    case SearchNode::Not: {
+        vector<uint32_t> excluded = evaluateSearch(index, node.children[0]);
+        size_t e = 0;
+        for (uint32_t doc = 0; doc < index.docCount(); doc++) {
+            while (e < excluded.size() && excluded[e] < doc) e++;
+            if (e == excluded.size() || excluded[e] != doc) result.push_back(doc);
+        }
+        return result;
+    }
+    case SearchNode::And:
+        break;
+    }
+    
+    // AND: start from the most selective operand, then narrow. A term
+    // operand is probed through its skip table rather than decoded whole.
+    vector<const SearchNode*> required, excluded;
+    for (const auto& child : node.children) {
+        if (child.kind == SearchNode::Not) excluded.push_back(&child.children[0]);
+        else required.push_back(&child);
+    }
+    stable_sort(required.begin(), required.end(), [&](const SearchNode* a, const SearchNode* b) {
+        return searchCost(index, *a) < searchCost(index, *b);
+    });
+    
+    if (required.empty()) {
+        for (uint32_t doc = 0; doc < index.docCount(); doc++) result.push_back(doc);
+    } else {
+        result = evaluateSearch(index, *required[0]);
+    }
+    
+    auto narrow = [&](const SearchNode* operand, bool keepMatches) {
+        vector<uint32_t> kept;
+        if (operand->kind == SearchNode::Term) {
+            const IndexedTerm* term = index.findTerm(operand->terms[0]);
+            if (term == nullptr) {
+                if (!keepMatches) kept = result;
+            } else {
+                PostingsCursor cursor(index, *term);
+                for (uint32_t doc : result) {
+                    cursor.advance(doc);
+                    bool matches = !cursor.atEnd() && cursor.doc() == doc;
+                    if (matches == keepMatches) kept.push_back(doc);
+                }
+            }
+        } else {
+            vector<uint32_t> docs = evaluateSearch(index, *operand);
+            if (keepMatches) set_intersection(result.begin(), result.end(), docs.begin(), docs.end(), back_inserter(kept));
+            else set_difference(result.begin(), result.end(), docs.begin(), docs.end(), back_inserter(kept));
+        }
+        result.swap(kept);
+    };
+    for (size_t i = 1; i < required.size() && !result.empty(); i++) narrow(required[i], true);
+    for (size_t i = 0; i < excluded.size() && !result.empty(); i++) narrow(excluded[i], false);
+    return result;
+}
+
+// Request: <query> [score=base|adjusted] [min=X] [max=X] [sort=desc|asc]
+//          [limit=N] [senator=NAME]
+// Options follow the query; senator= takes the rest of the line.
+int runSearch(const string& indexPath, const string& request)
+{
+    InvertedIndex index;
+    if (!index.open(indexPath)) return 1;
+    
+    SearchOptions options;
+    string query;
+    string senatorName;
+    stringstream ss(request);
+    string word;
+    size_t consumed = 0;
+    while (ss >> word) {
+        size_t start = request.find(word, consumed);
+        consumed = start + word.size();
+        if (word.rfind("senator=", 0) == 0) {
+            senatorName = request.substr(start + 8);
+            while (!senatorName.empty() && isspace((unsigned char)senatorName.back())) senatorName.pop_back();
+            break;
+        }
+        if (word == "score=base") options.kind = ScoreKind::Base;
+        else if (word == "score=adjusted") options.kind = ScoreKind::Adjusted;
+        else if (word.rfind("min=", 0) == 0) { options.hasMin = true; options.minScore = atof(word.c_str() + 4); }
+        else if (word.rfind("max=", 0) == 0) { options.hasMax = true; options.maxScore = atof(word.c_str() + 4); }
+        else if (word == "sort=desc") options.order = 1;
+        else if (word == "sort=asc") options.order = -1;
+        else if (word.rfind("limit=", 0) == 0) options.limit = max(1, atoi(word.c_str() + 6));
+        else query += (query.empty() ? "" : " ") + word;
+    }
+    
+    if (!senatorName.empty()) {
+        for (uint32_t id = 0; id < index.senatorCount(); id++) {
+            if (index.senatorName(id) == senatorName) options.senatorId = id;
+        }
+        if (options.senatorId < 0) {
+            cerr << "Error: Unknown senator " << senatorName << endl;
+            return 1;
+        }
+    }
+    
+    SearchParser parser(query);
+    SearchNode root;
+    if (!parser.parse(root)) {
+        cerr << "Error: Bad query: " << parser.errorMessage() << endl;
+        return 1;
+    }
+    
+    auto started = chrono::steady_clock::now();
+    vector<uint32_t> matches = evaluateSearch(index, root);
+    auto scoreOfDoc = [&](uint32_t id) {
+        const IndexedDoc& doc = index.doc(id);
+        return options.kind == ScoreKind::Base ? doc.baseScore : doc.adjustedScore;
+    };
+    vector<uint32_t> results;
+    for (uint32_t id : matches) {
+        if (options.senatorId >= 0 && index.doc(id).senatorId != (uint32_t)options.senatorId) continue;
+        if (options.hasMin && scoreOfDoc(id) < options.minScore) continue;
+        if (options.hasMax && scoreOfDoc(id) > options.maxScore) continue;
+        results.push_back(id);
+    }
+    if (options.order != 0) {
+        stable_sort(results.begin(), results.end(), [&](uint32_t a, uint32_t b) {
+            return options.order > 0 ? scoreOfDoc(a) > scoreOfDoc(b) : scoreOfDoc(a) < scoreOfDoc(b);
+        });
+    }
+    auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started);
+    
+    cout << results.size() << " matching tweets (" << elapsed.count() << " us)\n";
+    for (size_t i = 0; i < min(options.limit, results.size()); i++) {
+        uint32_t id = results[i];
+        const IndexedDoc& doc = index.doc(id);
+        string text(index.text(id));
+        if (text.size() > 70) text = text.substr(0, 70) + "...";
+        cout << left << setw(22) << index.senatorName(doc.senatorId)
+             << right << fixed << setprecision(2)
+             << setw(7) << doc.baseScore << setw(7) << doc.adjustedScore << "  " << text << "\n";
+    }
+    return 0;
+}
 
 // ============================================================================
-// FILE I/O IMPLEMENTATIONS
+// PARTIAL AGGREGATES
 // ============================================================================
 
-vector<vector<string>> read_tweets_csv_file()
+// Partial file layout, fixed-size fields in host byte order (as with the
+// index, partials only merge between machines of the same endianness):
+//   magic[8] version mode shardCount inputSize modelFingerprint rejected
+//   varint(shard numbers) then the numbers as varints
+//   varint(senator count), then per senator:
+//     name, four totals, six sums, two lexicon extremes, two offsets and
+//     two advanced extremes
+// Strings are varint length + bytes.
+static const char partialMagic[8] = {'S', 'N', 'T', 'P', 'R', 'T', '1', '\0'};
+static const uint32_t partialVersion = 3;
+
+// Serialized in this order; adding a field to AdvancedTweetAnalysis means
+// adding it here and bumping partialVersion
+static int AdvancedTweetAnalysis::* const analysisCountFields[] = {
+    &AdvancedTweetAnalysis::totalWords, &AdvancedTweetAnalysis::posWordCount,
+    &AdvancedTweetAnalysis::negWordCount, &AdvancedTweetAnalysis::neutralWordCount,
+    &AdvancedTweetAnalysis::negationHits, &AdvancedTweetAnalysis::intensifierHits,
+    &AdvancedTweetAnalysis::downtonerHits, &AdvancedTweetAnalysis::exclamationCount,
+    &AdvancedTweetAnalysis::questionCount, &AdvancedTweetAnalysis::allCapsWordCount,
+    &AdvancedTweetAnalysis::emojiPositiveCount, &AdvancedTweetAnalysis::emojiNegativeCount,
+    &AdvancedTweetAnalysis::slangPositiveCount, &AdvancedTweetAnalysis::slangNegativeCount,
+    &AdvancedTweetAnalysis::ngramPositiveHits, &AdvancedTweetAnalysis::ngramNegativeHits
+};
+
+static void appendRaw(vector<unsigned char>& out, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+static void appendText(vector<unsigned char>& out, const string& value)
+{
+    appendVarint(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+// Bounds-checked reads over a loaded partial file. A read past the end
+// sets failed and yields zeros, so callers check once at the end.
+struct PartialReader {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool failed = false;
+
+    void raw(void* data, size_t size) {
+        if (failed || (size_t)(end - p) < size) {
+            failed = true;
+            memset(data, 0, size);
+            return;
+        }
+        memcpy(data, p, size);
+        p += size;
+    }
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p == end) break;
+            unsigned char byte = *p++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        failed = true;
+        return 0;
+    }
+    string text() {
+        uint64_t length = varint();
+        if (failed || (uint64_t)(end - p) < length) {
+            failed = true;
+            return string();
+        }
+        string value((const char*)p, length);
+        p += length;
+        return value;
+    }
+};
+
+static void appendAdvancedExtreme(vector<unsigned char>& out, const AdvancedExtreme& extreme)
+{
+    const AdvancedTweetAnalysis& analysis = extreme.analysis;
+    appendText(out, extreme.tweet.tweetId);
+    appendText(out, extreme.tweet.senatorName);
+    appendText(out, extreme.tweet.datetime);
+    appendText(out, extreme.tweet.text);
+    appendRaw(out, &analysis.createdAt, sizeof(analysis.createdAt));
+    for (auto field : analysisCountFields) appendRaw(out, &(analysis.*field), sizeof(int));
+    appendRaw(out, &analysis.baseSentimentScore, sizeof(double));
+    appendRaw(out, &analysis.adjustedSentimentScore, sizeof(double));
+}
+
+static AdvancedExtreme readAdvancedExtreme(PartialReader& in)
+{
+    AdvancedExtreme extreme;
+    AdvancedTweetAnalysis& analysis = extreme.analysis;
+    extreme.tweet.tweetId = in.text();
+    extreme.tweet.senatorName = in.text();
+    extreme.tweet.datetime = in.text();
+    extreme.tweet.text = in.text();
+    in.raw(&analysis.createdAt, sizeof(analysis.createdAt));
+    for (auto field : analysisCountFields) in.raw(&(analysis.*field), sizeof(int));
+    in.raw(&analysis.baseSentimentScore, sizeof(double));
+    in.raw(&analysis.adjustedSentimentScore, sizeof(double));
+    extreme.tweet.createdAt = analysis.createdAt;
+    return extreme;
+}
+
+static void appendLexiconExtreme(vector<unsigned char>& out, const LexiconExtreme& extreme)
+{
+    appendRaw(out, &extreme.offset, sizeof(extreme.offset));
+    int counts[4] = {extreme.positiveCount, extreme.negativeCount, extreme.totalWords, extreme.rawScore};
+    appendRaw(out, counts, sizeof(counts));
+    appendText(out, extreme.text);
+}
+
+static LexiconExtreme readLexiconExtreme(PartialReader& in)
+{
+    LexiconExtreme extreme;
+    in.raw(&extreme.offset, sizeof(extreme.offset));
+    int counts[4];
+    in.raw(counts, sizeof(counts));
+    extreme.positiveCount = counts[0];
+    extreme.negativeCount = counts[1];
+    extreme.totalWords = counts[2];
+    extreme.rawScore = counts[3];
+    extreme.text = in.text();
+    return extreme;
+}
+
+// Strictly better score, or the same score from an earlier record
+static bool beats(double score, uint64_t offset, double currentScore, uint64_t currentOffset, bool higher)
 {
-    vector<vector<string>> tweets;
-    fstream fin;
-    fin.open("tweets.csv", ios::in);
-    if (!fin.is_open()) {
+    if (currentOffset == UINT64_MAX) return true;
+    if (score != currentScore) return higher ? score > currentScore : score < currentScore;
+    return offset < currentOffset;
+}
+
+bool ShardReader::open(ShardMode shardMode, uint32_t shardNumber, uint32_t shards, uint64_t resumeOffset)
+{
+    mode = shardMode;
+    shard = shardNumber;
+    shardCount = shards;
+    if (!file.open("tweets.csv")) {
         cerr << "Error: Could not open tweets.csv" << endl;
-        return tweets;
+        return false;
     }
+    uint64_t inputSize = file.size();
     
-    string line;
-    vector<string> row;
-    getline(fin, line); // Skip header
+    size_t line;
+    string_view raw;
+    RecordScanner header(file.data(), inputSize);
+    header.next(row, line, raw);
+    uint64_t dataStart = header.offset();
+    uint64_t begin = dataStart;
+    uint64_t end = inputSize;
+    if (mode == ShardMode::ByteRange) {
+        uint64_t span = inputSize - dataStart;
+        begin = dataStart + span * shard / shardCount;
+        end = dataStart + span * (shard + 1) / shardCount;
+    }
     
-    while (getline(fin, line))
-    {
-        row.clear();
-        stringstream s(line);
-        string word;
-        while (getline(s, word, '|')) {
-            row.push_back(word);
+    // A record that starts before begin belongs to the previous shard,
+    // even when its quoted text runs past begin
+    uint64_t start = resumeOffset > 0 ? resumeOffset : dataStart;
+    lineBase = count(file.data(), file.data() + start, '\n');
+    scanner = make_unique<RecordScanner>(file.data(), inputSize, start, end);
+    if (resumeOffset == 0 && begin > dataStart) scanner->skipTo(begin);
+    return true;
+}
+
+bool ShardReader::next(Tweet& tweet, uint64_t& recordOffset, vector<RejectedRecord>& rejects)
+{
+    size_t line;
+    string_view raw;
+    while (scanner->next(row, line, raw)) {
+        string reason = tweetRowProblem(row);
+        if (!reason.empty()) {
+            if (mode == ShardMode::ByteRange || shard == 0) rejects.push_back({lineBase + line, reason, string(raw)});
+            continue;
         }
-        if(row.size() == 5)
-            tweets.push_back(row);
+        if (mode == ShardMode::SenatorHash && fnv1aHash(row[3]) % shardCount != shard) continue;
+        recordOffset = raw.data() - file.data();
+        tweet = tweetFromRow(row);
+        return true;
+    }
+    return false;
+}
+
+void addTweetToPartial(
+    PartialSenatorAggregate& partial,
+    uint64_t offset,
+    const Tweet& tweet,
+    const TweetSentiment& lexiconScore,
+    const AdvancedTweetAnalysis& analysis)
+{
+    partial.tweets++;
+    partial.words += lexiconScore.totalWords;
+    partial.positiveWords += lexiconScore.positiveCount;
+    partial.negativeWords += lexiconScore.negativeCount;
+    
+    // Same per-tweet values the group-by engine averages in a single run
+    double totalWords = analysis.totalWords;
+    partial.sums[0] += analysis.baseSentimentScore;
+    partial.sums[1] += analysis.adjustedSentimentScore;
+    partial.sums[2] += totalWords > 0 ? 100.0 * analysis.posWordCount / totalWords : 0.0;
+    partial.sums[3] += totalWords > 0 ? 100.0 * analysis.negWordCount / totalWords : 0.0;
+    partial.sums[4] += analysis.allCapsWordCount;
+    partial.sums[5] += analysis.exclamationCount;
+    
+    LexiconExtreme extreme;
+    extreme.offset = offset;
+    extreme.positiveCount = lexiconScore.positiveCount;
+    extreme.negativeCount = lexiconScore.negativeCount;
+    extreme.totalWords = lexiconScore.totalWords;
+    extreme.rawScore = lexiconScore.rawScore;
+    if (beats(extreme.rawScore, offset, partial.lexiconMostPositive.rawScore, partial.lexiconMostPositive.offset, true)) {
+        extreme.text = lexiconScore.text;
+        partial.lexiconMostPositive = extreme;
+    }
+    if (beats(extreme.rawScore, offset, partial.lexiconMostNegative.rawScore, partial.lexiconMostNegative.offset, false)) {
+        extreme.text = lexiconScore.text;
+        partial.lexiconMostNegative = extreme;
     }
     
-    fin.close();
-    return tweets;
+    double score = analysis.adjustedSentimentScore;
+    if (beats(score, offset, partial.mostPositiveTweet.analysis.adjustedSentimentScore, partial.mostPositiveOffset, true)) {
+        partial.mostPositiveTweet = {tweet, analysis};
+        partial.mostPositiveOffset = offset;
+    }
+    if (beats(score, offset, partial.mostNegativeTweet.analysis.adjustedSentimentScore, partial.mostNegativeOffset, false)) {
+        partial.mostNegativeTweet = {tweet, analysis};
+        partial.mostNegativeOffset = offset;
+    }
 }
 
-vector<string> readEmotionFile(string path)
+// Refuses partials from a different split or input, and shards that are
+// already covered, since merging them would count tweets twice
+bool mergePartialAggregates(PartialAggregate& into, const PartialAggregate& from, string& error)
 {
-    vector<string> emotionWords;
-    fstream newfile;
-    newfile.open(path, ios::in);
+    if (from.mode != into.mode || from.shardCount != into.shardCount || from.inputSize != into.inputSize) {
+        error = "partials come from different splits or different versions of tweets.csv";
+        return false;
+    }
+    if (from.modelFingerprint != into.modelFingerprint) {
+        error = "partials were scored with different scoring models";
+        return false;
+    }
+    vector<uint32_t> shards;
+    set_union(into.shards.begin(), into.shards.end(), from.shards.begin(), from.shards.end(), back_inserter(shards));
+    if (shards.size() != into.shards.size() + from.shards.size()) {
+        error = "a shard appears in more than one partial";
+        return false;
+    }
+    into.shards = move(shards);
+    into.rejected += from.rejected;
     
-    if(newfile.is_open()) {
-        string line;
-        while(getline(newfile, line)) {
-            if (!line.empty())
-                emotionWords.push_back(line);
+    for (const auto& entry : from.senators) {
+        const PartialSenatorAggregate& other = entry.second;
+        auto inserted = into.senators.emplace(entry.first, other);
+        if (inserted.second) continue;
+        PartialSenatorAggregate& mine = inserted.first->second;
+        mine.tweets += other.tweets;
+        mine.words += other.words;
+        mine.positiveWords += other.positiveWords;
+        mine.negativeWords += other.negativeWords;
+        for (int i = 0; i < 6; i++) mine.sums[i] += other.sums[i];
+        const LexiconExtreme& positive = other.lexiconMostPositive;
+        const LexiconExtreme& negative = other.lexiconMostNegative;
+        if (beats(positive.rawScore, positive.offset, mine.lexiconMostPositive.rawScore, mine.lexiconMostPositive.offset, true))
+            mine.lexiconMostPositive = positive;
+        if (beats(negative.rawScore, negative.offset, mine.lexiconMostNegative.rawScore, mine.lexiconMostNegative.offset, false))
+            mine.lexiconMostNegative = negative;
+        if (beats(other.mostPositiveTweet.analysis.adjustedSentimentScore, other.mostPositiveOffset,
+                  mine.mostPositiveTweet.analysis.adjustedSentimentScore, mine.mostPositiveOffset, true)) {
+            mine.mostPositiveTweet = other.mostPositiveTweet;
+            mine.mostPositiveOffset = other.mostPositiveOffset;
+        }
+        if (beats(other.mostNegativeTweet.analysis.adjustedSentimentScore, other.mostNegativeOffset,
+                  mine.mostNegativeTweet.analysis.adjustedSentimentScore, mine.mostNegativeOffset, false)) {
+            mine.mostNegativeTweet = other.mostNegativeTweet;
+            mine.mostNegativeOffset = other.mostNegativeOffset;
         }
-        newfile.close();
     }
-    return emotionWords;
+    return true;
 }
 
-// ============================================================================
-// DATA CONVERSION
-// ============================================================================
+static void encodePartialAggregate(const PartialAggregate& partial, vector<unsigned char>& file)
+{
+    appendRaw(file, partialMagic, sizeof(partialMagic));
+    appendRaw(file, &partialVersion, sizeof(partialVersion));
+    appendRaw(file, &partial.mode, sizeof(partial.mode));
+    appendRaw(file, &partial.shardCount, sizeof(partial.shardCount));
+    appendRaw(file, &partial.inputSize, sizeof(partial.inputSize));
+    appendRaw(file, &partial.modelFingerprint, sizeof(partial.modelFingerprint));
+    appendRaw(file, &partial.rejected, sizeof(partial.rejected));
+    appendVarint(file, partial.shards.size());
+    for (uint32_t shard : partial.shards) appendVarint(file, shard);
+    
+    appendVarint(file, partial.senators.size());
+    for (const auto& entry : partial.senators) {
+        const PartialSenatorAggregate& senator = entry.second;
+        appendText(file, senator.name);
+        long long totals[4] = {senator.tweets, senator.words, senator.positiveWords, senator.negativeWords};
+        appendRaw(file, totals, sizeof(totals));
+        appendRaw(file, senator.sums, sizeof(senator.sums));
+        appendLexiconExtreme(file, senator.lexiconMostPositive);
+        appendLexiconExtreme(file, senator.lexiconMostNegative);
+        appendRaw(file, &senator.mostPositiveOffset, sizeof(uint64_t));
+        appendRaw(file, &senator.mostNegativeOffset, sizeof(uint64_t));
+        appendAdvancedExtreme(file, senator.mostPositiveTweet);
+        appendAdvancedExtreme(file, senator.mostNegativeTweet);
+    }
+}
 
-vector<Tweet> convertToTweets(const vector<vector<string>>& rawData)
+// Returns false without a message on a bad magic or version, so callers
+// can name the file kind they expected
+static bool decodePartialAggregate(PartialReader& reader, PartialAggregate& partial)
 {
-    vector<Tweet> tweets;
-    for (const auto& row : rawData) {
-        if (row.size() == 5) {
-            Tweet t;
-            t.tweetId = row[0];
-            t.userId = row[1];
-            t.datetime = row[2];
-            t.senatorName = row[3];
-            t.text = row[4];
-            tweets.push_back(t);
-        }
+    partial = PartialAggregate();
+    char magic[8];
+    uint32_t version = 0;
+    reader.raw(magic, sizeof(magic));
+    reader.raw(&version, sizeof(version));
+    if (reader.failed || memcmp(magic, partialMagic, sizeof(magic)) != 0 || version != partialVersion) {
+        return false;
     }
-    return tweets;
+    reader.raw(&partial.mode, sizeof(partial.mode));
+    reader.raw(&partial.shardCount, sizeof(partial.shardCount));
+    reader.raw(&partial.inputSize, sizeof(partial.inputSize));
+    reader.raw(&partial.modelFingerprint, sizeof(partial.modelFingerprint));
+    reader.raw(&partial.rejected, sizeof(partial.rejected));
+    uint64_t shardTotal = reader.varint();
+    for (uint64_t i = 0; i < shardTotal && !reader.failed; i++) partial.shards.push_back(reader.varint());
+    
+    uint64_t senatorTotal = reader.varint();
+    for (uint64_t i = 0; i < senatorTotal && !reader.failed; i++) {
+        PartialSenatorAggregate senator;
+        senator.name = reader.text();
+        long long totals[4];
+        reader.raw(totals, sizeof(totals));
+        senator.tweets = totals[0];
+        senator.words = totals[1];
+        senator.positiveWords = totals[2];
+        senator.negativeWords = totals[3];
+        reader.raw(senator.sums, sizeof(senator.sums));
+        senator.lexiconMostPositive = readLexiconExtreme(reader);
+        senator.lexiconMostNegative = readLexiconExtreme(reader);
+        reader.raw(&senator.mostPositiveOffset, sizeof(uint64_t));
+        reader.raw(&senator.mostNegativeOffset, sizeof(uint64_t));
+        senator.mostPositiveTweet = readAdvancedExtreme(reader);
+        senator.mostNegativeTweet = readAdvancedExtreme(reader);
+        partial.senators[senator.name] = move(senator);
+    }
+    return true;
 }
 
-vector<string> getUniqueSenators(const vector<Tweet>& tweets)
+static bool readWholeFile(const string& path, vector<unsigned char>& data)
 {
-    unordered_set<string> senatorSet;
-    for (const auto& tweet : tweets) {
-        senatorSet.insert(tweet.senatorName);
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) {
+        cerr << "Error: Could not open " << path << endl;
+        return false;
     }
-    return vector<string>(senatorSet.begin(), senatorSet.end());
+    data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
 }
 
-// ============================================================================
-// WORD PROCESSING
-// ============================================================================
+// Writes a temporary file, flushes it to disk and renames it over path,
+// so readers and crashes see either the old contents or the new ones
+bool writeFileAtomically(const string& path, const vector<unsigned char>& data)
+{
+    string temporary = path + ".tmp";
+    #ifdef _WIN32
+    ofstream out(temporary, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Error: Could not create " << temporary << endl;
+        return false;
+    }
+    out.write((const char*)data.data(), data.size());
+    out.close();
+    bool written = (bool)out;
+    #else
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cerr << "Error: Could not create " << temporary << endl;
+        return false;
+    }
+    bool written = true;
+    for (size_t done = 0; written && done < data.size(); ) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        written = n > 0;
+        if (written) done += n;
+    }
+    written = written && fsync(fd) == 0;
+    close(fd);
+    #endif
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        cerr << "Error: Could not write " << path << endl;
+        return false;
+    }
+    return true;
+}
 
-string normalizeWord(const string& raw)
+bool writePartialAggregate(const PartialAggregate& partial, const string& path)
+{
+    vector<unsigned char> file;
+    encodePartialAggregate(partial, file);
+    return writeFileAtomically(path, file);
+}
+
+bool readPartialAggregate(const string& path, PartialAggregate& partial)
+{
+    vector<unsigned char> file;
+    if (!readWholeFile(path, file)) return false;
+    PartialReader reader{file.data(), file.data() + file.size()};
+    if (!decodePartialAggregate(reader, partial)) {
+        cerr << "Error: " << path << " is not a compatible partial file" << endl;
+        return false;
+    }
+    if (reader.failed || reader.p != reader.end) {
+        cerr << "Error: " << path << " is truncated or corrupt" << endl;
+        return false;
+    }
+    return true;
+}
+
+// Checkpoint layout: magic[8] version resumeOffset records, then the
+// partial aggregates in partial file format, then varint(reject count) and
+// per reject varint(line), reason and record
+static const char checkpointMagic[8] = {'S', 'N', 'T', 'C', 'K', 'P', '1', '\0'};
+static const uint32_t checkpointVersion = 2;
+
+bool writeRunCheckpoint(const RunCheckpoint& checkpoint, const string& path)
+{
+    vector<unsigned char> file;
+    appendRaw(file, checkpointMagic, sizeof(checkpointMagic));
+    appendRaw(file, &checkpointVersion, sizeof(checkpointVersion));
+    appendRaw(file, &checkpoint.resumeOffset, sizeof(checkpoint.resumeOffset));
+    appendRaw(file, &checkpoint.records, sizeof(checkpoint.records));
+    encodePartialAggregate(checkpoint.partial, file);
+    appendVarint(file, checkpoint.rejects.size());
+    for (const RejectedRecord& reject : checkpoint.rejects) {
+        appendVarint(file, reject.line);
+        appendText(file, reject.reason);
+        appendText(file, reject.text);
+    }
+    return writeFileAtomically(path, file);
+}
+
+bool readRunCheckpoint(const string& path, RunCheckpoint& checkpoint)
+{
+    vector<unsigned char> file;
+    if (!readWholeFile(path, file)) return false;
+    PartialReader reader{file.data(), file.data() + file.size()};
+    char magic[8];
+    uint32_t version = 0;
+    reader.raw(magic, sizeof(magic));
+    reader.raw(&version, sizeof(version));
+    reader.raw(&checkpoint.resumeOffset, sizeof(checkpoint.resumeOffset));
+    reader.raw(&checkpoint.records, sizeof(checkpoint.records));
+    if (reader.failed || memcmp(magic, checkpointMagic, sizeof(magic)) != 0 || version != checkpointVersion ||
+        !decodePartialAggregate(reader, checkpoint.partial)) {
+        cerr << "Error: " << path << " is not a compatible checkpoint file" << endl;
+        return false;
+    }
+    uint64_t rejectTotal = reader.varint();
+    checkpoint.rejects.clear();
+    for (uint64_t i = 0; i < rejectTotal && !reader.failed; i++) {
+        RejectedRecord reject;
+        reject.line = reader.varint();
+        reject.reason = reader.text();
+        reject.text = reader.text();
+        checkpoint.rejects.push_back(move(reject));
+    }
+    if (reader.failed || reader.p != reader.end) {
+        cerr << "Error: " << path << " is truncated or corrupt" << endl;
+        return false;
+    }
+    return true;
+}
+
+static bool isJsonPath(const string& path)
+{
+    return path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+}
+
+// Same per-senator baseStats and advancedSummary blocks as analysis.json,
+// with both kinds of extremes in place of the tweet list
+bool writeMergedAnalysisJson(const PartialAggregate& partial, const string& path)
 {
-    if (raw.empty()) return "";
+    ofstream out(path);
+    if (!out.is_open()) {
+        cerr << "Error: Could not create " << path << endl;
+        return false;
+    }
     
-    // Find first and last alphanumeric character
-    int start = 0, end = raw.length() - 1;
+    time_t now = time(0);
+    char timestamp[100];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
     
-    while (start <= end && !isalnum(raw[start])) start++;
-    while (end >= start && !isalnum(raw[end])) end--;
+    out << "{\n";
+    out << "  \"generatedAt\": \"" << timestamp << "\",\n";
+    out << "  \"shards\": {\"mode\": \"" << (partial.mode == ShardMode::ByteRange ? "bytes" : "senators")
+        << "\", \"count\": " << partial.shardCount << ", \"merged\": " << partial.shards.size() << "},\n";
+    out << "  \"senators\": [\n";
     
-    if (start > end) return "";
+    auto lexiconJson = [](const LexiconExtreme& extreme) {
+        return "{\"text\": \"" + escapeJsonString(extreme.text) + "\", \"positiveWords\": " +
+               to_string(extreme.positiveCount) + ", \"negativeWords\": " + to_string(extreme.negativeCount) +
+               ", \"totalWords\": " + to_string(extreme.totalWords) + ", \"rawScore\": " +
+               to_string(extreme.rawScore) + "}";
+    };
     
-    // Extract word and convert to lowercase
-    string word = raw.substr(start, end - start + 1);
-    transform(word.begin(), word.end(), word.begin(), ::tolower);
+    size_t written = 0;
+    for (const auto& entry : partial.senators) {
+        const PartialSenatorAggregate& senator = entry.second;
+        SenatorStats base;
+        base.name = senator.name;
+        base.totalTweets = senator.tweets;
+        base.totalWords = senator.words;
+        base.totalPositiveWords = senator.positiveWords;
+        base.totalNegativeWords = senator.negativeWords;
+        if (base.totalWords > 0) {
+            base.positivePercent = 100.0 * base.totalPositiveWords / base.totalWords;
+            base.negativePercent = 100.0 * base.totalNegativeWords / base.totalWords;
+        }
+        AdvancedSenatorSummary summary;
+        summary.name = senator.name;
+        summary.tweetCount = senator.tweets;
+        summary.avgBaseSentiment = senator.sums[0] / senator.tweets;
+        summary.avgAdjustedSentiment = senator.sums[1] / senator.tweets;
+        summary.avgPosPercent = senator.sums[2] / senator.tweets;
+        summary.avgNegPercent = senator.sums[3] / senator.tweets;
+        summary.avgAllCaps = senator.sums[4] / senator.tweets;
+        summary.avgExclamations = senator.sums[5] / senator.tweets;
+        summary.avgStyleScore = summary.avgExclamations * 2.0 + summary.avgAllCaps * 1.5;
+        
+        out << "    {\n";
+        out << "      \"name\": \"" << escapeJsonString(senator.name) << "\",\n";
+        writeSenatorStatsJson(out, base, summary, "      ");
+        out << "      \"mostPositiveTweet\": " << formatTweetJson(senator.mostPositiveTweet.tweet, senator.mostPositiveTweet.analysis) << ",\n";
+        out << "      \"mostNegativeTweet\": " << formatTweetJson(senator.mostNegativeTweet.tweet, senator.mostNegativeTweet.analysis) << ",\n";
+        out << "      \"lexiconMostPositive\": " << lexiconJson(senator.lexiconMostPositive) << ",\n";
+        out << "      \"lexiconMostNegative\": " << lexiconJson(senator.lexiconMostNegative) << "\n";
+        out << "    }";
+        if (++written < partial.senators.size()) out << ",";
+        out << "\n";
+    }
     
-    // Stem the word
-    return stemString(word);
+    out << "  ]\n";
+    out << "}\n";
+    out.close();
+    if (!out) {
+        cerr << "Error: Could not write " << path << endl;
+        return false;
+    }
+    return true;
 }
 
-bool isAllCaps(const string& word)
+// Scores one shard of tweets.csv and writes its partial aggregates (or
+// the per-senator JSON when path ends in .json). Each process scores on
+// one thread; fan-out is by running more processes. With a checkpoint
+// path, progress is saved periodically and a rerun with the same
+// arguments resumes from the last checkpoint. Records are aggregated in
+// file order either way, so the results are bit-identical.
+int runPartial(
+    const string& path,
+    ShardMode mode,
+    uint32_t shard,
+    uint32_t shardCount,
+    const CheckpointPolicy& checkpoint)
 {
-    if (word.length() <= 1) return false;
+    RunCheckpoint progress;
+    PartialAggregate& partial = progress.partial;
+    partial.mode = mode;
+    partial.shardCount = shardCount;
+    partial.shards.push_back(shard);
     
-    int alphaCount = 0;
-    for (char c : word) {
-        if (isalpha(c)) {
-            alphaCount++;
-            if (!isupper(c)) return false;
+    bool resuming = !checkpoint.path.empty() && filesystem::exists(checkpoint.path);
+    if (resuming) {
+        if (!readRunCheckpoint(checkpoint.path, progress)) return 1;
+        if (partial.mode != mode || partial.shardCount != shardCount ||
+            partial.shards != vector<uint32_t>{shard}) {
+            cerr << "Error: " << checkpoint.path << " belongs to a different shard; "
+                 << "delete it to start over" << endl;
+            return 1;
+        }
+    }
+    
+    ShardReader reader;
+    if (!reader.open(mode, shard, shardCount, progress.resumeOffset)) return 1;
+    if (resuming && reader.size() != partial.inputSize) {
+        cerr << "Error: tweets.csv changed since " << checkpoint.path << " was written; "
+             << "delete it to start over" << endl;
+        return 1;
+    }
+    partial.inputSize = reader.size();
+    
+    vector<string> posWords = readEmotionFile("positive-words.txt");
+    vector<string> negWords = readEmotionFile("negative-words.txt");
+    unordered_set<string> positiveLexicon = buildLexiconSet(posWords);
+    unordered_set<string> negativeLexicon = buildLexiconSet(negWords);
+    shared_ptr<const ScoringModel> model = loadScoringModel(posWords, negWords);
+    if (resuming && partial.modelFingerprint != model->fingerprint) {
+        cerr << "Error: the scoring model changed since " << checkpoint.path << " was written; "
+             << "delete it to start over" << endl;
+        return 1;
+    }
+    partial.modelFingerprint = model->fingerprint;
+    if (resuming) {
+        cout << "Resuming shard " << shard << "/" << shardCount << " at byte " << progress.resumeOffset
+             << " with " << progress.records << " records already aggregated" << endl;
+    }
+    
+    auto runStart = chrono::steady_clock::now();
+    auto lastCheckpoint = runStart;
+    chrono::duration<double> checkpointTime(0);
+    uint64_t sinceCheckpoint = 0;
+    size_t checkpointsWritten = 0;
+    
+    Tweet tweet;
+    uint64_t offset = 0;
+    while (reader.next(tweet, offset, progress.rejects)) {
+        TweetSentiment lexiconScore = analyzeTweetLexiconOnly(tweet.text, positiveLexicon, negativeLexicon);
+        AdvancedTweetAnalysis analysis = analyzeTweetAdvanced(tweet, *model);
+        PartialSenatorAggregate& senator = partial.senators[tweet.senatorName];
+        senator.name = tweet.senatorName;
+        addTweetToPartial(senator, offset, tweet, lexiconScore, analysis);
+        progress.records++;
+        
+        if (checkpoint.path.empty()) continue;
+        bool due = ++sinceCheckpoint >= checkpoint.everyRecords;
+        if (!due && sinceCheckpoint % 256 != 0) continue;   // read the clock every 256 records
+        auto now = chrono::steady_clock::now();
+        if (!due && chrono::duration<double>(now - lastCheckpoint).count() < checkpoint.everySeconds) continue;
+        progress.resumeOffset = reader.position();
+        if (!writeRunCheckpoint(progress, checkpoint.path)) return 1;
+        lastCheckpoint = chrono::steady_clock::now();
+        checkpointTime += lastCheckpoint - now;
+        checkpointsWritten++;
+        sinceCheckpoint = 0;
+    }
+    
+    partial.rejected = progress.rejects.size();
+    if (!(isJsonPath(path) ? writeMergedAnalysisJson(partial, path) : writePartialAggregate(partial, path))) return 1;
+    reportRejectedRecords(progress.rejects, path + ".rejects.tsv");
+    if (!checkpoint.path.empty()) remove(checkpoint.path.c_str());
+    
+    cout << "Shard " << shard << "/" << shardCount << ": " << progress.records << " tweets, "
+         << partial.senators.size() << " senators -> " << path << endl;
+    if (checkpointsWritten > 0) {
+        double total = chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+        cout << checkpointsWritten << " checkpoints took " << fixed << setprecision(1)
+             << checkpointTime.count() * 1000 << " ms (" << setprecision(2)
+             << (total > 0 ? 100.0 * checkpointTime.count() / total : 0.0) << "% of the run)" << endl;
+    }
+    return 0;
+}
+
+// Merges partials into a combined partial (so merges can form a tree), or
+// into the final per-senator JSON when the output name ends in .json
+int runMergePartials(const string& outputPath, const vector<string>& inputPaths)
+{
+    PartialAggregate merged;
+    for (size_t i = 0; i < inputPaths.size(); i++) {
+        PartialAggregate partial;
+        if (!readPartialAggregate(inputPaths[i], partial)) return 1;
+        if (i == 0) {
+            merged = move(partial);
+            continue;
+        }
+        string error;
+        if (!mergePartialAggregates(merged, partial, error)) {
+            cerr << "Error: Cannot merge " << inputPaths[i] << ": " << error << endl;
+            return 1;
+        }
+    }
+    
+    long long tweets = 0;
+    for (const auto& entry : merged.senators) tweets += entry.second.tweets;
+    bool json = isJsonPath(outputPath);
+    if (merged.rejected > 0) {
+        cerr << "Warning: The shards skipped " << merged.rejected << " records in tweets.csv "
+             << "(listed in each shard's .rejects.tsv)" << endl;
+    }
+    if (json && merged.shards.size() < merged.shardCount) {
+        cerr << "Warning: only " << merged.shards.size() << " of " << merged.shardCount
+             << " shards merged; results cover part of the input" << endl;
+    }
+    
+    if (json ? !writeMergedAnalysisJson(merged, outputPath) : !writePartialAggregate(merged, outputPath)) return 1;
+    cout << "Merged " << inputPaths.size() << " partials (" << merged.shards.size() << "/" << merged.shardCount
+         << " shards, " << tweets << " tweets, " << merged.senators.size() << " senators) into "
+         << outputPath << endl;
+    return 0;
+}
+
+// ============================================================================
+// QUERY DAEMON
+// ============================================================================
+
+// Scores with model, or with the model from scoring.conf if it is null
+CorpusState loadCorpusState(shared_ptr<const ScoringModel> model)
+{
+    CorpusState state;
+
+    state.tweets = read_tweets_csv_file();
+
+    vector<string> posWords = readEmotionFile("positive-words.txt");
+    vector<string> negWords = readEmotionFile("negative-words.txt");
+    unordered_set<string> positiveLexicon = buildLexiconSet(posWords);
+    unordered_set<string> negativeLexicon = buildLexiconSet(negWords);
+
+    state.senatorIndex = buildSenatorIndex(state.tweets, positiveLexicon, negativeLexicon);
+    state.baseStats = computeBaseSenatorStats(state.senatorIndex);
+    state.talkStats = computeTalkStats(state.senatorIndex);
+
+    state.model = model ? model : loadScoringModel(posWords, negWords);
+    state.analyses = analyzeAllTweetsAdvanced(state.tweets, *state.model);
+    state.summaries = summarizeAdvancedBySenator(state.tweets, state.analyses);
+
+    size_t undated = 0;
+    for (const auto& analysis : state.analyses) undated += analysis.createdAt == invalidCreatedAt;
+    if (undated > 0) {
+        cerr << "Warning: " << undated << " tweets have no valid created_at "
+             << "(a real date in 2000-2099) and are left out of trends" << endl;
+    }
+    for (TrendBucket bucket : {TrendBucket::Day, TrendBucket::Week, TrendBucket::Month}) {
+        state.trends[(int)bucket] = buildSentimentTrend(state.analyses, state.senatorIndex, bucket);
+    }
+
+    for (size_t i = 0; i < state.baseStats.size(); i++)
+        state.baseIndex[state.baseStats[i].name] = i;
+    for (size_t i = 0; i < state.talkStats.size(); i++)
+        state.talkIndex[state.talkStats[i].name] = i;
+    for (size_t i = 0; i < state.summaries.size(); i++)
+        state.summaryIndex[state.summaries[i].name] = i;
+
+    return state;
+}
+
+static string queryError(const string& message)
+{
+    return "{\"ok\":false,\"error\":\"" + escapeJsonString(message) + "\"}";
+}
+
+// Protocol: one request per line, one JSON object per response line.
+//   PING
+//   SENATORS
+//   SUMMARY <senator name>
+//   EXTREMES <senator name>
+//   TALK
+//   TOPK <pos|neg> <k> [base|adjusted] [from=DATE] [to=DATE] [senator=NAME]
+//   TOPSENATORS <high|low> <k> [base|adjusted] [from=DATE] [to=DATE]
+//   TREND <day|week|month> <from> <to> [senator=NAME]
+string answerQuery(const CorpusState& state, const string& request)
+{
+    stringstream ss(request);
+    string command;
+    ss >> command;
+    transform(command.begin(), command.end(), command.begin(), ::toupper);
+
+    string argument;
+    getline(ss >> ws, argument);
+
+    ostringstream out;
+    out << fixed << setprecision(2);
+
+    if (command == "PING") {
+        return "{\"ok\":true,\"pong\":true}";
+    }
+    if (command == "SENATORS") {
+        out << "{\"ok\":true,\"senators\":[";
+        const auto& names = state.senatorIndex.names;
+        for (size_t i = 0; i < names.size(); i++) {
+            if (i > 0) out << ",";
+            out << "\"" << escapeJsonString(names[i]) << "\"";
+        }
+        out << "]}";
+        return out.str();
+    }
+    if (command == "SUMMARY" || command == "EXTREMES") {
+        auto it = state.summaryIndex.find(argument);
+        if (it == state.summaryIndex.end()) {
+            return queryError("Senator not found: " + argument);
+        }
+        const auto& summary = state.summaries[it->second];
+        out << "{\"ok\":true,\"name\":\"" << escapeJsonString(summary.name) << "\"";
+
+        if (command == "EXTREMES") {
+            out << ",\"mostPositive\":" << formatTweetJson(state.tweets, summary.mostPositiveTweet)
+                << ",\"mostNegative\":" << formatTweetJson(state.tweets, summary.mostNegativeTweet) << "}";
+            return out.str();
+        }
+
+        const auto& base = state.baseStats[state.baseIndex.at(summary.name)];
+        const auto& talk = state.talkStats[state.talkIndex.at(summary.name)];
+        out << ",\"baseStats\":{\"totalTweets\":" << base.totalTweets
+            << ",\"totalWords\":" << base.totalWords
+            << ",\"positivePercent\":" << base.positivePercent
+            << ",\"negativePercent\":" << base.negativePercent << "}"
+            << ",\"talkStats\":{\"tweetCount\":" << talk.tweetCount
+            << ",\"avgWordsPerTweet\":" << talk.avgWordsPerTweet << "}"
+            << ",\"advancedSummary\":{\"avgBaseSentiment\":" << summary.avgBaseSentiment
+            << ",\"avgAdjustedSentiment\":" << summary.avgAdjustedSentiment
+            << ",\"avgPosPercent\":" << summary.avgPosPercent
+            << ",\"avgNegPercent\":" << summary.avgNegPercent
+            << ",\"avgAllCaps\":" << summary.avgAllCaps
+            << ",\"avgExclamations\":" << summary.avgExclamations
+            << ",\"avgStyleScore\":" << summary.avgStyleScore << "}}";
+        return out.str();
+    }
+    if (command == "TALK") {
+        if (state.talkStats.empty()) return queryError("No tweets loaded");
+
+        const TalkStats* mostTweets = &state.talkStats[0];
+        const TalkStats* mostWordy = &state.talkStats[0];
+        out << "{\"ok\":true,\"senators\":[";
+        for (size_t i = 0; i < state.talkStats.size(); i++) {
+            const auto& s = state.talkStats[i];
+            if (i > 0) out << ",";
+            out << "{\"name\":\"" << escapeJsonString(s.name) << "\""
+                << ",\"tweetCount\":" << s.tweetCount
+                << ",\"avgWordsPerTweet\":" << s.avgWordsPerTweet << "}";
+            if (s.tweetCount > mostTweets->tweetCount) mostTweets = &s;
+            if (s.avgWordsPerTweet > mostWordy->avgWordsPerTweet) mostWordy = &s;
+        }
+        out << "],\"mostTweets\":\"" << escapeJsonString(mostTweets->name) << "\""
+            << ",\"mostWordy\":\"" << escapeJsonString(mostWordy->name) << "\"}";
+        return out.str();
+    }
+    if (command == "TOPK" || command == "TOPSENATORS") {
+        bool senators = (command == "TOPSENATORS");
+        const string usage = senators
+            ? "Usage: TOPSENATORS <high|low> <k> [base|adjusted] [from=DATE] [to=DATE]"
+            : "Usage: TOPK <pos|neg> <k> [base|adjusted] [from=DATE] [to=DATE] [senator=NAME]";
+        
+        stringstream args(argument);
+        string direction;
+        int k = 0;
+        args >> direction >> k;
+        if (k <= 0) return queryError(usage);
+        
+        RankOrder order;
+        if (direction == (senators ? "high" : "pos")) order = RankOrder::MostPositive;
+        else if (direction == (senators ? "low" : "neg")) order = RankOrder::MostNegative;
+        else return queryError(usage);
+        
+        ScoreKind kind = ScoreKind::Adjusted;
+        TopKFilter filter;
+        string option;
+        while (args >> option) {
+            if (option == "base") kind = ScoreKind::Base;
+            else if (option == "adjusted") kind = ScoreKind::Adjusted;
+            else if (option.rfind("from=", 0) == 0) {
+                if (!parseIsoTimestamp(option.substr(5), filter.fromTime)) return queryError(usage);
+            }
+            else if (option.rfind("to=", 0) == 0) {
+                if (!parseIsoTimestamp(option.substr(3), filter.toTime)) return queryError(usage);
+            }
+            else if (option.rfind("senator=", 0) == 0) {
+                // Senator names contain spaces, so senator= takes the rest of the line
+                string rest;
+                getline(args, rest);
+                string name = option.substr(8) + rest;
+                filter.senatorId = state.senatorIndex.findSenator(name);
+                if (filter.senatorId < 0) return queryError("Senator not found: " + name);
+            }
+            else return queryError(usage);
+        }
+        if (filter.fromTime > filter.toTime) return queryError(usage);
+        
+        if (senators) {
+            vector<RankedItem> ranked = topKSenators(state.analyses, state.senatorIndex, k, kind, order, filter);
+            out << "{\"ok\":true,\"senators\":[";
+            for (size_t i = 0; i < ranked.size(); i++) {
+                if (i > 0) out << ",";
+                out << "{\"name\":\"" << escapeJsonString(state.senatorIndex.names[ranked[i].index]) << "\""
+                    << ",\"avgScore\":" << ranked[i].score << "}";
+            }
+            out << "]}";
+            return out.str();
+        }
+        
+        vector<RankedItem> ranked = topKTweets(state.analyses, state.senatorIndex, k, kind, order, filter);
+        out << "{\"ok\":true,\"tweets\":[";
+        for (size_t i = 0; i < ranked.size(); i++) {
+            if (i > 0) out << ",";
+            out << formatTweetJson(state.tweets, state.analyses[ranked[i].index]);
+        }
+        out << "]}";
+        return out.str();
+    }
+
+    if (command == "TREND") {
+        const string usage = "Usage: TREND <day|week|month> <from> <to> [senator=NAME]";
+        stringstream args(argument);
+        string bucketName, from, to;
+        args >> bucketName >> from >> to;
+        
+        TrendBucket bucket;
+        long long fromTime, toTime;
+        if (!parseTrendBucket(bucketName, bucket) ||
+            !parseIsoTimestamp(from, fromTime) || !parseIsoTimestamp(to, toTime) ||
+            fromTime > toTime) {
+            return queryError(usage);
+        }
+        
+        const SentimentTrend& trend = state.trends[(int)bucket];
+        int series = trend.seriesCount - 1;
+        string option;
+        if (args >> option) {
+            if (option.rfind("senator=", 0) != 0) return queryError(usage);
+            string rest;
+            getline(args, rest);
+            string name = option.substr(8) + rest;
+            series = state.senatorIndex.findSenator(name);
+            if (series < 0) return queryError("Senator not found: " + name);
         }
+        
+        // Whole buckets overlapping [from, to); the end bucket is exclusive
+        size_t fromBucket = trend.bucketOf(fromTime);
+        size_t toBucket = trend.bucketOf(toTime);
+        double avgBase = 0.0, avgAdjusted = 0.0;
+        trend.rangeAverage(series, fromBucket, toBucket, ScoreKind::Base, avgBase);
+        trend.rangeAverage(series, fromBucket, toBucket, ScoreKind::Adjusted, avgAdjusted);
+        
+        out << "{\"ok\":true,\"count\":" << trend.rangeCount(series, fromBucket, toBucket)
+            << ",\"avgBase\":" << avgBase
+            << ",\"avgAdjusted\":" << avgAdjusted << "}";
+        return out.str();
     }
-    return alphaCount > 0;
+
+    return queryError("Unknown command: " + command);
 }
 
-string escapeJsonString(const string& s)
+#ifndef _WIN32
+static bool sendAll(int fd, const string& data)
 {
-    string result;
-    for (char c : s) {
-        switch (c) {
-            case '"': result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\n': result += "\\n"; break;
-            case '\r': result += "\\r"; break;
-            case '\t': result += "\\t"; break;
-            default: result += c;
-        }
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+        if (n <= 0) return false;
+        sent += n;
     }
-    return result;
+    return true;
 }
 
-// ============================================================================
-// PART I: BASE SENTIMENT ANALYSIS
-// ============================================================================
-
-unordered_set<string> buildLexiconSet(const vector<string>& words)
+static bool makeUnixSocketAddress(const string& socketPath, sockaddr_un& addr)
 {
-    unordered_set<string> lexicon;
-    for (const auto& word : words) {
-        string stemmed = stemString(word);
-        if (!stemmed.empty())
-            lexicon.insert(stemmed);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        cerr << "Error: Socket path too long: " << socketPath << endl;
+        return false;
     }
-    return lexicon;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    return true;
 }
 
-vector<SenatorStats> computeBaseSenatorStats(
-    const vector<Tweet>& tweets,
-    const unordered_set<string>& positiveLexicon,
-    const unordered_set<string>& negativeLexicon)
+// One thread per connection. Each corpus snapshot is immutable, so clients
+// never wait on each other. A request is answered from the snapshot current
+// when it arrives.
+static void serveQueryClient(int clientFd, shared_ptr<const SnapshotHandle<CorpusState>> states)
 {
-    unordered_map<string, SenatorStats> statsMap;
-    
-    for (const auto& tweet : tweets) {
-        auto& stats = statsMap[tweet.senatorName];
-        stats.name = tweet.senatorName;
-        stats.totalTweets++;
-        
-        stringstream ss(tweet.text);
-        string rawWord;
-        while (ss >> rawWord) {
-            string normalized = normalizeWord(rawWord);
-            if (normalized.empty()) continue;
-            
-            stats.totalWords++;
-            
-            if (positiveLexicon.count(normalized)) {
-                stats.totalPositiveWords++;
-            }
-            if (negativeLexicon.count(normalized)) {
-                stats.totalNegativeWords++;
+    SnapshotReader<CorpusState> state(*states);
+    string pending;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(clientFd, buffer, sizeof(buffer), 0)) > 0) {
+        pending.append(buffer, n);
+        size_t newline;
+        while ((newline = pending.find('\n')) != string::npos) {
+            string line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+
+            if (!sendAll(clientFd, answerQuery(state.get(), line) + "\n")) {
+                close(clientFd);
+                return;
             }
         }
     }
-    
-    vector<SenatorStats> result;
-    for (auto& pair : statsMap) {
-        auto& stats = pair.second;
-        if (stats.totalWords > 0) {
-            stats.positivePercent = 100.0 * stats.totalPositiveWords / stats.totalWords;
-            stats.negativePercent = 100.0 * stats.totalNegativeWords / stats.totalWords;
-        }
-        result.push_back(stats);
-    }
-    
-    return result;
+    close(clientFd);
 }
+#endif
 
-void printBaseSentimentTable(const vector<SenatorStats>& stats)
+int runQueryDaemon(const string& socketPath)
 {
-    cout << "\n========================================" << endl;
-    cout << "PART I: BASE SENTIMENT ANALYSIS" << endl;
-    cout << "========================================" << endl;
-    cout << left << setw(30) << "Senator" 
-         << right << setw(12) << "Positive %" 
-         << setw(12) << "Negative %" << endl;
-    cout << string(54, '-') << endl;
+    #ifdef _WIN32
+    cerr << "Error: Daemon mode requires Unix domain sockets" << endl;
+    return 1;
+    #else
+    cout << "Loading and scoring corpus..." << endl;
+    auto state = make_shared<const CorpusState>(loadCorpusState());
+    cout << "Loaded " << state->tweets.size() << " tweets from "
+         << state->senatorIndex.names.size() << " senators." << endl;
+    auto states = make_shared<SnapshotHandle<CorpusState>>(state);
     
-    for (const auto& s : stats) {
-        cout << left << setw(30) << s.name;
-        
-        // Color code positive percent
-        cout << Color::getPercentColor(s.positivePercent) 
-             << right << setw(12) << fixed << setprecision(5) << s.positivePercent 
-             << Color::RESET;
-        
-        // Color code negative percent
-        cout << Color::getPercentColor(s.negativePercent) 
-             << setw(12) << fixed << setprecision(5) << s.negativePercent 
-             << Color::RESET << endl;
+    // A changed scoring.conf rescores the corpus on the watcher thread;
+    // clients keep being answered from the old snapshot until it is done
+    SnapshotHandle<ScoringModel> models(state->model);
+    state.reset(); // from here on only the handle and clients hold snapshots
+    vector<string> posWords = readEmotionFile("positive-words.txt");
+    vector<string> negWords = readEmotionFile("negative-words.txt");
+    ScoringConfigWatcher watcher(models, posWords, negWords, chrono::milliseconds(1000),
+        [states](shared_ptr<const ScoringModel> model) {
+            states->publish(make_shared<const CorpusState>(loadCorpusState(model)));
+            cout << "Rescored corpus with the " << model->source << " scoring model" << endl;
+        });
+
+    sockaddr_un addr;
+    if (!makeUnixSocketAddress(socketPath, addr)) return 1;
+
+    int serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (serverFd < 0) {
+        cerr << "Error: Could not create socket" << endl;
+        return 1;
+    }
+    unlink(socketPath.c_str()); // Remove a stale socket from a previous run
+    if (bind(serverFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(serverFd, 64) < 0) {
+        cerr << "Error: Could not listen on " << socketPath << endl;
+        close(serverFd);
+        return 1;
     }
-    cout << endl;
-}
 
-// ============================================================================
-// PART II CAPABILITY 1: MOST POSITIVE/NEGATIVE TWEETS
-// ============================================================================
+    signal(SIGPIPE, SIG_IGN); // A client hanging up must not kill the daemon
+    cout << "Listening on " << socketPath << endl;
 
-TweetSentiment analyzeTweetLexiconOnly(
-    const Tweet& tweet,
-    const unordered_set<string>& positiveLexicon,
-    const unordered_set<string>& negativeLexicon)
-{
-    TweetSentiment result;
-    result.tweet = &tweet;
-    
-    stringstream ss(tweet.text);
-    string rawWord;
-    while (ss >> rawWord) {
-        string normalized = normalizeWord(rawWord);
-        if (normalized.empty()) continue;
-        
-        result.totalWords++;
-        
-        if (positiveLexicon.count(normalized)) {
-            result.positiveCount++;
-        }
-        if (negativeLexicon.count(normalized)) {
-            result.negativeCount++;
-        }
+    while (true) {
+        int clientFd = accept(serverFd, nullptr, nullptr);
+        if (clientFd < 0) continue;
+        thread(serveQueryClient, clientFd, states).detach();
     }
-    
-    result.rawScore = result.positiveCount - result.negativeCount;
-    return result;
+    #endif
 }
 
-void showMostPositiveAndNegativeTweetForSenator(
-    const vector<Tweet>& tweets,
-    const unordered_set<string>& positiveLexicon,
-    const unordered_set<string>& negativeLexicon,
-    const string& senatorName)
+int runQueryClient(const string& socketPath, const string& request)
 {
-    TweetSentiment mostPositive, mostNegative;
-    mostPositive.rawScore = INT_MIN;
-    mostNegative.rawScore = INT_MAX;
-    
-    bool found = false;
-    for (const auto& tweet : tweets) {
-        if (tweet.senatorName == senatorName) {
-            found = true;
-            TweetSentiment sentiment = analyzeTweetLexiconOnly(tweet, positiveLexicon, negativeLexicon);
-            
-            if (sentiment.rawScore > mostPositive.rawScore) {
-                mostPositive = sentiment;
-            }
-            if (sentiment.rawScore < mostNegative.rawScore) {
-                mostNegative = sentiment;
-            }
-        }
+    #ifdef _WIN32
+    cerr << "Error: Query mode requires Unix domain sockets" << endl;
+    return 1;
+    #else
+    sockaddr_un addr;
+    if (!makeUnixSocketAddress(socketPath, addr)) return 1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        cerr << "Error: Could not connect to " << socketPath << endl;
+        if (fd >= 0) close(fd);
+        return 1;
     }
-    
-    if (!found) {
-        cout << "Senator not found: " << senatorName << endl;
-        return;
+
+    if (!sendAll(fd, request + "\n")) {
+        close(fd);
+        return 1;
     }
-    
-    cout << "\n========================================" << endl;
-    cout << "MOST POSITIVE/NEGATIVE TWEETS FOR: " << senatorName << endl;
-    cout << "========================================" << endl;
-    
-    cout << "\nMOST POSITIVE TWEET:" << endl;
-    cout << "Text: " << mostPositive.tweet->text << endl;
-    cout << "Positive words: " << mostPositive.positiveCount << endl;
-    cout << "Negative words: " << mostPositive.negativeCount << endl;
-    cout << "Total words: " << mostPositive.totalWords << endl;
-    cout << "Raw score: " << mostPositive.rawScore << endl;
-    
-    cout << "\nMOST NEGATIVE TWEET:" << endl;
-    cout << "Text: " << mostNegative.tweet->text << endl;
-    cout << "Positive words: " << mostNegative.positiveCount << endl;
-    cout << "Negative words: " << mostNegative.negativeCount << endl;
-    cout << "Total words: " << mostNegative.totalWords << endl;
-    cout << "Raw score: " << mostNegative.rawScore << endl;
-    cout << endl;
+
+    string response;
+    char buffer[4096];
+    ssize_t n;
+    while (response.find('\n') == string::npos &&
+           (n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, n);
+    }
+    close(fd);
+
+    cout << response;
+    return response.empty() ? 1 : 0;
+    #endif
 }
 
 // ============================================================================
-// PART II CAPABILITY 2: TALKATIVE SENATORS
+// STREAMING SCORER
 // ============================================================================
 
-vector<TalkStats> computeTalkStats(const vector<Tweet>& tweets)
+void SlidingSentimentWindow::add(long long createdAt, double baseScore, double adjustedScore)
 {
-    unordered_map<string, TalkStats> statsMap;
-    
-    for (const auto& tweet : tweets) {
-        auto& stats = statsMap[tweet.senatorName];
-        stats.name = tweet.senatorName;
-        stats.tweetCount++;
-        
-        stringstream ss(tweet.text);
-        string rawWord;
-        while (ss >> rawWord) {
-            string normalized = normalizeWord(rawWord);
-            if (!normalized.empty()) {
-                stats.totalWords++;
-            }
-        }
-    }
+    entries.push_back({createdAt, baseScore, adjustedScore});
+    baseSum += baseScore;
+    adjustedSum += adjustedScore;
+    newest = max(newest, createdAt);
     
-    vector<TalkStats> result;
-    for (auto& pair : statsMap) {
-        auto& stats = pair.second;
-        if (stats.tweetCount > 0) {
-            stats.avgWordsPerTweet = (double)stats.totalWords / stats.tweetCount;
-        }
-        result.push_back(stats);
+    // Each entry is evicted at most once, so updates are amortized O(1)
+    while (!entries.empty()) {
+        const Entry& oldest = entries.front();
+        bool tooMany = maxTweets > 0 && entries.size() > maxTweets;
+        bool tooOld = maxSeconds > 0 && newest != invalidCreatedAt && oldest.createdAt <= newest - maxSeconds;
+        if (!tooMany && !tooOld) break;
+        baseSum -= oldest.baseScore;
+        adjustedSum -= oldest.adjustedScore;
+        entries.pop_front();
     }
     
-    return result;
+    // Keep the running sums from drifting once the window has emptied
+    if (entries.empty()) baseSum = adjustedSum = 0.0;
 }
 
-void printTalkStatsAndMostTalkative(const vector<TalkStats>& stats)
+double SlidingSentimentWindow::averageBase() const
 {
-    cout << "\n========================================" << endl;
-    cout << "PART II: TALKATIVE SENATORS" << endl;
-    cout << "========================================" << endl;
-    cout << left << setw(30) << "Senator"
-         << right << setw(12) << "Tweet Count"
-         << setw(18) << "Avg Words/Tweet" << endl;
-    cout << string(60, '-') << endl;
+    return entries.empty() ? 0.0 : baseSum / entries.size();
+}
+
+double SlidingSentimentWindow::averageAdjusted() const
+{
+    return entries.empty() ? 0.0 : adjustedSum / entries.size();
+}
+
+// Reads pipe-delimited tweet records from input until EOF and writes one
+// NDJSON line per record with the tweet's scores and its senator's
+// sliding-window averages. Output is flushed per record so downstream
+// readers see results immediately. Edits to scoring.conf take effect from
+// the next record. A line that ends inside a quoted field is held until
+// the field closes, for at most maxHeldLines lines; an unclosed quote is
+// then read as literal text, as in tweets.csv.
+int runStreamingScorer(istream& input, long long windowSeconds, size_t windowTweets)
+{
+    vector<string> posWords = readEmotionFile("positive-words.txt");
+    vector<string> negWords = readEmotionFile("negative-words.txt");
+    SnapshotHandle<ScoringModel> models(loadScoringModel(posWords, negWords));
+    ScoringConfigWatcher watcher(models, posWords, negWords, chrono::milliseconds(1000));
+    SnapshotReader<ScoringModel> model(models);
     
-    TalkStats mostTweets = stats[0];
-    TalkStats mostWordy = stats[0];
+    const size_t maxHeldLines = 64;
+    unordered_map<string, SlidingSentimentWindow> windows;
+    string line, pending;
+    size_t heldLines = 0;
+    long long lineNumber = 0;
+    vector<string> row;
     
-    for (const auto& s : stats) {
-        cout << left << setw(30) << s.name
-             << right << setw(12) << s.tweetCount
-             << setw(18) << fixed << setprecision(2) << s.avgWordsPerTweet << endl;
-        
-        if (s.tweetCount > mostTweets.tweetCount) {
-            mostTweets = s;
+    while (true) {
+        bool more = (bool)getline(input, line);
+        if (more) {
+            lineNumber++;
+            pending += line;
+            pending += '\n';
+            if (++heldLines < maxHeldLines && endsInsideQuotedField(pending)) continue;
         }
-        if (s.avgWordsPerTweet > mostWordy.avgWordsPerTweet) {
-            mostWordy = s;
+        
+        long long firstLine = lineNumber - heldLines + 1;
+        RecordScanner scanner(pending.data(), pending.size());
+        size_t recordLine;
+        string_view raw;
+        while (scanner.next(row, recordLine, raw)) {
+            string problem = tweetRowProblem(row);
+            if (problem.empty() && row[0] == "") problem = "not a tweet record";
+            if (!problem.empty()) {
+                // Header lines and malformed records are reported, not scored
+                cerr << "Skipping line " << firstLine + recordLine - 1 << ": " << problem << endl;
+                continue;
+            }
+            
+            auto started = chrono::steady_clock::now();
+            Tweet tweet = tweetFromRow(row);
+            AdvancedTweetAnalysis analysis = analyzeTweetAdvanced(tweet, model.get());
+            
+            auto inserted = windows.emplace(tweet.senatorName, SlidingSentimentWindow());
+            SlidingSentimentWindow& window = inserted.first->second;
+            if (inserted.second) {
+                window.maxSeconds = windowSeconds;
+                window.maxTweets = windowTweets;
+            }
+            window.add(analysis.createdAt, analysis.baseSentimentScore, analysis.adjustedSentimentScore);
+            auto latency = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started);
+            
+            string record = formatTweetJson(tweet, analysis);
+            record.pop_back(); // reopen the object to append the window fields
+            cout << record << fixed << setprecision(2)
+                 << ",\"window\":{\"count\":" << window.size()
+                 << ",\"avgBase\":" << window.averageBase()
+                 << ",\"avgAdjusted\":" << window.averageAdjusted() << "}"
+                 << ",\"latencyUs\":" << latency.count() << "}\n" << flush;
         }
+        pending.clear();
+        heldLines = 0;
+        if (!more) break;
     }
     
-    cout << "\nMOST TWEETS: " << mostTweets.name 
-         << " (" << mostTweets.tweetCount << " tweets)" << endl;
-    cout << "HIGHEST AVG WORDS/TWEET: " << mostWordy.name 
-         << " (" << fixed << setprecision(2) << mostWordy.avgWordsPerTweet << " words)" << endl;
-    cout << endl;
+    return 0;
 }
 
 // ============================================================================
-// EXTRA CREDIT: ADVANCED SENTIMENT ENGINE - LEXICON BUILDING
+// PIPELINED BATCH RUN
 // ============================================================================
 
-unordered_map<string, double> buildWordPolarityMap(
-    const vector<string>& posWords,
-    const vector<string>& negWords)
+// A batch of split input records travelling from the reader to the scorer
+struct RecordChunk {
+    vector<vector<string>> rows;
+};
+
+// The scorer's output for one RecordChunk, in input order
+struct ScoredChunk {
+    vector<Tweet> tweets;
+    vector<TweetSentiment> lexiconScores;
+    vector<AdvancedTweetAnalysis> analyses;
+};
+
+// Time a stage spent working versus waiting on its neighbours
+struct StageTimer {
+    chrono::steady_clock::duration busy{};
+    chrono::steady_clock::time_point started;
+    void start() { started = chrono::steady_clock::now(); }
+    void stop() { busy += chrono::steady_clock::now() - started; }
+    long long milliseconds() const {
+        return chrono::duration_cast<chrono::milliseconds>(busy).count();
+    }
+};
+
+// Reader -> scorer -> aggregator/writer, each stage on its own thread and
+// connected by bounded SPSC queues. A full queue stalls the stage feeding
+// it, so memory stays bounded and throughput settles at the slowest stage.
+// Scoring uses the scorer thread's own scratch arena and stemmer state.
+int runPipeline(const string& outputFile, size_t chunkSize, NdjsonSink* ndjson)
 {
-    unordered_map<string, double> polarityMap;
+    auto wallStart = chrono::steady_clock::now();
     
-    // Add positive words with default weight +1.0
-    for (const auto& word : posWords) {
-        string stemmed = stemString(word);
-        if (!stemmed.empty()) {
-            polarityMap[stemmed] = 1.0;
-        }
+    vector<string> posWords = readEmotionFile("positive-words.txt");
+    vector<string> negWords = readEmotionFile("negative-words.txt");
+    unordered_set<string> positiveLexicon = buildLexiconSet(posWords);
+    unordered_set<string> negativeLexicon = buildLexiconSet(negWords);
+    shared_ptr<const ScoringModel> model = loadScoringModel(posWords, negWords);
+    
+    MappedFile file;
+    if (!file.open("tweets.csv")) {
+        cerr << "Error: Could not open tweets.csv" << endl;
+        return 1;
     }
     
-    // Add negative words with default weight -1.0
-    for (const auto& word : negWords) {
-        string stemmed = stemString(word);
-        if (!stemmed.empty()) {
-            polarityMap[stemmed] = -1.0;
+    const size_t queueDepth = 8;
+    SpscQueue<RecordChunk> rawQueue(queueDepth);
+    SpscQueue<ScoredChunk> scoredQueue(queueDepth);
+    StageTimer readTimer, scoreTimer, writeTimer;
+    
+    vector<RejectedRecord> rejects;     // filled by the reader, read after it joins
+    thread reader([&]() {
+        RecordScanner scanner(file.data(), file.size());
+        vector<string> row;
+        size_t line;
+        string_view raw;
+        scanner.next(row, line, raw); // Skip header
+        RecordChunk chunk;
+        readTimer.start();
+        while (scanner.next(row, line, raw)) {
+            string reason = tweetRowProblem(row);
+            if (!reason.empty()) {
+                rejects.push_back({line, reason, string(raw)});
+                continue;
+            }
+            chunk.rows.push_back(move(row));
+            if (chunk.rows.size() == chunkSize) {
+                readTimer.stop();
+                rawQueue.push(move(chunk));
+                readTimer.start();
+                chunk = RecordChunk();
+            }
+        }
+        readTimer.stop();
+        if (!chunk.rows.empty()) rawQueue.push(move(chunk));
+        rawQueue.close();
+    });
+    
+    thread scorer([&]() {
+        RecordChunk chunk;
+        while (rawQueue.pop(chunk)) {
+            scoreTimer.start();
+            ScoredChunk scored;
+            for (const auto& row : chunk.rows) {
+                scored.tweets.push_back(tweetFromRow(row));
+                const Tweet& tweet = scored.tweets.back();
+                scored.lexiconScores.push_back(analyzeTweetLexiconOnly(tweet.text, positiveLexicon, negativeLexicon));
+                scored.analyses.push_back(analyzeTweetAdvanced(tweet, *model));
+            }
+            scoreTimer.stop();
+            scoredQueue.push(move(scored));
+        }
+        scoredQueue.close();
+    });
+    
+    // Aggregator/writer stage runs on this thread
+    TweetTable tweets;
+    vector<TweetSentiment> lexiconScores;
+    vector<AdvancedTweetAnalysis> analyses;
+    ScoredChunk scored;
+    while (scoredQueue.pop(scored)) {
+        writeTimer.start();
+        for (size_t i = 0; i < scored.tweets.size(); i++) {
+            if (ndjson) ndjson->writeTweet(scored.tweets[i], scored.analyses[i]);
+            scored.analyses[i].row = tweets.size();
+            tweets.append(scored.tweets[i]);
         }
+        move(scored.lexiconScores.begin(), scored.lexiconScores.end(), back_inserter(lexiconScores));
+        move(scored.analyses.begin(), scored.analyses.end(), back_inserter(analyses));
+        writeTimer.stop();
     }
+    reader.join();
+    scorer.join();
+    reportRejectedRecords(rejects, "tweets_rejects.tsv");
     
-    // Override specific strong words
-    polarityMap[stemString("love")] = 2.0;
-    polarityMap[stemString("amazing")] = 2.0;
-    polarityMap[stemString("excellent")] = 2.0;
-    polarityMap[stemString("hate")] = -2.0;
-    polarityMap[stemString("terrible")] = -2.0;
-    polarityMap[stemString("horrible")] = -2.0;
+    writeTimer.start();
+    SenatorIndex index = buildSenatorIndex(tweets, move(lexiconScores));
+    vector<SenatorStats> baseStats = computeBaseSenatorStats(index);
+    vector<AdvancedSenatorSummary> summaries = summarizeAdvancedBySenator(tweets, analyses);
+    if (ndjson) {
+        unordered_map<string, size_t> baseByName;
+        for (size_t i = 0; i < baseStats.size(); i++) baseByName[baseStats[i].name] = i;
+        for (const auto& summary : summaries) {
+            auto base = baseByName.find(summary.name);
+            ndjson->writeSenatorSummary(base == baseByName.end() ? SenatorStats() : baseStats[base->second], summary);
+        }
+        ndjson->finish(analyses.size(), summaries.size());
+    }
+    if (!outputFile.empty()) writeAnalysisJson(baseStats, summaries, tweets, analyses, outputFile);
+    writeTimer.stop();
     
-    return polarityMap;
+    // Keep stdout clean when it carries the NDJSON stream
+    auto wall = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - wallStart);
+    (ndjson && ndjson->writesToStdout() ? cerr : cout) << "Processed " << tweets.size() << " tweets in " << wall.count() << " ms "
+         << "(busy: read " << readTimer.milliseconds() << " ms, score "
+         << scoreTimer.milliseconds() << " ms, aggregate/write " << writeTimer.milliseconds() << " ms)" << endl;
+    return 0;
 }
 
-unordered_set<string> buildNegationWords()
-{
-    return {
-        stemString("not"), stemString("no"), stemString("never"),
-        stemString("none"), stemString("nobody"), stemString("nothing"),
-        stemString("neither"), stemString("nowhere"), stemString("hardly"),
-        stemString("barely"), stemString("scarcely"), "n't"
-    };
-}
+// ============================================================================
+// ALLOCATION SELF-CHECK
+// ============================================================================
 
-unordered_set<string> buildIntensifiers()
-{
-    return {
-        stemString("very"), stemString("really"), stemString("extremely"),
-        stemString("so"), stemString("super"), stemString("highly"),
-        stemString("absolutely"), stemString("completely"), stemString("totally")
-    };
-}
+#ifdef SENTIMENT_COUNT_ALLOCATIONS
+// Build with -DSENTIMENT_COUNT_ALLOCATIONS to count every heap allocation
+// in the process; --alloc-check uses this to confirm the scoring hot path
+// stays off the heap.
+static atomic<size_t> heapAllocationCount{0};
 
-unordered_set<string> buildDowntoners()
+void* operator new(size_t size)
 {
-    return {
-        stemString("slightly"), stemString("somewhat"), stemString("kind"),
-        stemString("bit"), stemString("little"), stemString("fairly"),
-        stemString("rather"), stemString("quite")
-    };
+    heapAllocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
 }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#endif
 
-unordered_map<string, double> buildNgramPolarity()
+// Scores every tweet twice: the first pass warms the scratch arena and key
+// buffer, the second counts heap allocations. Returns non-zero if the
+// second pass allocated anything.
+int runAllocationCheck()
 {
-    unordered_map<string, double> ngramMap;
-    
-    // Positive phrases
-    ngramMap["so much fun"] = 2.0;
-    ngramMap["great job"] = 1.5;
-    ngramMap["well done"] = 1.5;
-    ngramMap["thank you"] = 1.0;
-    ngramMap["looking forward"] = 1.5;
+#ifdef SENTIMENT_COUNT_ALLOCATIONS
+    vector<string> posWords = readEmotionFile("positive-words.txt");
+    vector<string> negWords = readEmotionFile("negative-words.txt");
+    shared_ptr<const ScoringModel> model = loadScoringModel(posWords, negWords);
+    TweetTable tweets = read_tweets_csv_file();
+    if (tweets.empty()) {
+        cerr << "Error: No tweets loaded" << endl;
+        return 1;
+    }
     
-    // Negative phrases
-    ngramMap["sick of"] = -2.0;
-    ngramMap["waste of time"] = -2.0;
-    ngramMap["so tired of"] = -1.5;
-    ngramMap["fed up"] = -1.5;
-    ngramMap["not good"] = -1.5;
+    AdvancedTweetAnalysis analysis;
+    size_t allocations = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t before = heapAllocationCount.load();
+        for (size_t i = 0; i < tweets.size(); i++) {
+            analysis = AdvancedTweetAnalysis();
+            scoreTweetText(tweets.text(i), *model, analysis);
+        }
+        allocations = heapAllocationCount.load() - before;
+    }
     
-    return ngramMap;
+    cout << "Scored " << tweets.size() << " tweets: " << allocations << " heap allocations ("
+         << fixed << setprecision(3) << (double)allocations / tweets.size() << " per tweet)" << endl;
+    return allocations == 0 ? 0 : 1;
+#else
+    cerr << "Error: Allocation counting is not compiled in; rebuild with -DSENTIMENT_COUNT_ALLOCATIONS" << endl;
+    return 1;
+#endif
 }
 
-unordered_set<string> buildPositiveEmojisSlang()
+// ============================================================================
+// STEMMER VERIFICATION
+// ============================================================================
+
+// Checks the table-driven stemmer against the reference Porter stemmer on
+// the lexicons, every token in tweets.csv, any extra word lists, and
+// generated words that stack random stems with the suffixes the rules
+// know (so every rule and condition is exercised). Then times both.
+// Returns non-zero on any mismatch.
+int runStemmerVerification(const vector<string>& wordLists)
 {
-    return {
-        "lol", "lmao", "haha", "hehe", "yay", "awesome",
-        "😂", "🤣", "😊", "😃", "😄", "❤️", "💙", "👍", "✨"
+    unordered_set<string> seen;
+    vector<string> words;
+    auto addWord = [&](string word) {
+        for (char& c : word) c = tolower((unsigned char)c);
+        if (!word.empty() && seen.insert(word).second) words.push_back(move(word));
+    };
+    auto addFile = [&](const string& path) {
+        ifstream in(path);
+        if (!in.is_open()) {
+            cerr << "Error: Could not open " << path << endl;
+            return false;
+        }
+        string word;
+        while (in >> word) addWord(word);
+        return true;
+    };
+    
+    addFile("positive-words.txt");
+    addFile("negative-words.txt");
+    size_t lexiconWords = words.size();
+    TweetTable tweets = read_tweets_csv_file();
+    for (size_t i = 0; i < tweets.size(); i++) {
+        stringstream ss{string(tweets.text(i))};
+        string word;
+        while (ss >> word) addWord(word);
+    }
+    size_t tweetWords = words.size() - lexiconWords;
+    for (const string& path : wordLists) {
+        if (!addFile(path)) return 1;
+    }
+    size_t fileWords = words.size() - lexiconWords - tweetWords;
+    
+    const vector<string> suffixes = {
+        "s", "es", "sses", "ies", "ed", "eed", "ing", "ings", "y", "ly", "e", "ll", "at", "bl", "iz",
+        "ational", "tional", "enci", "anci", "izer", "bli", "alli", "entli", "eli", "ousli", "ization",
+        "ation", "ator", "alism", "iveness", "fulness", "ousness", "aliti", "iviti", "biliti", "logi",
+        "icate", "ative", "alize", "iciti", "ical", "ful", "ness", "al", "ance", "ence", "er", "ic",
+        "able", "ible", "ant", "ement", "ment", "ent", "sion", "tion", "ion", "ou", "ism", "ate",
+        "iti", "ous", "ive", "ize"
     };
-}
-
-unordered_set<string> buildNegativeEmojisSlang()
-{
-    return {
-        "ugh", "omg", "wtf", "smh",
-        "💀", "😡", "😭", "😢", "👎", "😠"
+    const string letters = "abcdefghijklmnopqrstuvwxyzaeiouy";
+    mt19937_64 random(43);
+    for (int i = 0; i < 400000; i++) {
+        string word;
+        size_t stemLength = 1 + random() % 7;
+        for (size_t c = 0; c < stemLength; c++) word += letters[random() % letters.size()];
+        for (size_t n = random() % 3; n > 0; n--) word += suffixes[random() % suffixes.size()];
+        addWord(word);
+    }
+    size_t generatedWords = words.size() - lexiconWords - tweetWords - fileWords;
+    
+    // Every word is copied into a scratch buffer and stemmed by both
+    size_t mismatches = 0;
+    vector<char> buffer;
+    for (const string& word : words) {
+        buffer.assign(word.begin(), word.end());
+        int referenceLength = stem(buffer.data(), 0, buffer.size() - 1) + 1;
+        string reference(buffer.data(), referenceLength);
+        buffer.assign(word.begin(), word.end());
+        string fast(buffer.data(), fastStem(buffer.data(), buffer.size()));
+        if (fast != reference) {
+            if (mismatches < 10) {
+                cout << "  mismatch: " << word << " -> reference " << reference << ", table-driven " << fast << "\n";
+            }
+            mismatches++;
+        }
+    }
+    
+    // Timing runs over one concatenated copy, restored between rounds; the
+    // fastest round counts, which filters out scheduling noise
+    string all;
+    vector<size_t> starts;
+    for (const string& word : words) {
+        starts.push_back(all.size());
+        all += word;
+    }
+    vector<char> work(all.begin(), all.end());
+    vector<char*> pointers(words.size());
+    vector<int> lengths(words.size());
+    const int rounds = 7;
+    volatile size_t checksum = 0;     // keeps the stemming from being optimized away
+    auto timeEngine = [&](int engine) {
+        double best = numeric_limits<double>::infinity();
+        for (int round = 0; round < rounds; round++) {
+            memcpy(work.data(), all.data(), all.size());
+            for (size_t i = 0; i < words.size(); i++) {
+                pointers[i] = work.data() + starts[i];
+                lengths[i] = words[i].size();
+            }
+            auto start = chrono::steady_clock::now();
+            size_t total = 0;
+            if (engine == 2) {
+                stemWords(pointers.data(), lengths.data(), words.size());
+                for (int length : lengths) total += length;
+            } else {
+                for (size_t i = 0; i < words.size(); i++) {
+                    total += engine == 0 ? stem(pointers[i], 0, lengths[i] - 1) + 1
+                                         : fastStem(pointers[i], lengths[i]);
+                }
+            }
+            checksum = total;
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        return best * 1e9 / words.size();
     };
+    double referenceNs = timeEngine(0);
+    double fastNs = timeEngine(1);
+    double batchNs = timeEngine(2);
+    
+    cout << "Stemmer verification: " << words.size() << " distinct words (" << lexiconWords << " lexicon, "
+         << tweetWords << " tweet tokens, " << fileWords << " from word lists, " << generatedWords
+         << " generated)\n"
+         << "  mismatches: " << mismatches << "\n"
+         << fixed << setprecision(1)
+         << "  reference " << referenceNs << " ns/word, table-driven " << fastNs << " ns/word ("
+         << setprecision(2) << referenceNs / fastNs << "x), batch " << setprecision(1) << batchNs
+         << " ns/word (includes lower-casing)" << endl;
+    return mismatches == 0 ? 0 : 1;
 }
 
 // ============================================================================
-// EXTRA CREDIT: ADVANCED SENTIMENT ENGINE - ANALYSIS
+// PARALLEL LOAD VERIFICATION
 // ============================================================================
 
-AdvancedTweetAnalysis analyzeTweetAdvanced(
-    const Tweet& tweet,
-    const unordered_map<string, double>& wordPolarity,
-    const unordered_set<string>& negationWords,
-    const unordered_set<string>& intensifiers,
-    const unordered_set<string>& downtoners,
-    const unordered_map<string, double>& ngramPolarity,
-    const unordered_set<string>& positiveEmojisSlang,
-    const unordered_set<string>& negativeEmojisSlang)
+// Loads tweets.csv with one thread and with threadCount, checks that the
+// tables and rejected records are identical, and times both (best of five)
+int runLoadVerification(size_t threadCount)
 {
-    AdvancedTweetAnalysis analysis;
-    analysis.tweetId = tweet.tweetId;
-    analysis.senatorName = tweet.senatorName;
-    analysis.datetime = tweet.datetime;
-    analysis.text = tweet.text;
-    
-    // Count punctuation
-    for (char c : tweet.text) {
-        if (c == '!') analysis.exclamationCount++;
-        if (c == '?') analysis.questionCount++;
+    MappedFile file;
+    if (!file.open("tweets.csv")) {
+        cerr << "Error: Could not open tweets.csv" << endl;
+        return 1;
     }
     
-    // Tokenize
-    stringstream ss(tweet.text);
-    string rawWord;
-    vector<string> rawTokens;
-    vector<string> normalizedTokens;
+    auto timedLoad = [&](size_t threads, TweetTable& tweets, vector<RejectedRecord>& rejects) {
+        double best = 1e300;
+        for (int round = 0; round < 5; round++) {
+            auto started = chrono::steady_clock::now();
+            tweets = parseTweetTable(file, threads, rejects);
+            best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+        }
+        return best;
+    };
+    TweetTable serial, parallel;
+    vector<RejectedRecord> serialRejects, parallelRejects;
+    double serialMs = timedLoad(1, serial, serialRejects);
+    double parallelMs = timedLoad(threadCount, parallel, parallelRejects);
     
-    while (ss >> rawWord) {
-        rawTokens.push_back(rawWord);
-        string normalized = normalizeWord(rawWord);
-        normalizedTokens.push_back(normalized);
-        
-        // Check for ALL CAPS
-        if (isAllCaps(rawWord)) {
-            analysis.allCapsWordCount++;
+    size_t mismatches = 0;
+    if (serial.size() != parallel.size() || serial.senatorNames() != parallel.senatorNames()) mismatches++;
+    for (size_t i = 0; i < min(serial.size(), parallel.size()); i++) {
+        if (serial.text(i) != parallel.text(i) || serial.senatorId(i) != parallel.senatorId(i) ||
+            serial.tweetId(i) != parallel.tweetId(i) || serial.userId(i) != parallel.userId(i) ||
+            serial.datetime(i) != parallel.datetime(i) || serial.createdAt(i) != parallel.createdAt(i)) {
+            if (mismatches++ < 5) cerr << "Mismatch at row " << i << endl;
+        }
+    }
+    if (serialRejects.size() != parallelRejects.size()) mismatches++;
+    for (size_t i = 0; i < min(serialRejects.size(), parallelRejects.size()); i++) {
+        const RejectedRecord& a = serialRejects[i];
+        const RejectedRecord& b = parallelRejects[i];
+        if (a.line != b.line || a.reason != b.reason || a.text != b.text) {
+            if (mismatches++ < 5) cerr << "Rejected record mismatch at line " << a.line << endl;
         }
     }
     
-    // Analyze tokens
-    for (size_t i = 0; i < normalizedTokens.size(); i++) {
-        const string& token = normalizedTokens[i];
-        const string& rawToken = rawTokens[i];
-        
-        if (token.empty()) continue;
-        analysis.totalWords++;
-        
-        // Check for emojis/slang in raw token (lowercase)
-        string lowerRaw = rawToken;
-        transform(lowerRaw.begin(), lowerRaw.end(), lowerRaw.begin(), ::tolower);
-        
-        if (positiveEmojisSlang.count(lowerRaw)) {
-            analysis.emojiPositiveCount++;
-            analysis.adjustedSentimentScore += 1.0;
+    double megabytes = file.size() / 1e6;
+    cout << "Loaded " << serial.size() << " tweets (" << serialRejects.size() << " rejected) from "
+         << fixed << setprecision(1) << megabytes << " MB\n"
+         << "  1 thread:  " << serialMs << " ms (" << megabytes / serialMs * 1000 << " MB/s)\n"
+         << "  " << threadCount << (threadCount == 1 ? " thread:  " : " threads: ") << parallelMs << " ms (" << megabytes / parallelMs * 1000
+         << " MB/s, " << setprecision(2) << serialMs / parallelMs << "x)\n"
+         << "  " << mismatches << " mismatches" << endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+// ============================================================================
+// SCORING PARAMETER SWEEP
+// ============================================================================
+
+// Each spec is name=values, where values is a comma-separated list of
+// numbers or start:stop:step ranges, e.g. negation=-1:-0.5:0.1. Names are
+// negation, intensifier, downtoner, lookback and exclamation; unnamed
+// parameters take their values from defaults. csv=path names the per-senator output.
+// The grid is every combination of the listed values.
+bool parseSweepGrid(
+    const vector<string>& specs,
+    const ScoringParams& defaults,
+    vector<ScoringParams>& grid,
+    string& csvPath)
+{
+    const size_t maxConfigurations = 100000;
+    const char* names[] = {"negation", "intensifier", "downtoner", "lookback", "exclamation"};
+    vector<double> values[5] = {
+        {defaults.negation}, {defaults.intensifier}, {defaults.downtoner},
+        {(double)defaults.lookBack}, {defaults.exclamationBoost}
+    };
+    
+    for (const string& spec : specs) {
+        size_t equals = spec.find('=');
+        string name = spec.substr(0, equals);
+        string list = equals == string::npos ? "" : spec.substr(equals + 1);
+        if (name == "csv" && !list.empty()) {
+            csvPath = list;
             continue;
         }
-        if (negativeEmojisSlang.count(lowerRaw)) {
-            analysis.emojiNegativeCount++;
-            analysis.adjustedSentimentScore -= 1.0;
-            continue;
+        size_t parameter = find(begin(names), end(names), name) - begin(names);
+        if (parameter == 5 || list.empty()) {
+            cerr << "Error: Expected name=values, got \"" << spec << "\"" << endl;
+            return false;
         }
         
-        // Check for n-grams (bigrams and trigrams)
-        bool inNgram = false;
-        if (i + 2 < normalizedTokens.size()) {
-            string trigram = normalizedTokens[i] + " " + normalizedTokens[i+1] + " " + normalizedTokens[i+2];
-            if (ngramPolarity.count(trigram)) {
-                double score = ngramPolarity.at(trigram);
-                analysis.adjustedSentimentScore += score;
-                if (score > 0) analysis.ngramPositiveHits++;
-                else analysis.ngramNegativeHits++;
-                inNgram = true;
-            }
-        }
-        if (!inNgram && i + 1 < normalizedTokens.size()) {
-            string bigram = normalizedTokens[i] + " " + normalizedTokens[i+1];
-            if (ngramPolarity.count(bigram)) {
-                double score = ngramPolarity.at(bigram);
-                analysis.adjustedSentimentScore += score;
-                if (score > 0) analysis.ngramPositiveHits++;
-                else analysis.ngramNegativeHits++;
-                inNgram = true;
+        values[parameter].clear();
+        stringstream items(list);
+        string item;
+        while (getline(items, item, ',')) {
+            double start, stop, step;
+            char colon1, colon2;
+            stringstream range(item);
+            if (range >> start && range.eof()) {
+                values[parameter].push_back(start);
+            } else if (stringstream(item) >> start >> colon1 >> stop >> colon2 >> step &&
+                       colon1 == ':' && colon2 == ':' && step > 0 && stop >= start) {
+                // Inclusive of stop, allowing for rounding in the step
+                for (size_t n = 0; start + n * step <= stop + step * 1e-9; n++) {
+                    values[parameter].push_back(start + n * step);
+                    if (values[parameter].size() > maxConfigurations) break;
+                }
+            } else {
+                cerr << "Error: Bad value \"" << item << "\" for " << name << endl;
+                return false;
             }
         }
-        
-        if (inNgram) continue;
-        
-        // Check for negation/intensifier/downtoner markers
-        if (negationWords.count(token)) {
-            analysis.negationHits++;
-        }
-        if (intensifiers.count(token)) {
-            analysis.intensifierHits++;
-        }
-        if (downtoners.count(token)) {
-            analysis.downtonerHits++;
+        if (values[parameter].empty()) {
+            cerr << "Error: No values for " << name << endl;
+            return false;
         }
-        
-        // Analyze sentiment word
-        if (wordPolarity.count(token)) {
-            double baseWeight = wordPolarity.at(token);
-            double adjustedWeight = baseWeight;
-            
-            // Check context (look back 1-2 tokens)
-            bool hasNegation = false;
-            bool hasIntensifier = false;
-            bool hasDowntoner = false;
-            
-            for (int j = 1; j <= 2 && (int)i - j >= 0; j++) {
-                const string& prevToken = normalizedTokens[i - j];
-                if (negationWords.count(prevToken)) hasNegation = true;
-                if (intensifiers.count(prevToken)) hasIntensifier = true;
-                if (downtoners.count(prevToken)) hasDowntoner = true;
-            }
-            
-            // Apply modifiers
-            if (hasNegation) {
-                adjustedWeight *= -0.7;
-            }
-            if (hasIntensifier) {
-                adjustedWeight *= 1.5;
-            }
-            if (hasDowntoner) {
-                adjustedWeight *= 0.5;
-            }
-            
-            analysis.baseSentimentScore += baseWeight;
-            analysis.adjustedSentimentScore += adjustedWeight;
-            
-            if (baseWeight > 0) analysis.posWordCount++;
-            else if (baseWeight < 0) analysis.negWordCount++;
-        } else {
-            analysis.neutralWordCount++;
+    }
+    for (double lookBack : values[3]) {
+        if (lookBack < 0 || lookBack > 16 || lookBack != floor(lookBack)) {
+            cerr << "Error: lookback must be a whole number from 0 to 16" << endl;
+            return false;
         }
     }
     
-    // Adjust for punctuation emphasis
-    if (analysis.exclamationCount > 0) {
-        analysis.adjustedSentimentScore *= (1.0 + 0.05 * analysis.exclamationCount);
+    double combinations = 1;
+    for (const auto& list : values) combinations *= list.size();
+    if (combinations > maxConfigurations) {
+        cerr << "Error: " << (size_t)combinations << " configurations; the limit is " << maxConfigurations << endl;
+        return false;
     }
     
-    return analysis;
+    grid.clear();
+    for (double negation : values[0])
+        for (double intensifier : values[1])
+            for (double downtoner : values[2])
+                for (double lookBack : values[3])
+                    for (double exclamation : values[4]) {
+                        ScoringParams params;
+                        params.negation = negation;
+                        params.intensifier = intensifier;
+                        params.downtoner = downtoner;
+                        params.lookBack = (int)lookBack;
+                        params.exclamationBoost = exclamation;
+                        grid.push_back(params);
+                    }
+    return true;
 }
 
-vector<AdvancedTweetAnalysis> analyzeAllTweetsAdvanced(
-    const vector<Tweet>& tweets,
-    const unordered_map<string, double>& wordPolarity,
-    const unordered_set<string>& negationWords,
-    const unordered_set<string>& intensifiers,
-    const unordered_set<string>& downtoners,
-    const unordered_map<string, double>& ngramPolarity,
-    const unordered_set<string>& positiveEmojisSlang,
-    const unordered_set<string>& negativeEmojisSlang)
+// One pass over the corpus for the whole grid. Each tweet is tokenized and
+// its terms and modifier distances found once, at the grid's longest
+// look-back; only the arithmetic runs per configuration. The modifier
+// multipliers are laid out as [distance][configuration], 1.0 where the
+// modifier is out of a configuration's look-back, so each term updates
+// every configuration's score in one straight loop. Multiplying by 1.0 is
+// exact, so each configuration's per-tweet scores are the ones
+// scoreTweetText gives with the same parameters.
+vector<SweepResult> sweepScoringParams(
+    const TweetTable& tweets,
+    const ScoringModel& model,
+    const vector<ScoringParams>& grid,
+    vector<string>& senatorNames,
+    size_t threadCount)
 {
-    vector<AdvancedTweetAnalysis> results;
+    size_t configCount = grid.size();
+    int maxLookBack = 0;
+    for (const ScoringParams& params : grid) maxLookBack = max(maxLookBack, params.lookBack);
+    maxLookBack = min(maxLookBack, (int)UINT8_MAX);
     
-    for (const auto& tweet : tweets) {
-        results.push_back(analyzeTweetAdvanced(
-            tweet, wordPolarity, negationWords, intensifiers, downtoners,
-            ngramPolarity, positiveEmojisSlang, negativeEmojisSlang
-        ));
+    size_t distances = maxLookBack + 1;
+    vector<double> negationFactor(distances * configCount, 1.0);
+    vector<double> intensifierFactor(distances * configCount, 1.0);
+    vector<double> downtonerFactor(distances * configCount, 1.0);
+    vector<double> exclamationBoost(configCount);
+    for (size_t c = 0; c < configCount; c++) {
+        for (int d = 1; d <= min(grid[c].lookBack, maxLookBack); d++) {
+            negationFactor[d * configCount + c] = grid[c].negation;
+            intensifierFactor[d * configCount + c] = grid[c].intensifier;
+            downtonerFactor[d * configCount + c] = grid[c].downtoner;
+        }
+        exclamationBoost[c] = grid[c].exclamationBoost;
     }
     
-    return results;
-}
-
-vector<AdvancedSenatorSummary> summarizeAdvancedBySenator(
-    const vector<AdvancedTweetAnalysis>& perTweet)
-{
-    unordered_map<string, vector<AdvancedTweetAnalysis>> bySenator;
-    
-    for (const auto& analysis : perTweet) {
-        bySenator[analysis.senatorName].push_back(analysis);
+    // Report senators in name order
+    senatorNames = tweets.senatorNames();
+    sort(senatorNames.begin(), senatorNames.end());
+    vector<uint32_t> senatorRow(senatorNames.size());
+    for (size_t id = 0; id < senatorRow.size(); id++) {
+        const string& name = tweets.senatorNames()[id];
+        senatorRow[id] = lower_bound(senatorNames.begin(), senatorNames.end(), name) - senatorNames.begin();
     }
+    size_t senatorCount = senatorNames.size();
     
-    vector<AdvancedSenatorSummary> summaries;
+    struct SweepTotals {
+        vector<double> sum;             // [senator][configuration]
+        vector<uint32_t> positive;
+        vector<uint32_t> negative;
+    };
+    threadCount = max<size_t>(1, min(threadCount, tweets.size()));
+    vector<SweepTotals> totals(threadCount);
     
-    for (auto& pair : bySenator) {
-        AdvancedSenatorSummary summary;
-        summary.name = pair.first;
-        summary.tweetCount = pair.second.size();
-        
-        double totalBase = 0.0, totalAdjusted = 0.0;
-        double totalPosPercent = 0.0, totalNegPercent = 0.0;
-        double totalAllCaps = 0.0, totalExclamations = 0.0;
-        
-        double maxAdjusted = -1e9, minAdjusted = 1e9;
+    auto work = [&](size_t t) {
+        SweepTotals& local = totals[t];
+        local.sum.assign(senatorCount * configCount, 0.0);
+        local.positive.assign(senatorCount * configCount, 0);
+        local.negative.assign(senatorCount * configCount, 0);
+        vector<double> scores(configCount);
+        ScratchArena& arena = tweetScratchArena();
         
-        for (const auto& analysis : pair.second) {
-            totalBase += analysis.baseSentimentScore;
-            totalAdjusted += analysis.adjustedSentimentScore;
+        size_t first = tweets.size() * t / threadCount;
+        size_t last = tweets.size() * (t + 1) / threadCount;
+        for (size_t i = first; i < last; i++) {
+            AdvancedTweetAnalysis analysis;
+            pmr::vector<ScoredTerm> terms(&arena);
+            collectScoredTerms(tweets.text(i), model, maxLookBack, analysis, terms);
             
-            if (analysis.totalWords > 0) {
-                totalPosPercent += 100.0 * analysis.posWordCount / analysis.totalWords;
-                totalNegPercent += 100.0 * analysis.negWordCount / analysis.totalWords;
+            fill(scores.begin(), scores.end(), 0.0);
+            for (const ScoredTerm& term : terms) {
+                const double* negation = &negationFactor[term.negation * configCount];
+                const double* intensifier = &intensifierFactor[term.intensifier * configCount];
+                const double* downtoner = &downtonerFactor[term.downtoner * configCount];
+                for (size_t c = 0; c < configCount; c++) {
+                    scores[c] += term.weight * negation[c] * intensifier[c] * downtoner[c];
+                }
+            }
+            if (analysis.exclamationCount > 0) {
+                for (size_t c = 0; c < configCount; c++) {
+                    scores[c] *= (1.0 + exclamationBoost[c] * analysis.exclamationCount);
+                }
             }
             
-            totalAllCaps += analysis.allCapsWordCount;
-            totalExclamations += analysis.exclamationCount;
-            
-            if (analysis.adjustedSentimentScore > maxAdjusted) {
-                maxAdjusted = analysis.adjustedSentimentScore;
-                summary.mostPositiveTweet = analysis;
+            size_t row = senatorRow[tweets.senatorId(i)] * configCount;
+            for (size_t c = 0; c < configCount; c++) {
+                local.sum[row + c] += scores[c];
+                local.positive[row + c] += scores[c] > 0;
+                local.negative[row + c] += scores[c] < 0;
             }
-            if (analysis.adjustedSentimentScore < minAdjusted) {
-                minAdjusted = analysis.adjustedSentimentScore;
-                summary.mostNegativeTweet = analysis;
+            arena.reset();
+        }
+    };
+    vector<thread> workers;
+    for (size_t t = 1; t < threadCount; t++) workers.emplace_back(work, t);
+    work(0);
+    for (thread& worker : workers) worker.join();
+    
+    SweepTotals& merged = totals[0];
+    for (size_t t = 1; t < threadCount; t++) {
+        for (size_t j = 0; j < merged.sum.size(); j++) {
+            merged.sum[j] += totals[t].sum[j];
+            merged.positive[j] += totals[t].positive[j];
+            merged.negative[j] += totals[t].negative[j];
+        }
+    }
+    vector<size_t> tweetCount(senatorCount, 0);
+    for (size_t i = 0; i < tweets.size(); i++) tweetCount[senatorRow[tweets.senatorId(i)]]++;
+    
+    vector<SweepResult> results(configCount);
+    for (size_t c = 0; c < configCount; c++) {
+        SweepResult& result = results[c];
+        result.params = grid[c];
+        double sum = 0.0, positive = 0.0, negative = 0.0;
+        double meanSum = 0.0, meanSquares = 0.0;
+        size_t activeSenators = 0;
+        for (size_t s = 0; s < senatorCount; s++) {
+            size_t j = s * configCount + c;
+            double count = max<size_t>(1, tweetCount[s]);
+            result.senatorAvgAdjusted.push_back(merged.sum[j] / count);
+            result.senatorPositiveShare.push_back(merged.positive[j] / count);
+            result.senatorNegativeShare.push_back(merged.negative[j] / count);
+            sum += merged.sum[j];
+            positive += merged.positive[j];
+            negative += merged.negative[j];
+            if (tweetCount[s] > 0) {
+                meanSum += result.senatorAvgAdjusted.back();
+                meanSquares += result.senatorAvgAdjusted.back() * result.senatorAvgAdjusted.back();
+                activeSenators++;
             }
         }
-        
-        int count = summary.tweetCount;
-        summary.avgBaseSentiment = totalBase / count;
-        summary.avgAdjustedSentiment = totalAdjusted / count;
-        summary.avgPosPercent = totalPosPercent / count;
-        summary.avgNegPercent = totalNegPercent / count;
-        summary.avgAllCaps = totalAllCaps / count;
-        summary.avgExclamations = totalExclamations / count;
-        
-        // Simple style score combining punctuation and casing
-        summary.avgStyleScore = summary.avgExclamations * 2.0 + summary.avgAllCaps * 1.5;
-        
-        summaries.push_back(summary);
+        double total = max<size_t>(1, tweets.size());
+        result.avgAdjusted = sum / total;
+        result.positiveShare = positive / total;
+        result.negativeShare = negative / total;
+        if (activeSenators > 0) {
+            double mean = meanSum / activeSenators;
+            result.senatorSpread = sqrt(max(0.0, meanSquares / activeSenators - mean * mean));
+        }
+    }
+    return results;
+}
+
+// Parameters not named in specs take the scoring model's values
+int runSweepReport(const vector<string>& specs)
+{
+    vector<string> posWords = readEmotionFile("positive-words.txt");
+    vector<string> negWords = readEmotionFile("negative-words.txt");
+    shared_ptr<const ScoringModel> model = loadScoringModel(posWords, negWords);
+    const ScoringParams& defaults = model->params;
+    vector<ScoringParams> grid;
+    string csvPath;
+    if (!parseSweepGrid(specs, defaults, grid, csvPath)) return 1;
+    
+    TweetTable tweets = read_tweets_csv_file();
+    if (tweets.empty()) {
+        cerr << "Error: No tweets to score" << endl;
+        return 1;
     }
     
-    return summaries;
+    auto started = chrono::steady_clock::now();
+    vector<string> senatorNames;
+    vector<SweepResult> results = sweepScoringParams(
+        tweets, *model, grid, senatorNames, max(1u, thread::hardware_concurrency())
+    );
+    double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    
+    ostringstream report;
+    report << "Scored " << tweets.size() << " tweets under " << results.size() << " configurations in "
+           << fixed << setprecision(0) << elapsedMs << " ms\n\n"
+           << right << setw(6) << "#" << setw(10) << "Negation" << setw(8) << "Intens" << setw(8) << "Downt"
+           << setw(6) << "Look" << setw(8) << "Excl" << setw(10) << "Avg Adj" << setw(8) << "Pos %"
+           << setw(8) << "Neg %" << setw(8) << "Spread" << "\n"
+           << string(80, '-') << "\n";
+    for (size_t c = 0; c < results.size(); c++) {
+        const SweepResult& r = results[c];
+        bool isDefault = r.params.negation == defaults.negation && r.params.intensifier == defaults.intensifier &&
+                         r.params.downtoner == defaults.downtoner && r.params.lookBack == defaults.lookBack &&
+                         r.params.exclamationBoost == defaults.exclamationBoost;
+        report << setw(5) << c + 1 << (isDefault ? "*" : " ") << setprecision(2)
+               << setw(10) << r.params.negation << setw(8) << r.params.intensifier << setw(8) << r.params.downtoner
+               << setw(6) << r.params.lookBack << setprecision(3) << setw(8) << r.params.exclamationBoost
+               << setw(10) << r.avgAdjusted << setprecision(1) << setw(8) << r.positiveShare * 100
+               << setw(8) << r.negativeShare * 100 << setprecision(3) << setw(8) << r.senatorSpread << "\n";
+    }
+    report << "(* = the " << model->source << " scoring model's settings; "
+           << "Spread = std. deviation of senator averages)\n";
+    Terminal::write(report.str());
+    
+    if (!csvPath.empty()) {
+        ofstream out(csvPath);
+        if (!out.is_open()) {
+            cerr << "Error: Could not create " << csvPath << endl;
+            return 1;
+        }
+        out << "config,negation,intensifier,downtoner,lookback,exclamation,senator,"
+            << "avg_adjusted,positive_share,negative_share\n" << setprecision(10);
+        for (size_t c = 0; c < results.size(); c++) {
+            const SweepResult& r = results[c];
+            ostringstream prefix;
+            prefix << setprecision(10) << c + 1 << "," << r.params.negation << "," << r.params.intensifier << ","
+                   << r.params.downtoner << "," << r.params.lookBack << "," << r.params.exclamationBoost << ",";
+            out << prefix.str() << "\"(all)\"," << r.avgAdjusted << "," << r.positiveShare << ","
+                << r.negativeShare << "\n";
+            for (size_t s = 0; s < senatorNames.size(); s++) {
+                out << prefix.str() << "\"" << senatorNames[s] << "\"," << r.senatorAvgAdjusted[s] << ","
+                    << r.senatorPositiveShare[s] << "," << r.senatorNegativeShare[s] << "\n";
+            }
+        }
+        cout << "Wrote per-senator results to " << csvPath << endl;
+    }
+    return 0;
 }
 
 // ============================================================================
-// JSON EXPORT
+// COMMAND-LINE MODES
 // ============================================================================
 
-void writeAnalysisJson(
-    const vector<SenatorStats>& baseStats,
-    const vector<AdvancedSenatorSummary>& advancedSummaries,
-    const vector<AdvancedTweetAnalysis>& allTweetAnalyses,
-    const string& filename)
+void printUsage(const char* program)
 {
-    ofstream out(filename);
-    if (!out.is_open()) {
-        cerr << "Error: Could not create " << filename << endl;
-        return;
+    cout << "Usage:\n"
+         << "  " << program << "                         Interactive menu\n"
+         << "  " << program << " --daemon <socket>       Serve queries over a Unix socket\n"
+         << "  " << program << " --query <socket> <cmd>  Send one query to a running daemon\n"
+         << "  " << program << " --ask <cmd>             Answer one daemon query without a daemon\n"
+         << "  " << program << " --trends <day|week|month> [window] [file]\n"
+         << "                                    Export sentiment trend series (default trends.json)\n"
+         << "  " << program << " --group-by <dims> <metric>\n"
+         << "                                    Aggregate a metric by senator/day/week/month, e.g.\n"
+         << "                                    --group-by senator,month adjusted\n"
+         << "  " << program << " --stream [--window-minutes N] [--window-tweets N] [--input FILE]\n"
+         << "                                    Score records from stdin/FIFO as NDJSON\n"
+         << "  " << program << " --pipeline [file] [chunk]\n"
+         << "                                    Staged read/score/write run (default analysis.json)\n"
+         << "  " << program << " --alloc-check           Count heap allocations while scoring\n"
+         << "  " << program << " --verify-stemmer [wordlist...]\n"
+         << "                                    Compare the fast stemmer with the reference and time both\n"
+         << "  " << program << " --verify-load [threads] Check a parallel load matches a serial one and time both\n"
+         << "  " << program << " --export-shards [dir] [threads]\n"
+         << "                                    Per-senator shards plus index.json (default shards/)\n"
+         << "  " << program << " --ndjson <file|-> [flush-ms] [json-file]\n"
+         << "                                    Per-tweet NDJSON as tweets are scored (flush default 1000 ms)\n"
+         << "  " << program << " --dedup [threshold] [exclude|downweight]\n"
+         << "                                    Near-duplicate clusters and deduplicated averages\n"
+         << "  " << program << " --topics [k] [iterations]\n"
+         << "                                    TF-IDF k-means topics with sentiment per topic\n"
+         << "  " << program << " --associations [top] [prior]\n"
+         << "                                    Non-lexicon words tied to positive/negative tweets\n"
+         << "  " << program << " --sketch [top] [epsilon]\n"
+         << "                                    Fixed-memory heavy hitters and vocabulary estimates\n"
+         << "  " << program << " --sweep [name=values...] [csv=file]\n"
+         << "                                    Score many negation/intensifier/downtoner/lookback/\n"
+         << "                                    exclamation settings in one pass, e.g. negation=-1:-0.4:0.1\n"
+         << "  " << program << " --partial <file> <bytes|senators> <shard> <count> [checkpoint] [records] [seconds]\n"
+         << "                                    Aggregate one shard of tweets.csv into a partial file,\n"
+         << "                                    resumably (checkpoints default every 100000 records/10 s)\n"
+         << "  " << program << " --merge <output> <partial...>\n"
+         << "                                    Combine partials (into JSON if output ends in .json)\n"
+         << "  " << program << " --build-index [file]    Write the keyword index (default tweets.idx)\n"
+         << "  " << program << " --search <file> <query> [score=base|adjusted] [min=X] [max=X]\n"
+         << "                  [sort=desc|asc] [limit=N] [senator=NAME]\n"
+         << "                                    Boolean/phrase search, e.g. \"border security\" AND NOT wall\n";
+}
+
+int runCommandLine(int argc, char* argv[])
+{
+    string mode = argv[1];
+
+    if (mode == "--daemon" && argc == 3) {
+        return runQueryDaemon(argv[2]);
     }
-    
-    // Get current timestamp
-    time_t now = time(0);
-    char timestamp[100];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
-    
-    out << "{\n";
-    out << "  \"generatedAt\": \"" << timestamp << "\",\n";
-    out << "  \"senators\": [\n";
-    
-    // Build maps for easy lookup
-    unordered_map<string, SenatorStats> baseMap;
-    for (const auto& stat : baseStats) {
-        baseMap[stat.name] = stat;
+    if (mode == "--query" && argc >= 4) {
+        string request;
+        for (int i = 3; i < argc; i++) {
+            if (i > 3) request += " ";
+            request += argv[i];
+        }
+        return runQueryClient(argv[2], request);
     }
-    
-    unordered_map<string, vector<AdvancedTweetAnalysis>> tweetsBySenator;
-    for (const auto& analysis : allTweetAnalyses) {
-        tweetsBySenator[analysis.senatorName].push_back(analysis);
+    if (mode == "--ask" && argc >= 3) {
+        string request;
+        for (int i = 2; i < argc; i++) {
+            if (i > 2) request += " ";
+            request += argv[i];
+        }
+        cout << answerQuery(loadCorpusState(), request) << endl;
+        return 0;
     }
-    
-    for (size_t i = 0; i < advancedSummaries.size(); i++) {
-        const auto& summary = advancedSummaries[i];
-        const auto& base = baseMap[summary.name];
-        
-        out << "    {\n";
-        out << "      \"name\": \"" << escapeJsonString(summary.name) << "\",\n";
-        
-        // Base stats
-        out << "      \"baseStats\": {\n";
-        out << "        \"totalTweets\": " << base.totalTweets << ",\n";
-        out << "        \"totalWords\": " << base.totalWords << ",\n";
-        out << "        \"positivePercent\": " << fixed << setprecision(2) << base.positivePercent << ",\n";
-        out << "        \"negativePercent\": " << fixed << setprecision(2) << base.negativePercent << "\n";
-        out << "      },\n";
-        
-        // Advanced summary
-        out << "      \"advancedSummary\": {\n";
-        out << "        \"avgBaseSentiment\": " << fixed << setprecision(2) << summary.avgBaseSentiment << ",\n";
-        out << "        \"avgAdjustedSentiment\": " << fixed << setprecision(2) << summary.avgAdjustedSentiment << ",\n";
-        out << "        \"avgPosPercent\": " << fixed << setprecision(2) << summary.avgPosPercent << ",\n";
-        out << "        \"avgNegPercent\": " << fixed << setprecision(2) << summary.avgNegPercent << ",\n";
-        out << "        \"avgAllCaps\": " << fixed << setprecision(2) << summary.avgAllCaps << ",\n";
-        out << "        \"avgExclamations\": " << fixed << setprecision(2) << summary.avgExclamations << ",\n";
-        out << "        \"avgStyleScore\": " << fixed << setprecision(2) << summary.avgStyleScore << "\n";
-        out << "      },\n";
+
+    if (mode == "--trends" && argc >= 3 && argc <= 5) {
+        TrendBucket bucket;
+        if (!parseTrendBucket(argv[2], bucket)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        size_t window = argc >= 4 ? max(1, atoi(argv[3])) : 7;
+        string filename = argc >= 5 ? argv[4] : "trends.json";
+        CorpusState state = loadCorpusState();
+        writeTrendJson(state.trends[(int)bucket], state.senatorIndex, window, filename);
+        return 0;
+    }
+
+    if (mode == "--group-by" && argc == 4) {
+        return runGroupByReport(argv[2], argv[3]);
+    }
+
+    if (mode == "--stream") {
+        long long windowSeconds = 0;
+        size_t windowTweets = 0;
+        string inputPath;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            string option = argv[i];
+            long long value = atoll(argv[i + 1]);
+            if ((option == "--window-minutes" || option == "--window-tweets") &&
+                (value <= 0 || value > LLONG_MAX / 60)) {
+                cerr << "Error: " << option << " must be a positive number" << endl;
+                return 1;
+            }
+            if (option == "--window-minutes") windowSeconds = value * 60;
+            else if (option == "--window-tweets") windowTweets = value;
+            else if (option == "--input") inputPath = argv[i + 1];
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        if (argc % 2 != 0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (windowSeconds == 0 && windowTweets == 0) windowTweets = 100;
         
-        // Tweets
-        out << "      \"tweets\": [\n";
-        const auto& tweets = tweetsBySenator[summary.name];
-        for (size_t j = 0; j < tweets.size(); j++) {
-            const auto& t = tweets[j];
-            out << "        {\n";
-            out << "          \"tweetId\": \"" << escapeJsonString(t.tweetId) << "\",\n";
-            out << "          \"datetime\": \"" << escapeJsonString(t.datetime) << "\",\n";
-            out << "          \"text\": \"" << escapeJsonString(t.text) << "\",\n";
-            out << "          \"totalWords\": " << t.totalWords << ",\n";
-            out << "          \"posWordCount\": " << t.posWordCount << ",\n";
-            out << "          \"negWordCount\": " << t.negWordCount << ",\n";
-            out << "          \"baseSentimentScore\": " << fixed << setprecision(2) << t.baseSentimentScore << ",\n";
-            out << "          \"adjustedSentimentScore\": " << fixed << setprecision(2) << t.adjustedSentimentScore << ",\n";
-            out << "          \"negationHits\": " << t.negationHits << ",\n";
-            out << "          \"intensifierHits\": " << t.intensifierHits << ",\n";
-            out << "          \"downtonerHits\": " << t.downtonerHits << ",\n";
-            out << "          \"exclamationCount\": " << t.exclamationCount << ",\n";
-            out << "          \"questionCount\": " << t.questionCount << ",\n";
-            out << "          \"allCapsWordCount\": " << t.allCapsWordCount << ",\n";
-            out << "          \"emojiPositiveCount\": " << t.emojiPositiveCount << ",\n";
-            out << "          \"emojiNegativeCount\": " << t.emojiNegativeCount << ",\n";
-            out << "          \"slangPositiveCount\": " << t.slangPositiveCount << ",\n";
-            out << "          \"slangNegativeCount\": " << t.slangNegativeCount << ",\n";
-            out << "          \"ngramPositiveHits\": " << t.ngramPositiveHits << ",\n";
-            out << "          \"ngramNegativeHits\": " << t.ngramNegativeHits << "\n";
-            out << "        }";
-            if (j < tweets.size() - 1) out << ",";
-            out << "\n";
+        if (inputPath.empty()) return runStreamingScorer(cin, windowSeconds, windowTweets);
+        ifstream input(inputPath); // works for FIFOs too
+        if (!input.is_open()) {
+            cerr << "Error: Could not open " << inputPath << endl;
+            return 1;
         }
-        out << "      ]\n";
-        out << "    }";
-        if (i < advancedSummaries.size() - 1) out << ",";
-        out << "\n";
+        return runStreamingScorer(input, windowSeconds, windowTweets);
     }
-    
-    out << "  ]\n";
-    out << "}\n";
-    
-    out.close();
-    cout << "Analysis exported to " << filename << endl;
+
+    if (mode == "--pipeline" && argc <= 4) {
+        string outputFile = argc >= 3 ? argv[2] : "analysis.json";
+        size_t chunkSize = argc >= 4 ? max(1, atoi(argv[3])) : 256;
+        return runPipeline(outputFile, chunkSize);
+    }
+
+    if (mode == "--export-shards" && argc <= 4) {
+        string directory = argc >= 3 ? argv[2] : "shards";
+        size_t threadCount = argc >= 4 ? max(1, atoi(argv[3])) : max(1u, thread::hardware_concurrency());
+        return exportSenatorShards(loadCorpusState(), directory, threadCount);
+    }
+
+    if (mode == "--ndjson" && argc >= 3 && argc <= 5) {
+        string target = argv[2];
+        chrono::milliseconds flushInterval(argc >= 4 ? max(0, atoi(argv[3])) : 1000);
+        string jsonFile = argc >= 5 ? argv[4] : "";
+        if (target == "-") {
+            if (!jsonFile.empty()) {
+                // writeAnalysisJson reports on stdout, which would corrupt the stream
+                cerr << "Error: A JSON file can only be written alongside an NDJSON file, not stdout" << endl;
+                return 1;
+            }
+            NdjsonSink sink(cout, flushInterval);
+            return runPipeline(jsonFile, 256, &sink);
+        }
+        ofstream out(target);
+        if (!out.is_open()) {
+            cerr << "Error: Could not create " << target << endl;
+            return 1;
+        }
+        NdjsonSink sink(out, flushInterval);
+        int result = runPipeline(jsonFile, 256, &sink);
+        if (result == 0) cout << "Exported " << sink.recordCount() << " NDJSON records to " << target << endl;
+        return result;
+    }
+
+    if (mode == "--dedup" && argc <= 4) {
+        double threshold = argc >= 3 ? atof(argv[2]) : 0.8;
+        string dedupMode = argc >= 4 ? argv[3] : "downweight";
+        if (threshold <= 0.0 || threshold > 1.0 || (dedupMode != "exclude" && dedupMode != "downweight")) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runDedupReport(threshold, dedupMode == "exclude" ? DedupMode::Exclude : DedupMode::DownWeight);
+    }
+
+    if (mode == "--topics" && argc <= 4) {
+        size_t k = argc >= 3 ? max(1, atoi(argv[2])) : 8;
+        size_t iterations = argc >= 4 ? max(1, atoi(argv[3])) : 25;
+        return runTopicReport(k, iterations);
+    }
+
+    if (mode == "--associations" && argc <= 4) {
+        size_t top = argc >= 3 ? max(1, atoi(argv[2])) : 8;
+        double priorStrength = argc >= 4 ? atof(argv[3]) : 500.0;
+        if (priorStrength <= 0.0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runAssociationReport(top, priorStrength);
+    }
+
+    if (mode == "--sketch" && argc <= 4) {
+        size_t top = argc >= 3 ? max(1, atoi(argv[2])) : 9;
+        double epsilon = argc >= 4 ? atof(argv[3]) : 0.001;
+        if (epsilon <= 0.0 || epsilon >= 1.0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runSketchReport(top, epsilon);
+    }
+
+    if (mode == "--sweep") {
+        return runSweepReport(vector<string>(argv + 2, argv + argc));
+    }
+
+    if (mode == "--partial" && argc >= 6 && argc <= 9) {
+        string split = argv[3];
+        int shard = atoi(argv[4]);
+        int shardCount = atoi(argv[5]);
+        if ((split != "bytes" && split != "senators") || shardCount < 1 || shard < 0 || shard >= shardCount) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        ShardMode shardMode = split == "bytes" ? ShardMode::ByteRange : ShardMode::SenatorHash;
+        CheckpointPolicy checkpoint;
+        if (argc >= 7) checkpoint.path = argv[6];
+        if (argc >= 8) checkpoint.everyRecords = max(1LL, atoll(argv[7]));
+        if (argc >= 9) checkpoint.everySeconds = atof(argv[8]);
+        return runPartial(argv[2], shardMode, shard, shardCount, checkpoint);
+    }
+    if (mode == "--merge" && argc >= 4) {
+        return runMergePartials(argv[2], vector<string>(argv + 3, argv + argc));
+    }
+
+    if (mode == "--build-index" && argc <= 3) {
+        return buildInvertedIndex(loadCorpusState(), argc >= 3 ? argv[2] : "tweets.idx");
+    }
+    if (mode == "--search" && argc >= 4) {
+        string request;
+        for (int i = 3; i < argc; i++) {
+            if (i > 3) request += " ";
+            request += argv[i];
+        }
+        return runSearch(argv[2], request);
+    }
+
+    if (mode == "--verify-stemmer") {
+        return runStemmerVerification(vector<string>(argv + 2, argv + argc));
+    }
+    if (mode == "--verify-load" && argc <= 3) {
+        size_t threadCount = argc >= 3 ? max(1, atoi(argv[2])) : max(1u, thread::hardware_concurrency());
+        return runLoadVerification(threadCount);
+    }
+    if (mode == "--alloc-check" && argc == 2) {
+        return runAllocationCheck();
+    }
+
+    printUsage(argv[0]);
+    return (mode == "--help" || mode == "-h") ? 0 : 1;
 }
 
 // ============================================================================
 // MAIN PROGRAM
 // ============================================================================
 
-int main()
+int main(int argc, char* argv[])
 {
     // Enable ANSI colors
     Color::enableColors();
     
+    if (argc > 1) {
+        return runCommandLine(argc, argv);
+    }
+    
     cout << "========================================" << endl;
     cout << "CS101 SENATOR TWEET SENTIMENT ANALYSIS" << endl;
     cout << "========================================\n" << endl;
     
     // Load data
     cout << "Loading data..." << endl;
-    vector<vector<string>> rawTweets = read_tweets_csv_file();
-    vector<Tweet> tweets = convertToTweets(rawTweets);
+    TweetTable tweets = read_tweets_csv_file();
     cout << "Loaded " << tweets.size() << " tweets." << endl;
     
     vector<string> posWords = readEmotionFile("positive-words.txt");
@@ -1231,22 +8595,17 @@ int main()
     unordered_set<string> positiveLexicon = buildLexiconSet(posWords);
     unordered_set<string> negativeLexicon = buildLexiconSet(negWords);
     
+    // Index senators for the menu and drill-down queries
+    SenatorIndex senatorIndex = buildSenatorIndex(tweets, positiveLexicon, negativeLexicon);
+    const vector<string>& senators = senatorIndex.names;
+    
     // PART I: Compute base sentiment stats
     cout << "Computing base sentiment statistics..." << endl;
-    vector<SenatorStats> baseStats = computeBaseSenatorStats(tweets, positiveLexicon, negativeLexicon);
-    
-    // Get unique senators for menu
-    vector<string> senators = getUniqueSenators(tweets);
-    sort(senators.begin(), senators.end());
+    vector<SenatorStats> baseStats = computeBaseSenatorStats(senatorIndex);
     
     printBaseSentimentTable(baseStats);
     
-    cout << "\nPress any key to continue to menu...";
-    #ifdef _WIN32
-    _getch();
-    #else
-    cin.get();
-    #endif
+    Terminal::waitForKey("\nPress any key to continue to menu...");
     
     // Interactive menu
     while (true) {
@@ -1264,48 +8623,23 @@ int main()
             break;
         }
         else if (choice == 0) {
-            // Show senator selection submenu
-            vector<string> senatorMenuOptions = senators;
-            senatorMenuOptions.push_back("Back to Main Menu");
+            // Show senator picker
+            int senatorChoice = EntityPicker::pick("SELECT A SENATOR", senators);
             
-            int senatorChoice = ArrowMenu::showMenu("SELECT A SENATOR", senatorMenuOptions);
-            
-            if (senatorChoice >= 0 && senatorChoice < senators.size()) {
-                #ifdef _WIN32
-                system("cls");
-                #else
-                system("clear");
-                #endif
-                showMostPositiveAndNegativeTweetForSenator(tweets, positiveLexicon, negativeLexicon, senators[senatorChoice]);
-                cout << "\nPress any key to continue...";
-                #ifdef _WIN32
-                _getch();
-                #else
-                cin.get();
-                #endif
+            if (senatorChoice >= 0) {
+                Terminal::clearScreen();
+                showMostPositiveAndNegativeTweetForSenator(senatorIndex, senators[senatorChoice]);
+                Terminal::waitForKey("\nPress any key to continue...");
             }
         }
         else if (choice == 1) {
-            #ifdef _WIN32
-            system("cls");
-            #else
-            system("clear");
-            #endif
-            vector<TalkStats> talkStats = computeTalkStats(tweets);
+            Terminal::clearScreen();
+            vector<TalkStats> talkStats = computeTalkStats(senatorIndex);
             printTalkStatsAndMostTalkative(talkStats);
-            cout << "\nPress any key to continue...";
-            #ifdef _WIN32
-            _getch();
-            #else
-            cin.get();
-            #endif
+            Terminal::waitForKey("\nPress any key to continue...");
         }
         else if (choice == 2) {
-            #ifdef _WIN32
-            system("cls");
-            #else
-            system("clear");
-            #endif
+            Terminal::clearScreen();
             
             cout << "\n========================================" << endl;
             cout << "ADVANCED SENTIMENT ANALYSIS" << endl;
@@ -1313,52 +8647,48 @@ int main()
             
             cout << "Building advanced sentiment lexicons..." << endl;
             
-            unordered_map<string, double> wordPolarity = buildWordPolarityMap(posWords, negWords);
-            unordered_set<string> negationWords = buildNegationWords();
-            unordered_set<string> intensifiers = buildIntensifiers();
-            unordered_set<string> downtoners = buildDowntoners();
-            unordered_map<string, double> ngramPolarity = buildNgramPolarity();
-            unordered_set<string> positiveEmojisSlang = buildPositiveEmojisSlang();
-            unordered_set<string> negativeEmojisSlang = buildNegativeEmojisSlang();
+            shared_ptr<const ScoringModel> model = loadScoringModel(posWords, negWords);
             
             cout << "Analyzing all tweets with advanced sentiment engine..." << endl;
-            vector<AdvancedTweetAnalysis> allAnalyses = analyzeAllTweetsAdvanced(
-                tweets, wordPolarity, negationWords, intensifiers, downtoners,
-                ngramPolarity, positiveEmojisSlang, negativeEmojisSlang
-            );
+            vector<AdvancedTweetAnalysis> allAnalyses = analyzeAllTweetsAdvanced(tweets, *model);
             
             cout << "Summarizing by senator..." << endl;
-            vector<AdvancedSenatorSummary> advancedSummaries = summarizeAdvancedBySenator(allAnalyses);
+            vector<AdvancedSenatorSummary> advancedSummaries = summarizeAdvancedBySenator(tweets, allAnalyses);
             
             cout << "Writing JSON export..." << endl;
-            writeAnalysisJson(baseStats, advancedSummaries, allAnalyses, "analysis.json");
+            writeAnalysisJson(baseStats, advancedSummaries, tweets, allAnalyses, "analysis.json");
             
-            cout << "\n========================================" << endl;
-            cout << "ADVANCED SENTIMENT SUMMARY" << endl;
-            cout << "========================================" << endl;
-            cout << left << setw(25) << "Senator"
-                 << right << setw(10) << "Tweets"
-                 << setw(12) << "Avg Base"
-                 << setw(12) << "Avg Adj"
-                 << setw(10) << "Style" << endl;
-            cout << string(69, '-') << endl;
+            // The summary table goes out as one write
+            ostringstream report;
+            report << "\n========================================\n";
+            report << "ADVANCED SENTIMENT SUMMARY\n";
+            report << "========================================\n";
+            report << left << setw(25) << "Senator"
+                   << right << setw(10) << "Tweets"
+                   << setw(12) << "Avg Base"
+                   << setw(12) << "Avg Adj"
+                   << setw(10) << "Style" << "\n";
+            report << string(69, '-') << "\n";
             
-            for (const auto& s : advancedSummaries) {
-                cout << left << setw(25) << s.name
-                     << right << setw(10) << s.tweetCount
-                     << setw(12) << fixed << setprecision(2) << s.avgBaseSentiment
-                     << setw(12) << fixed << setprecision(2) << s.avgAdjustedSentiment
-                     << setw(10) << fixed << setprecision(1) << s.avgStyleScore << endl;
-            }
-            cout << endl;
+            // Rank senators from most to least positive adjusted average
+            vector<AdvancedSenatorSummary> rankedSummaries = advancedSummaries;
+            stable_sort(rankedSummaries.begin(), rankedSummaries.end(),
+                [](const AdvancedSenatorSummary& a, const AdvancedSenatorSummary& b) {
+                    return a.avgAdjustedSentiment > b.avgAdjustedSentiment;
+                });
+            
+            for (const auto& s : rankedSummaries) {
+                report << left << setw(25) << s.name
+                       << right << setw(10) << s.tweetCount
+                       << setw(12) << fixed << setprecision(2) << s.avgBaseSentiment
+                       << setw(12) << fixed << setprecision(2) << s.avgAdjustedSentiment
+                       << setw(10) << fixed << setprecision(1) << s.avgStyleScore << "\n";
+            }
+            report << "\n";
             
-            cout << "Analysis complete! JSON exported to analysis.json" << endl;
-            cout << "\nPress any key to continue...";
-            #ifdef _WIN32
-            _getch();
-            #else
-            cin.get();
-            #endif
+            report << "Analysis complete! JSON exported to analysis.json\n";
+            Terminal::write(report.str());
+            Terminal::waitForKey("\nPress any key to continue...");
         }
     }
     
@@ -41,6 +41,8 @@
 #include <string.h>  /* for memmove */
 #include <iostream>
 #include <string>
+#include <bitset>
+#include <stdint.h>
 #define TRUE 1
 #define FALSE 0
 
@@ -54,8 +56,11 @@
    should be done before stem(...) is called.
 */
 
-static char * b;       /* buffer for word to be stemmed */
-static int k,k0,j;     /* j is a general offset into the string */
+static thread_local char * b;   /* buffer for word to be stemmed */
+static thread_local int k,k0,j;  /* j is a general offset into the string */
+
+/* The working state is thread_local so separate threads can stem at the
+   same time. */
 
 /* cons(i) is TRUE <=> b[i] is a consonant. */
 
@@ -379,21 +384,250 @@ static void stemfile(FILE * f)
    }
 }
 
+/*--------------------table-driven stemmer------------------------*/
+
+/* fastStem(p, n) gives the same result as stem(p, 0, n-1) + 1, but
+   classifies each letter as consonant or vowel once per word instead of
+   rescanning the word in every cons() and m() call, and finds the suffix
+   of steps 2 to 4 with one walk down a reversed-suffix trie instead of a
+   chain of ends() calls.
+
+   Bit i of cons is set when b[i] is a consonant. m() of b[0..j] is then
+   the number of consonants at 1..j that follow a vowel, one popcount,
+   and vowelinstem() is a mask test. A letter's class depends only on the
+   letters before it, so after a suffix is rewritten the bits are
+   recomputed from the first changed letter onwards.
+
+   The rules of each step are listed in the order stem() tries them.
+   Where one suffix ends another (-ement, -ment, -ent) stem() tries the
+   longer one first, so taking the longest match in the trie picks the
+   same rule. Words longer than FAST_STEM_MAX go to stem(). */
+
+#define FAST_STEM_MAX 64
+
+struct SuffixRule { const char * suffix; const char * replacement; };
+
+static const SuffixRule step2Rules[] =
+{  {"ational", "ate"}, {"tional", "tion"}, {"enci", "ence"}, {"anci", "ance"},
+   {"izer", "ize"}, {"bli", "ble"}, {"alli", "al"}, {"entli", "ent"},
+   {"eli", "e"}, {"ousli", "ous"}, {"ization", "ize"}, {"ation", "ate"},
+   {"ator", "ate"}, {"alism", "al"}, {"iveness", "ive"}, {"fulness", "ful"},
+   {"ousness", "ous"}, {"aliti", "al"}, {"iviti", "ive"}, {"biliti", "ble"},
+   {"logi", "log"}
+};
+
+static const SuffixRule step3Rules[] =
+{  {"icate", "ic"}, {"ative", ""}, {"alize", "al"}, {"iciti", "ic"},
+   {"ical", "ic"}, {"ful", ""}, {"ness", ""}
+};
+
+/* Step 4 only removes; "ion" also needs an s or t before it. */
+
+static const SuffixRule step4Rules[] =
+{  {"al", ""}, {"ance", ""}, {"ence", ""}, {"er", ""}, {"ic", ""},
+   {"able", ""}, {"ible", ""}, {"ant", ""}, {"ement", ""}, {"ment", ""},
+   {"ent", ""}, {"ion", ""}, {"ou", ""}, {"ism", ""}, {"ate", ""},
+   {"iti", ""}, {"ous", ""}, {"ive", ""}, {"ize", ""}
+};
+
+static const int step4Ion = 11;   /* index of "ion" above */
+
+/* A trie over the reversed suffixes of one step. Node 0 is the root;
+   rule is the index of the rule ending at a node, or -1. */
+
+struct SuffixTrie
+{  struct Node { short child[26]; short rule; };
+   Node nodes[128];
+   int count;
+   const SuffixRule * rules;
+   int replacementLength[32];
+
+   SuffixTrie(const SuffixRule * list, int n) : count(1), rules(list)
+   {  memset(nodes, 0, sizeof(nodes));
+      nodes[0].rule = -1;
+      for (int r = 0; r < n; r++)
+      {  int node = 0;
+         replacementLength[r] = (int) strlen(list[r].replacement);
+         for (int i = (int) strlen(list[r].suffix) - 1; i >= 0; i--)
+         {  int c = list[r].suffix[i] - 'a';
+            if (nodes[node].child[c] == 0)
+            {  nodes[count].rule = -1;
+               nodes[node].child[c] = (short) count++;
+            }
+            node = nodes[node].child[c];
+         }
+         nodes[node].rule = (short) r;
+      }
+   }
+
+   /* The longest rule suffix of b[0..k], or -1; *length gets its length. */
+
+   int match(const char * b, int k, int * length) const
+   {  int node = 0, best = -1;
+      for (int i = k; i >= 0; i--)
+      {  unsigned c = (unsigned char) b[i] - 'a';
+         if (c >= 26 || nodes[node].child[c] == 0) break;
+         node = nodes[node].child[c];
+         if (nodes[node].rule >= 0) { best = nodes[node].rule; *length = k - i + 1; }
+      }
+      return best;
+   }
+};
+
+static const SuffixTrie step2Trie(step2Rules, sizeof(step2Rules) / sizeof(step2Rules[0]));
+static const SuffixTrie step3Trie(step3Rules, sizeof(step3Rules) / sizeof(step3Rules[0]));
+static const SuffixTrie step4Trie(step4Rules, sizeof(step4Rules) / sizeof(step4Rules[0]));
+
+/* Letter classes for classify(): 0 vowel, 1 consonant, 2 for 'y', whose
+   class depends on the letter before it. */
+
+static const struct LetterClasses
+{  unsigned char of[256];
+   LetterClasses()
+   {  memset(of, 1, sizeof(of));
+      of['a'] = of['e'] = of['i'] = of['o'] = of['u'] = 0;
+      of['y'] = 2;
+   }
+} letterClasses;
+
+struct FastStemState
+{  char * b;
+   int k;
+   uint64_t consMask;
+
+   int cons(int i) const { return (int) (consMask >> i) & 1; }
+   static uint64_t upTo(int j) { return j >= 63 ? ~(uint64_t) 0 : ((uint64_t) 1 << (j + 1)) - 1; }
+
+   void classify(int from)
+   {  uint64_t mask = from > 0 ? consMask & upTo(from - 1) : 0;
+      uint64_t previous = from > 0 ? (uint64_t) cons(from - 1) : 0;   /* a leading y is a consonant */
+      for (int i = from; i <= k; i++)
+      {  uint64_t c = letterClasses.of[(unsigned char) b[i]];
+         if (c == 2) c = !previous;
+         mask |= c << i;
+         previous = c;
+      }
+      consMask = mask;
+   }
+
+   int m(int j) const
+   {  if (j < 1) return 0;
+      uint64_t starts = consMask & ~(consMask << 1) & ~(uint64_t) 1;
+      return (int) std::bitset<64>(starts & upTo(j)).count();
+   }
+   int vowelinstem(int j) const { return j >= 0 && (~consMask & upTo(j)) != 0; }
+   int doublec(int i) const { return i >= 1 && b[i] == b[i-1] && cons(i); }
+   int cvc(int i) const
+   {  if (i < 2 || !cons(i) || cons(i-1) || !cons(i-2)) return FALSE;
+      return b[i] != 'w' && b[i] != 'x' && b[i] != 'y';
+   }
+   int ends(const char * s, int length) const
+   {  return length <= k + 1 && memcmp(b + k - length + 1, s, length) == 0;
+   }
+
+   /* Replaces b[j+1..k] with s and reclassifies the new letters. */
+
+   void setto(int j, const char * s, int length)
+   {  memcpy(b + j + 1, s, length);
+      k = j + length;
+      classify(j + 1);
+   }
+
+   void step1ab()
+   {  if (b[k] == 's')
+      {  if (ends("sses", 4)) k -= 2; else
+         if (ends("ies", 3)) k -= 2; /* setto("i") leaves the i already there */ else
+         if (b[k-1] != 's') k--;
+      }
+      if (ends("eed", 3)) { if (m(k-3) > 0) k--; return; }
+      int j;
+      if (ends("ed", 2)) j = k - 2; else
+      if (ends("ing", 3)) j = k - 3; else return;
+      if (!vowelinstem(j)) return;
+      k = j;
+      if (ends("at", 2)) setto(k, "e", 1); else
+      if (ends("bl", 2)) setto(k, "e", 1); else
+      if (ends("iz", 2)) setto(k, "e", 1); else
+      if (doublec(k))
+      {  k--;
+         if (b[k] == 'l' || b[k] == 's' || b[k] == 'z') k++;
+      }
+      else if (m(k) == 1 && cvc(k)) setto(k, "e", 1);
+   }
+
+   void step1c() { if (b[k] == 'y' && vowelinstem(k-1)) { b[k] = 'i'; classify(k); } }
+
+   void replaceSuffix(const SuffixTrie & trie)
+   {  int length = 0;
+      int rule = trie.match(b, k, &length);
+      if (rule < 0 || m(k - length) == 0) return;
+      setto(k - length, trie.rules[rule].replacement, trie.replacementLength[rule]);
+   }
+
+   void step4()
+   {  int length = 0;
+      int rule = step4Trie.match(b, k, &length);
+      if (rule < 0) return;
+      int j = k - length;
+      if (rule == step4Ion && (j < 0 || (b[j] != 's' && b[j] != 't'))) return;
+      if (m(j) > 1) k = j;
+   }
+
+   void step5()
+   {  int j = k;
+      if (b[k] == 'e')
+      {  int a = m(j);
+         if (a > 1 || (a == 1 && !cvc(k-1))) k--;
+      }
+      if (b[k] == 'l' && doublec(k) && m(j) > 1) k--;
+   }
+};
+
+/* Stems the n lower-case characters at p and returns the stem length. */
+
+static int fastStem(char * p, int n)
+{  if (n <= 2) return n;
+   if (n > FAST_STEM_MAX) return stem(p, 0, n-1) + 1;
+   FastStemState s;
+   s.b = p;
+   s.k = n - 1;
+   s.consMask = 0;
+   s.classify(0);
+   s.step1ab();
+   if (s.k > 0)
+   {  s.step1c();
+      s.replaceSuffix(step2Trie);
+      s.replaceSuffix(step3Trie);
+      s.step4();
+      s.step5();
+   }
+   return s.k + 1;
+}
+
+/* stemWords(words, lengths, count) lower-cases and stems count words in
+   place, updating each length. */
+
+static void stemWords(char * const * words, int * lengths, int count)
+{  for (int w = 0; w < count; w++)
+   {  char * p = words[w];
+      for (int i = 0; i < lengths[w]; i++) if (p[i] >= 'A' && p[i] <= 'Z') p[i] += 'a' - 'A';
+      lengths[w] = fastStem(p, lengths[w]);
+   }
+}
+
+/* stemInPlace(p, n) lower-cases and stems the n characters at p without
+   allocating, and returns the length of the stem. */
+
+static int stemInPlace(char * p, int n)
+{   int i;
+    for (i = 0; i < n; i++) p[i] = tolower(p[i]);
+    return fastStem(p, n);
+}
+
 static std::string stemString(std::string word)
-{    size_t i;
-    //std::cout << word << " " << word.size() << std::endl;
-    s = (char *) malloc(i_max+1);
-    for(i = 0; i < word.size(); i++)
-    {
-        s[i] = tolower(word[i]);
-        //std::cout << word[i] ;
-    }
-    //std::cout << "\n" ;
-    s[stem(s,0,i-1)+1] = 0;
-    //std::cout << s << std::endl;
-    std::string new_word = s;
-    return new_word;
-    
+{   if (word.empty()) return word;
+    word.resize(stemInPlace(&word[0], (int) word.size()));
+    return word;
 }
 /*
 int main(int argc, char * argv[])